@@ -0,0 +1,104 @@
+/**
+ * @file bench_kernels.c
+ * @brief Microbenchmark comparing vector kernels for different ISAs.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+////////////
+// Macros //
+////////////
+/** @brief Number of floating-point operations per call */
+#define FLOPS(n, k) ((k) * (double) (n))
+
+///////////////
+// Constants //
+///////////////
+static const long long SIZES[] = {50, 100, 200, 300, 500, 1000};
+static const size_t N_SIZES = sizeof(SIZES) / sizeof(SIZES[0]);
+/** @brief Total number of vector elements processed per measurement */
+static const long long WORK = 200000000;
+
+/////////////
+// Methods //
+/////////////
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(real *a_vec, long long a_n, unsigned long long a_seed) {
+  long long i;
+  for (i = 0; i < a_n; ++i) {
+    a_seed = a_seed * (unsigned long long)25214903917 + 11;
+    a_vec[i] = (((a_seed & 0xFFFF) / (real)65536) - 0.5) / a_n;
+  }
+}
+
+int main(void) {
+  size_t n_variants, v, s;
+  const kernels_t *variants = get_kernel_variants(&n_variants);
+  long long n, r, reps, max_n = SIZES[N_SIZES - 1];
+  real *x, *y, *e;
+  volatile real sink = 0;
+  double t, dot_t, axpy_t, axpy2_t, scale_t;
+
+  if (posix_memalign((void **) &x, 64, max_n * sizeof(real))
+      || posix_memalign((void **) &y, 64, max_n * sizeof(real))
+      || posix_memalign((void **) &e, 64, max_n * sizeof(real))) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-8s %6s %12s %12s %12s %12s\n", "isa", "size",
+         "dot GF/s", "axpy GF/s", "axpy2 GF/s", "scale GF/s");
+  for (s = 0; s < N_SIZES; ++s) {
+    n = SIZES[s];
+    reps = WORK / n;
+    for (v = 0; v < n_variants; ++v) {
+      fill(x, n, 1);
+      fill(y, n, 2);
+      fill(e, n, 3);
+
+      t = now();
+      for (r = 0; r < reps; ++r)
+        sink += variants[v].m_dot(x, y, n);
+      dot_t = now() - t;
+
+      t = now();
+      for (r = 0; r < reps; ++r)
+        variants[v].m_axpy(1e-7, x, y, n);
+      axpy_t = now() - t;
+
+      t = now();
+      for (r = 0; r < reps; ++r)
+        variants[v].m_axpy2(1e-7, x, y, e, n);
+      axpy2_t = now() - t;
+
+      t = now();
+      for (r = 0; r < reps; ++r)
+        variants[v].m_scale(1., x, n);
+      scale_t = now() - t;
+
+      printf("%-8s %6lld %12.2f %12.2f %12.2f %12.2f\n",
+             variants[v].m_isa, n,
+             FLOPS(n, 2) * reps / dot_t / 1e9,
+             FLOPS(n, 2) * reps / axpy_t / 1e9,
+             FLOPS(n, 4) * reps / axpy2_t / 1e9,
+             FLOPS(n, 1) * reps / scale_t / 1e9);
+    }
+  }
+  free(x);
+  free(y);
+  free(e);
+  return EXIT_SUCCESS;
+}
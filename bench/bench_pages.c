@@ -0,0 +1,126 @@
+/**
+ * @file bench_pages.c
+ * @brief Microbenchmark comparing random row updates of a large
+ * matrix backed by regular and huge pages.
+ *
+ * Usage: bench_pages [matrix size in MB] [row size]
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "kernels.h"
+#include "pages.h"
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+///////////////
+// Constants //
+///////////////
+static const huge_pages_mode_t MODES[] = {HUGE_PAGES_NONE, HUGE_PAGES_THP,
+                                          HUGE_PAGES_EXPLICIT};
+static const size_t N_MODES = sizeof(MODES) / sizeof(MODES[0]);
+/** @brief Number of random row updates per measurement */
+static const long long N_UPDATES = 20000000;
+
+/////////////
+// Methods //
+/////////////
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* open counter of data TLB load misses of this thread (-1 if the
+   kernel does not allow it) */
+static int open_tlb_counter(void) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int main(int argc, char **argv) {
+  long long size_mb = argc > 1? atoll(argv[1]): 1024;
+  long long layer1_size = argc > 2? atoll(argv[2]): 100;
+  long long n_rows = size_mb * 1048576 / (layer1_size * sizeof(real));
+  long long i, row;
+  unsigned long long next_random = 1;
+  long long misses;
+  double t;
+  size_t m;
+  page_backing_t backing;
+  real *mtx, *hidden;
+  volatile real sink = 0;
+  int counter = open_tlb_counter();
+
+  if (n_rows < 1 || layer1_size < 1) {
+    fprintf(stderr, "Usage: %s [matrix size in MB] [row size]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  init_kernels(NULL);
+  hidden = (real *) calloc(layer1_size, sizeof(real));
+  for (i = 0; i < layer1_size; ++i)
+    hidden[i] = 1e-3;
+
+  printf("matrix: %lld MB (%lld x %lld)  updates: %lld\n", size_mb, n_rows,
+         layer1_size, N_UPDATES);
+  printf("%-10s %-24s %12s %12s %14s\n", "mode", "backing", "huge MB",
+         "Mrows/s", "dTLB misses");
+  for (m = 0; m < N_MODES; ++m) {
+    mtx = (real *) alloc_pages(n_rows * layer1_size * sizeof(real),
+                               MODES[m], &backing);
+    for (i = 0; i < n_rows * layer1_size; ++i)
+      mtx[i] = 0;
+
+    if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    t = now();
+    /* the access pattern of the training loop: a dot product with a
+       random row followed by its update */
+    for (i = 0; i < N_UPDATES; ++i) {
+      next_random = next_random * (unsigned long long)25214903917 + 11;
+      row = (next_random >> 16) % n_rows;
+      sink += vec_dot(hidden, &mtx[row * layer1_size], layer1_size);
+      vec_axpy(1e-3, hidden, &mtx[row * layer1_size], layer1_size);
+    }
+    t = now() - t;
+    misses = -1;
+    if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(counter, &misses, sizeof(misses)) != sizeof(misses))
+        misses = -1;
+    }
+
+    printf("%-10s %-24s %12.1f %12.2f ", huge_pages_mode2str(MODES[m]),
+           page_backing2str(backing), huge_pages_in(mtx) / 1048576.,
+           N_UPDATES / t / 1e6);
+    if (misses >= 0)
+      printf("%14lld\n", misses);
+    else
+      printf("%14s\n", "n/a");
+    free_pages(mtx);
+  }
+  if (counter >= 0)
+    close(counter);
+  free(hidden);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file bench_sigmoid.c
+ * @brief Microbenchmark comparing accuracy and throughput of sigmoid
+ * approximations with `exp()'.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "sigmoid.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+///////////////
+// Constants //
+///////////////
+static const sigmoid_mode_t MODES[] = {SIGMOID_TABLE, SIGMOID_INTERP,
+                                       SIGMOID_POLY};
+static const size_t N_MODES = sizeof(MODES) / sizeof(MODES[0]);
+/** @brief Number of scores in a batch */
+static const long long BATCH = 4096;
+/** @brief Total number of scores evaluated per measurement */
+static const long long WORK = 400000000;
+/** @brief Number of points at which the accuracy is measured */
+static const long long N_POINTS = 1200001;
+
+/////////////
+// Methods //
+/////////////
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void exp_batch(const real *a_scores, real *a_out, long long a_n) {
+  long long i;
+  real f;
+  for (i = 0; i < a_n; ++i) {
+    f = a_scores[i];
+    a_out[i] = f > MAX_EXP? 1: (f < -MAX_EXP? 0: 1 / (1 + expf(-f)));
+  }
+}
+
+static void measure_error(const sigmoid_t *a_sigmoid, double *a_max_err,
+                          double *a_mean_err) {
+  long long i;
+  real f, s;
+  double err;
+  *a_max_err = *a_mean_err = 0;
+  for (i = 0; i < N_POINTS; ++i) {
+    /* stay strictly below MAX_EXP, which is the domain of the table */
+    f = -MAX_EXP + (2. * MAX_EXP - 1e-4) * i / (N_POINTS - 1);
+    if (a_sigmoid)
+      sigmoid_batch(a_sigmoid, &f, &s, 1);
+    else
+      exp_batch(&f, &s, 1);
+    err = fabs(s - 1 / (1 + exp(-(double) f)));
+    if (err > *a_max_err)
+      *a_max_err = err;
+    *a_mean_err += err;
+  }
+  *a_mean_err /= N_POINTS;
+}
+
+static double measure_throughput(const sigmoid_t *a_sigmoid,
+                                 const real *a_scores, real *a_out) {
+  long long r, reps = WORK / BATCH;
+  double t = now();
+  for (r = 0; r < reps; ++r) {
+    if (a_sigmoid)
+      sigmoid_batch(a_sigmoid, a_scores, a_out, BATCH);
+    else
+      exp_batch(a_scores, a_out, BATCH);
+  }
+  return reps * BATCH / (now() - t) / 1e6;
+}
+
+static void report(const char *a_name, const sigmoid_t *a_sigmoid,
+                   const real *a_scores, real *a_out) {
+  double max_err, mean_err;
+  measure_error(a_sigmoid, &max_err, &mean_err);
+  printf("%-8s %12.3e %12.3e %12.1f\n", a_name, max_err, mean_err,
+         measure_throughput(a_sigmoid, a_scores, a_out));
+}
+
+int main(void) {
+  real *scores = (real *) malloc(BATCH * sizeof(real));
+  real *out = (real *) malloc(BATCH * sizeof(real));
+  unsigned long long next_random = 1;
+  sigmoid_t sigmoid;
+  long long i;
+  size_t m;
+
+  if (scores == NULL || out == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    return EXIT_FAILURE;
+  }
+  /* scores slightly exceed the range of the table, like in training */
+  for (i = 0; i < BATCH; ++i) {
+    next_random = next_random * (unsigned long long)25214903917 + 11;
+    scores[i] = (((next_random & 0xFFFF) / (real)65536) - 0.5) * 2.5 * MAX_EXP;
+  }
+
+  printf("%-8s %12s %12s %12s\n", "method", "max error", "mean error",
+         "M/s");
+  report("exp", NULL, scores, out);
+  for (m = 0; m < N_MODES; ++m) {
+    init_sigmoid(&sigmoid, MODES[m]);
+    report(sigmoid_mode2str(MODES[m]), &sigmoid, scores, out);
+    free_sigmoid(&sigmoid);
+  }
+  free(scores);
+  free(out);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+
+##################################################################
+# Measure training throughput (words/sec) of word2vec for a growing
+# number of threads and every synchronization mode.
+#
+# Usage: scaling.sh BIN TRAIN_FILE [MAX_THREADS] [EXTRA_OPTIONS...]
+
+##################################################################
+# Variables
+BIN=${1}
+INPUT=${2}
+MAX_THREADS=${3:-`nproc`}
+if test $# -ge 3; then
+    shift 3
+else
+    shift $#
+fi
+MODES='hogwild mutex striped'
+
+if test -z "${BIN}" || test -z "${INPUT}"; then
+    echo "Usage: ${0} BIN TRAIN_FILE [MAX_THREADS] [EXTRA_OPTIONS...]" >&2
+    exit 1
+fi
+
+##################################################################
+# Main
+printf '%-10s %8s %12s %12s\n' 'sync' 'threads' 'words/sec' 'time (sec)'
+for mode in ${MODES}; do
+    threads=1
+    while test ${threads} -le ${MAX_THREADS}; do
+        stats=`${BIN} -train "${INPUT}" -output /dev/null -debug 1 \
+                 -threads ${threads} -sync ${mode} "$@" 2>&1 | \
+               sed -n 's/^Training time: \([0-9.]*\) sec.*Words\/sec: \([0-9.]*k\).*/\2 \1/p'`
+        printf '%-10s %8d %12s %12s\n' ${mode} ${threads} ${stats}
+        threads=`expr ${threads} + 1`
+    done
+done
@@ -0,0 +1,170 @@
+//////////////
+// Includes //
+//////////////
+#include "checkpoint.h"
+
+#include <errno.h>   /* ETIMEDOUT */
+#include <stdio.h>   /* rename(), snprintf() */
+#include <time.h>    /* clock_gettime() */
+
+/////////////
+// Methods //
+/////////////
+
+void init_checkpointer(checkpointer_t *a_checkpointer, const opt_t *a_opts,
+                       const vocab_t *a_vocab, const nnet_t *a_nnet,
+                       const multiclass_t *a_multiclass,
+                       const long long a_train_size, const int a_corpus,
+                       const checkpoint_state_t *a_resume) {
+  const int num_threads = a_opts->m_num_threads;
+  int i;
+  a_checkpointer->m_opts = a_opts;
+  a_checkpointer->m_vocab = a_vocab;
+  a_checkpointer->m_nnet = a_nnet;
+  a_checkpointer->m_multiclass = a_multiclass;
+  a_checkpointer->m_state_size = sizeof(checkpoint_state_t)
+                                 + num_threads * sizeof(progress_t);
+  a_checkpointer->m_state = (checkpoint_state_t *) calloc(
+      1, a_checkpointer->m_state_size);
+  a_checkpointer->m_progress = (progress_t *) calloc(num_threads,
+                                                     sizeof(progress_t));
+  a_checkpointer->m_locks = (pthread_mutex_t *) malloc(
+      num_threads * sizeof(pthread_mutex_t));
+  if (a_checkpointer->m_state == NULL || a_checkpointer->m_progress == NULL
+      || a_checkpointer->m_locks == NULL) {
+    fprintf(stderr, "Could not allocate memory for checkpoints.\n");
+    exit(EXIT_FAILURE);
+  }
+  a_checkpointer->m_state->m_num_threads = num_threads;
+  a_checkpointer->m_state->m_train_size = a_train_size;
+  a_checkpointer->m_state->m_corpus = a_corpus;
+  a_checkpointer->m_state->m_seq = a_resume? a_resume->m_seq: 0;
+  for (i = 0; i < num_threads; ++i) {
+    pthread_mutex_init(&a_checkpointer->m_locks[i], NULL);
+    if (a_resume)
+      a_checkpointer->m_progress[i] = a_resume->m_progress[i];
+    else
+      a_checkpointer->m_progress[i].m_local_iter = -1;
+  }
+  pthread_mutex_init(&a_checkpointer->m_mutex, NULL);
+  pthread_cond_init(&a_checkpointer->m_cond, NULL);
+  a_checkpointer->m_stop = a_checkpointer->m_running = 0;
+}
+
+void write_checkpoint(checkpointer_t *a_checkpointer) {
+  const opt_t *opts = a_checkpointer->m_opts;
+  checkpoint_state_t *state = a_checkpointer->m_state;
+  char tmp_path[MAX_STRING + 8];
+  int i;
+  /* copy the progress first, so that the matrices written afterwards
+     already contain all updates up to this point */
+  for (i = 0; i < state->m_num_threads; ++i) {
+    pthread_mutex_lock(&a_checkpointer->m_locks[i]);
+    state->m_progress[i] = a_checkpointer->m_progress[i];
+    pthread_mutex_unlock(&a_checkpointer->m_locks[i]);
+  }
+  ++state->m_seq;
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", opts->m_checkpoint_file);
+  save_model(tmp_path, opts, a_checkpointer->m_vocab, a_checkpointer->m_nnet,
+             a_checkpointer->m_multiclass, state, a_checkpointer->m_state_size);
+  if (rename(tmp_path, opts->m_checkpoint_file)) {
+    fprintf(stderr, "ERROR: could not rename checkpoint '%s' to '%s'\n",
+            tmp_path, opts->m_checkpoint_file);
+    exit(EXIT_FAILURE);
+  }
+  if (opts->m_debug_mode > 1)
+    fprintf(stderr, "\nCheckpoint %lld written to '%s'\n",
+            (long long) state->m_seq, opts->m_checkpoint_file);
+}
+
+static void *checkpoint_thread(void *a_checkpointer) {
+  checkpointer_t *checkpointer = (checkpointer_t *) a_checkpointer;
+  struct timespec deadline;
+  int ret;
+  pthread_mutex_lock(&checkpointer->m_mutex);
+  while (!checkpointer->m_stop) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += checkpointer->m_opts->m_checkpoint_interval;
+    ret = 0;
+    while (!checkpointer->m_stop && ret != ETIMEDOUT)
+      ret = pthread_cond_timedwait(&checkpointer->m_cond,
+                                   &checkpointer->m_mutex, &deadline);
+    if (checkpointer->m_stop)
+      break;
+
+    pthread_mutex_unlock(&checkpointer->m_mutex);
+    write_checkpoint(checkpointer);
+    pthread_mutex_lock(&checkpointer->m_mutex);
+  }
+  pthread_mutex_unlock(&checkpointer->m_mutex);
+  return NULL;
+}
+
+void start_checkpointer(checkpointer_t *a_checkpointer) {
+  if (a_checkpointer->m_opts->m_checkpoint_interval <= 0)
+    return;
+
+  pthread_create(&a_checkpointer->m_thread, NULL, checkpoint_thread,
+                 (void *) a_checkpointer);
+  a_checkpointer->m_running = 1;
+}
+
+void stop_checkpointer(checkpointer_t *a_checkpointer) {
+  if (!a_checkpointer->m_running)
+    return;
+
+  pthread_mutex_lock(&a_checkpointer->m_mutex);
+  a_checkpointer->m_stop = 1;
+  pthread_cond_signal(&a_checkpointer->m_cond);
+  pthread_mutex_unlock(&a_checkpointer->m_mutex);
+  pthread_join(a_checkpointer->m_thread, NULL);
+  a_checkpointer->m_running = 0;
+}
+
+void free_checkpointer(checkpointer_t *a_checkpointer) {
+  int i;
+  stop_checkpointer(a_checkpointer);
+  for (i = 0; i < a_checkpointer->m_state->m_num_threads; ++i)
+    pthread_mutex_destroy(&a_checkpointer->m_locks[i]);
+  pthread_mutex_destroy(&a_checkpointer->m_mutex);
+  pthread_cond_destroy(&a_checkpointer->m_cond);
+  free(a_checkpointer->m_locks);
+  free(a_checkpointer->m_progress);
+  free(a_checkpointer->m_state);
+  a_checkpointer->m_locks = NULL;
+  a_checkpointer->m_progress = NULL;
+  a_checkpointer->m_state = NULL;
+}
+
+const checkpoint_state_t *open_checkpoint(model_t *a_model, const char *a_path,
+                                          const opt_t *a_opts) {
+  if (open_model(a_model, a_path)) {
+    fprintf(stderr, "ERROR: could not read checkpoint '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  const checkpoint_state_t *state = (const checkpoint_state_t *)
+                                    a_model->m_state;
+  const model_header_t *header = a_model->m_header;
+  if (state == NULL
+      || (size_t) header->m_state_size < sizeof(checkpoint_state_t)
+      || (size_t) header->m_state_size != sizeof(checkpoint_state_t)
+      + state->m_num_threads * sizeof(progress_t)) {
+    fprintf(stderr, "ERROR: '%s' is not a checkpoint\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  if (header->m_layer1_size != a_opts->m_layer1_size
+      || header->m_cbow != a_opts->m_cbow || header->m_hs != a_opts->m_hs
+      || (header->m_negative > 0) != (a_opts->m_negative > 0)
+      || header->m_window != a_opts->m_window
+      || state->m_corpus != (a_opts->m_corpus_file[0] != '\0')) {
+    fprintf(stderr, "ERROR: checkpoint '%s' was written with different "
+            "options (-size %lld -cbow %lld -hs %lld -negative %lld "
+            "-window %lld%s)\n", a_path,
+            (long long) header->m_layer1_size, (long long) header->m_cbow,
+            (long long) header->m_hs, (long long) header->m_negative,
+            (long long) header->m_window, state->m_corpus? " -corpus": "");
+    exit(EXIT_FAILURE);
+  }
+  return state;
+}
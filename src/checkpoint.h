@@ -0,0 +1,177 @@
+/**
+ * @file checkpoint.h
+ * @brief Declaration of periodic checkpoints of the training state.
+ *
+ * A checkpoint is a native model file (see #model_header_t) whose
+ * training state section holds a #checkpoint_state_t, i.e., the
+ * progress of every training thread.  Checkpoints are written by a
+ * background thread while training continues: the threads only
+ * publish their progress at sentence boundaries, and the writer copies
+ * these records before it dumps the (still changing) matrices.  The
+ * stored matrices are therefore at least as recent as the stored
+ * progress, and resuming merely repeats the last few sentences of each
+ * thread, which is no different from the usual races of lock-free
+ * training.  The file is written under a temporary name and renamed
+ * afterwards, so that a crash never destroys the previous checkpoint.
+ * A final checkpoint is written when training ends.
+ */
+
+#ifndef __WORD2VEC_CHECKPOINT_H__
+# define __WORD2VEC_CHECKPOINT_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "vocab.h"
+#include "w2vio.h"
+
+#include <pthread.h>
+#include <stdint.h>  /* int64_t, uint64_t */
+#include <string.h>  /* memcpy() */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Progress of a single training thread.
+ */
+typedef struct {
+  int64_t m_local_iter;		/**< remaining iterations (`0' if the
+				   thread has finished, `-1' if it has
+				   not started yet) */
+  int64_t m_word_count;		/**< words read in the current iteration */
+  int64_t m_word_count_actual;	/**< words read in all iterations */
+  int64_t m_pos;		/**< position of the next sentence (byte
+				   offset in the text file or id position
+				   in the compiled corpus) */
+  int64_t m_line;		/**< corpus line of the next sentence */
+  int64_t m_eol;		/**< last corpus id terminated a line */
+  uint64_t m_next_random;	/**< state of the random generator */
+  double m_alpha;		/**< current learning rate */
+} progress_t;
+
+/**
+ * @brief Training state stored in a checkpoint.
+ */
+typedef struct {
+  int64_t m_num_threads;	/**< number of training threads */
+  int64_t m_train_size;		/**< size of the training file */
+  int64_t m_corpus;		/**< positions refer to a compiled corpus */
+  int64_t m_seq;		/**< number of the checkpoint */
+  progress_t m_progress[];	/**< progress of each thread */
+} checkpoint_state_t;
+
+/**
+ * @brief Background writer of checkpoints.
+ */
+typedef struct {
+  const opt_t *m_opts;		/**< command line options */
+  const vocab_t *m_vocab;	/**< vocabulary */
+  const nnet_t *m_nnet;		/**< trained neural net */
+  const multiclass_t *m_multiclass; /**< numbers of classes of tasks */
+  checkpoint_state_t *m_state;	/**< snapshot of the progress */
+  size_t m_state_size;		/**< size of `m_state' in bytes */
+  progress_t *m_progress;	/**< progress published by the threads */
+  pthread_mutex_t *m_locks;	/**< locks guarding `m_progress' */
+  pthread_t m_thread;		/**< writer thread */
+  pthread_mutex_t m_mutex;	/**< lock guarding `m_stop' */
+  pthread_cond_t m_cond;	/**< signals the end of training */
+  int m_stop;			/**< training has finished */
+  int m_running;		/**< writer thread has been started */
+} checkpointer_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Initialize checkpoint writer.
+ *
+ * @param a_checkpointer - writer to initialize
+ * @param a_opts - command line options (file and interval)
+ * @param a_vocab - vocabulary
+ * @param a_nnet - trained neural net
+ * @param a_multiclass - numbers of classes of the tasks
+ * @param a_train_size - size of the training file
+ * @param a_corpus - threads read from a compiled corpus
+ * @param a_resume - state of a resumed checkpoint (may be \c NULL)
+ *
+ * @return \c void
+ */
+void init_checkpointer(checkpointer_t *a_checkpointer, const opt_t *a_opts,
+                       const vocab_t *a_vocab, const nnet_t *a_nnet,
+                       const multiclass_t *a_multiclass,
+                       const long long a_train_size, const int a_corpus,
+                       const checkpoint_state_t *a_resume);
+
+/**
+ * Start writing checkpoints every `-checkpoint-interval' seconds.
+ *
+ * @param a_checkpointer - initialized writer
+ *
+ * @return \c void
+ */
+void start_checkpointer(checkpointer_t *a_checkpointer);
+
+/**
+ * Stop writing checkpoints in the background (waits for a checkpoint
+ * which is being written).
+ *
+ * @param a_checkpointer - writer to stop
+ *
+ * @return \c void
+ */
+void stop_checkpointer(checkpointer_t *a_checkpointer);
+
+/**
+ * Stop writing checkpoints and release the writer.
+ *
+ * @param a_checkpointer - writer to stop
+ *
+ * @return \c void
+ */
+void free_checkpointer(checkpointer_t *a_checkpointer);
+
+/**
+ * Write checkpoint with the most recently published progress.
+ *
+ * @param a_checkpointer - initialized writer
+ *
+ * @return \c void
+ */
+void write_checkpoint(checkpointer_t *a_checkpointer);
+
+/**
+ * Publish progress of a training thread.
+ *
+ * @param a_checkpointer - writer
+ * @param a_thread_id - index of the thread
+ * @param a_progress - current progress of the thread
+ *
+ * @return \c void
+ */
+static inline void publish_progress(checkpointer_t *a_checkpointer,
+                                    const long a_thread_id,
+                                    const progress_t *a_progress) {
+  pthread_mutex_lock(&a_checkpointer->m_locks[a_thread_id]);
+  memcpy(&a_checkpointer->m_progress[a_thread_id], a_progress,
+         sizeof(progress_t));
+  pthread_mutex_unlock(&a_checkpointer->m_locks[a_thread_id]);
+}
+
+/**
+ * Map checkpoint and check that it can be resumed with the given
+ * options (the number of threads is checked by the caller).
+ *
+ * @param a_model - model to populate
+ * @param a_path - path to the checkpoint
+ * @param a_opts - command line options
+ *
+ * @return \c const checkpoint_state_t* - stored training state (exits
+ *   on error)
+ */
+const checkpoint_state_t *open_checkpoint(model_t *a_model, const char *a_path,
+                                          const opt_t *a_opts);
+#endif  /* ifndef __WORD2VEC_CHECKPOINT_H__ */
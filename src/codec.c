@@ -0,0 +1,240 @@
+//////////////
+// Includes //
+//////////////
+#include "codec.h"
+#include "common.h"
+
+#include <errno.h>     /* errno */
+#include <fcntl.h>     /* open() */
+#include <stdio.h>     /* fprintf() */
+#include <stdlib.h>    /* malloc(), exit() */
+#include <string.h>    /* memcmp(), strerror() */
+#include <sys/stat.h>  /* stat() */
+#include <unistd.h>    /* pread(), read(), close() */
+#ifdef W2V_HAVE_ZLIB
+# include <zlib.h>
+#endif
+#ifdef W2V_HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+///////////////
+// Constants //
+///////////////
+/** size of the buffer of compressed data */
+static const size_t DECODER_BUFFER_SIZE = 1 << 18;
+
+static const unsigned char GZIP_MAGIC[] = {0x1f, 0x8b};
+static const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+/////////////
+// Methods //
+/////////////
+codec_t file_codec(const char *a_path) {
+  struct stat st;
+  if (stat(a_path, &st) || !S_ISREG(st.st_mode))
+    return CODEC_NONE;
+
+  int fd = open(a_path, O_RDONLY);
+  if (fd < 0)
+    return CODEC_NONE;
+
+  unsigned char magic[4];
+  ssize_t n_read = pread(fd, magic, sizeof(magic), 0);
+  close(fd);
+  if (n_read >= (ssize_t) sizeof(GZIP_MAGIC)
+      && memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)) == 0)
+    return CODEC_GZIP;
+  if (n_read >= (ssize_t) sizeof(ZSTD_MAGIC)
+      && memcmp(magic, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0)
+    return CODEC_ZSTD;
+  return CODEC_NONE;
+}
+
+const char *supported_codecs(void) {
+#if defined(W2V_HAVE_ZLIB) && defined(W2V_HAVE_ZSTD)
+  return "gzip, zstd";
+#elif defined(W2V_HAVE_ZLIB)
+  return "gzip";
+#elif defined(W2V_HAVE_ZSTD)
+  return "zstd";
+#else
+  return "none";
+#endif
+}
+
+const char *codec2str(const codec_t a_codec) {
+  switch (a_codec) {
+  case CODEC_NONE:
+    return "none";
+  case CODEC_GZIP:
+    return "gzip";
+  case CODEC_ZSTD:
+    return "zstd";
+  }
+  return "unknown";
+}
+
+static void corrupt_input(const decoder_t *a_decoder, const char *a_msg) {
+  fprintf(stderr, "ERROR: corrupt %s data: %s\n",
+          codec2str(a_decoder->m_codec), a_msg);
+  exit(EXIT_FAILURE);
+}
+
+/* refill the buffer of compressed data once it has been consumed,
+   return the number of available bytes */
+static size_t fill_input(decoder_t *a_decoder) {
+  if (a_decoder->m_in_pos == a_decoder->m_in_end) {
+    ssize_t n_read;
+    do {
+      n_read = read(a_decoder->m_fd, a_decoder->m_in, a_decoder->m_in_size);
+    } while (n_read < 0 && errno == EINTR);
+    if (n_read < 0) {
+      fprintf(stderr, "ERROR: could not read %s data: %s\n",
+              codec2str(a_decoder->m_codec), strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+    a_decoder->m_in_pos = 0;
+    a_decoder->m_in_end = n_read;
+  }
+  return a_decoder->m_in_end - a_decoder->m_in_pos;
+}
+
+#ifdef W2V_HAVE_ZLIB
+static size_t inflate_step(decoder_t *a_decoder, char *a_buf, size_t a_size) {
+  z_stream *zs = (z_stream *) a_decoder->m_state;
+  zs->next_in = a_decoder->m_in + a_decoder->m_in_pos;
+  zs->avail_in = a_decoder->m_in_end - a_decoder->m_in_pos;
+  zs->next_out = (unsigned char *) a_buf;
+  zs->avail_out = a_size;
+
+  int ret = inflate(zs, Z_NO_FLUSH);
+  a_decoder->m_in_pos = a_decoder->m_in_end - zs->avail_in;
+  if (ret == Z_STREAM_END) {
+    /* concatenated members form a single file */
+    inflateReset(zs);
+    a_decoder->m_in_frame = 0;
+  } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+    a_decoder->m_in_frame = 1;
+  } else {
+    corrupt_input(a_decoder, zs->msg? zs->msg: "inflate() failed");
+  }
+  return a_size - zs->avail_out;
+}
+#endif
+
+#ifdef W2V_HAVE_ZSTD
+static size_t zstd_step(decoder_t *a_decoder, char *a_buf, size_t a_size) {
+  ZSTD_inBuffer in = {a_decoder->m_in + a_decoder->m_in_pos,
+                      a_decoder->m_in_end - a_decoder->m_in_pos, 0};
+  ZSTD_outBuffer out = {a_buf, a_size, 0};
+  size_t ret = ZSTD_decompressStream((ZSTD_DStream *) a_decoder->m_state,
+                                     &out, &in);
+  if (ZSTD_isError(ret))
+    corrupt_input(a_decoder, ZSTD_getErrorName(ret));
+
+  a_decoder->m_in_pos += in.pos;
+  /* a zero hint means that a frame has been completely flushed */
+  a_decoder->m_in_frame = ret != 0;
+  return out.pos;
+}
+#endif
+
+void init_decoder(decoder_t *a_decoder, int a_fd, const codec_t a_codec) {
+  a_decoder->m_codec = a_codec;
+  a_decoder->m_fd = a_fd;
+  a_decoder->m_in_size = DECODER_BUFFER_SIZE;
+  a_decoder->m_in = (unsigned char *) malloc(a_decoder->m_in_size);
+  a_decoder->m_in_pos = a_decoder->m_in_end = 0;
+  a_decoder->m_state = NULL;
+  a_decoder->m_in_frame = a_decoder->m_end = 0;
+  if (a_decoder->m_in == NULL) {
+    fprintf(stderr, "Could not allocate memory for decompression.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  switch (a_codec) {
+#ifdef W2V_HAVE_ZLIB
+  case CODEC_GZIP: {
+    z_stream *zs = (z_stream *) calloc(1, sizeof(z_stream));
+    /* 32: detect gzip or zlib header */
+    if (zs == NULL || inflateInit2(zs, 15 + 32) != Z_OK) {
+      fprintf(stderr, "Could not initialize zlib.\n");
+      exit(EXIT_FAILURE);
+    }
+    a_decoder->m_state = zs;
+    break;
+  }
+#endif
+#ifdef W2V_HAVE_ZSTD
+  case CODEC_ZSTD:
+    a_decoder->m_state = ZSTD_createDStream();
+    if (a_decoder->m_state == NULL
+        || ZSTD_isError(ZSTD_initDStream(a_decoder->m_state))) {
+      fprintf(stderr, "Could not initialize libzstd.\n");
+      exit(EXIT_FAILURE);
+    }
+    break;
+#endif
+  default:
+    fprintf(stderr, "ERROR: reading %s files is not supported by this "
+            "build.\n", codec2str(a_codec));
+    exit(EXIT_FAILURE);
+  }
+}
+
+ssize_t decoder_read(decoder_t *a_decoder, char *a_buf, size_t a_size) {
+  size_t avail, produced = 0;
+  while (!a_decoder->m_end && produced == 0) {
+    avail = fill_input(a_decoder);
+    if (avail == 0 && !a_decoder->m_in_frame) {
+      a_decoder->m_end = 1;
+      break;
+    }
+    switch (a_decoder->m_codec) {
+#ifdef W2V_HAVE_ZLIB
+    case CODEC_GZIP:
+      produced = inflate_step(a_decoder, a_buf, a_size);
+      break;
+#endif
+#ifdef W2V_HAVE_ZSTD
+    case CODEC_ZSTD:
+      produced = zstd_step(a_decoder, a_buf, a_size);
+      break;
+#endif
+    default:
+      /* init_decoder() rejects formats which were not built */
+      UNUSED(a_buf);
+      UNUSED(a_size);
+      break;
+    }
+    /* the decompressor may still flush output after the input has been
+       consumed, but otherwise the file ends in the middle of a frame */
+    if (produced == 0 && avail == 0)
+      corrupt_input(a_decoder, "unexpected end of file");
+  }
+  return produced;
+}
+
+void free_decoder(decoder_t *a_decoder) {
+  switch (a_decoder->m_codec) {
+#ifdef W2V_HAVE_ZLIB
+  case CODEC_GZIP:
+    if (a_decoder->m_state) {
+      inflateEnd((z_stream *) a_decoder->m_state);
+      free(a_decoder->m_state);
+    }
+    break;
+#endif
+#ifdef W2V_HAVE_ZSTD
+  case CODEC_ZSTD:
+    ZSTD_freeDStream((ZSTD_DStream *) a_decoder->m_state);
+    break;
+#endif
+  default:
+    break;
+  }
+  free(a_decoder->m_in);
+  a_decoder->m_in = NULL;
+  a_decoder->m_state = NULL;
+}
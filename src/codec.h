@@ -0,0 +1,119 @@
+/**
+ * @file codec.h
+ * @brief Declaration of transparent decompression of training files.
+ *
+ * Compressed files are recognized by their magic bytes, so that no
+ * particular file name extension is required.  Gzip files (including
+ * concatenated members as produced by `pigz' or `bgzip') are read with
+ * zlib, Zstandard files (including multiple frames) with libzstd.
+ * Support for each format is only compiled in if the respective
+ * library was found at build time (`W2V_HAVE_ZLIB', `W2V_HAVE_ZSTD').
+ */
+
+#ifndef __WORD2VEC_CODEC_H__
+# define __WORD2VEC_CODEC_H__
+
+//////////////
+// Includes //
+//////////////
+#include <stddef.h>     /* size_t */
+#include <sys/types.h>  /* ssize_t */
+
+//////////////
+// typedefs //
+//////////////
+
+/**
+ * @typedef codec_t
+ * @brief compression format of a file
+ */
+typedef enum {
+  CODEC_NONE = 0,		/**< plain text */
+  CODEC_GZIP,			/**< gzip (deflate) */
+  CODEC_ZSTD			/**< Zstandard */
+} codec_t;
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Decompressor of a file descriptor.
+ */
+typedef struct {
+  codec_t m_codec;		/**< compression format */
+  int m_fd;			/**< compressed file */
+  unsigned char *m_in;		/**< buffer of compressed data */
+  size_t m_in_size;		/**< capacity of `m_in' */
+  size_t m_in_pos;		/**< first unconsumed byte of `m_in' */
+  size_t m_in_end;		/**< end of valid data in `m_in' */
+  void *m_state;		/**< state of the decompression library */
+  int m_in_frame;		/**< a gzip member or a zstd frame has
+				   been started but not finished */
+  int m_end;			/**< the end of the compressed data has
+				   been reached */
+} decoder_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Determine compression format of a regular file from its first
+ * bytes (other files are never read).
+ *
+ * @param a_path - path to the file
+ *
+ * @return \c codec_t - compression format
+ */
+codec_t file_codec(const char *a_path);
+
+/**
+ * List the compression formats which can be read.
+ *
+ * @return \c const char* - comma-separated names of the formats
+ *   (`none' if no format is supported)
+ */
+const char *supported_codecs(void);
+
+/**
+ * Convert compression format to its name.
+ *
+ * @param a_codec - compression format
+ *
+ * @return \c const char* - name of the format
+ */
+const char *codec2str(const codec_t a_codec);
+
+/**
+ * Start decompressing a file from its current position.
+ *
+ * @param a_decoder - decoder to initialize
+ * @param a_fd - file descriptor of the compressed file
+ * @param a_codec - compression format of the file (must be supported)
+ *
+ * @return \c void
+ */
+void init_decoder(decoder_t *a_decoder, int a_fd, const codec_t a_codec);
+
+/**
+ * Decompress data (counterpart of `read()').
+ *
+ * @param a_decoder - decoder
+ * @param a_buf - output buffer
+ * @param a_size - capacity of the output buffer
+ *
+ * @return \c ssize_t - number of decompressed bytes, \c 0 at the end
+ *   of the file (exits if the data are corrupt)
+ */
+ssize_t decoder_read(decoder_t *a_decoder, char *a_buf, size_t a_size);
+
+/**
+ * Release the decoder (the file descriptor is not closed).
+ *
+ * @param a_decoder - decoder to release
+ *
+ * @return \c void
+ */
+void free_decoder(decoder_t *a_decoder);
+#endif  /* ifndef __WORD2VEC_CODEC_H__ */
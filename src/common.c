@@ -4,6 +4,7 @@
 #include "common.h"
 
 #include <stdio.h>
+#include <string.h>  /* strcpy() */
 
 /////////////
 // Methods //
@@ -12,6 +13,13 @@
 void reset_opt(opt_t *opt) {
   opt->m_train_file[0] = '\0';
   opt->m_output_file[0] = '\0';
+  strcpy(opt->m_isa, "auto");
+  opt->m_corpus_file[0] = '\0';
+  opt->m_model_file[0] = '\0';
+  opt->m_checkpoint_file[0] = '\0';
+  opt->m_resume_file[0] = '\0';
+  opt->m_read_vocab_file[0] = '\0';
+  opt->m_save_vocab_file[0] = '\0';
 
   opt->m_layer1_size = 100;
   opt->m_iter = 5;
@@ -24,12 +32,29 @@ void reset_opt(opt_t *opt) {
   opt->m_debug_mode = 2;
   opt->m_hs = 0;
   opt->m_min_count = 5;
-  opt->m_min_reduce = 1;
   opt->m_negative = 5;
   opt->m_num_threads = 12;
+  opt->m_vocab_threads = 0;
   opt->m_window = 5;
+  opt->m_minibatch = 0;
 
   opt->m_ts = 0;
   opt->m_ts_w2v = 0;
   opt->m_ts_least_sq = 0;
+
+  opt->m_sync = SYNC_HOGWILD;
+  opt->m_sync_stripes = 1024;
+  opt->m_sampler = SAMPLER_TABLE;
+  opt->m_sampler_power = 0.75;
+  opt->m_sigmoid = SIGMOID_TABLE;
+  opt->m_numa = NUMA_NONE;
+  opt->m_pin = 0;
+  opt->m_huge_pages = HUGE_PAGES_NONE;
+  opt->m_checkpoint_interval = 600;
+  opt->m_stop_after = 0;
+  opt->m_schedule = SCHEDULE_STATIC;
+  opt->m_chunk_size = 1 << 20;
+  opt->m_shuffle = 0;
+  opt->m_stream_buffer = 16;
+  opt->m_read_threads = 0;
 }
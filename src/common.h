@@ -17,10 +17,14 @@
 
 /** @brief Maximum length of stored string. */
 # define MAX_STRING 100
+/** @brief Maximum length of the comma-separated list of training files. */
+# define MAX_FILE_LIST 4096
 /** @brief Maximum number of user-defined tasks to train. */
 # define MAX_TASKS 1024
 /** @brief Custom macro to prevent warning about unused variables. */
 # define UNUSED(x) (void)(x)
+/** @brief Value of `-binary' storing vectors as 16-bit floats. */
+# define BINARY_HALF 2
 
 //////////////
 // typedefs //
@@ -37,6 +41,67 @@ typedef struct opt opt_t;
  */
 typedef float real;                    // Precision of float numbers
 
+/**
+ * @typedef sync_mode_t
+ * @brief synchronization strategy for concurrent model updates
+ */
+typedef enum {
+  SYNC_HOGWILD = 0,		/**< lock-free updates (default) */
+  SYNC_MUTEX,			/**< serialize updates through a single lock */
+  SYNC_STRIPED			/**< lock only the updated rows */
+} sync_mode_t;
+
+/**
+ * @typedef sampler_mode_t
+ * @brief method of drawing negative examples
+ */
+typedef enum {
+  SAMPLER_TABLE = 0,		/**< original unigram table (default) */
+  SAMPLER_ALIAS			/**< Walker's alias method */
+} sampler_mode_t;
+
+/**
+ * @typedef sigmoid_mode_t
+ * @brief approximation of the logistic sigmoid
+ */
+typedef enum {
+  SIGMOID_TABLE = 0,		/**< table lookup of the original word2vec
+				   (default) */
+  SIGMOID_INTERP,		/**< linear interpolation of table entries */
+  SIGMOID_POLY			/**< rational approximation */
+} sigmoid_mode_t;
+
+/**
+ * @typedef numa_mode_t
+ * @brief placement of model matrices across NUMA nodes
+ */
+typedef enum {
+  NUMA_NONE = 0,		/**< default first-touch placement */
+  NUMA_INTERLEAVE,		/**< pages interleaved across all nodes */
+  NUMA_PARTITION		/**< one contiguous block of rows per node */
+} numa_mode_t;
+
+/**
+ * @typedef huge_pages_mode_t
+ * @brief kind of pages requested for model matrices
+ */
+typedef enum {
+  HUGE_PAGES_NONE = 0,		/**< regular pages */
+  HUGE_PAGES_THP,		/**< transparent huge pages */
+  HUGE_PAGES_EXPLICIT		/**< reserved huge pages, falling back to
+				   transparent ones */
+} huge_pages_mode_t;
+
+/**
+ * @typedef schedule_mode_t
+ * @brief distribution of training data among threads
+ */
+typedef enum {
+  SCHEDULE_STATIC = 0,		/**< one fixed share of the data per thread */
+  SCHEDULE_STEAL		/**< chunks which idle threads steal from
+				   busy ones */
+} schedule_mode_t;
+
 /////////////
 // Structs //
 /////////////
@@ -66,8 +131,15 @@ typedef struct {
  * @brief command line options.
  */
 struct opt {
-  char m_train_file[MAX_STRING]; /**< name of the input file  */
+  char m_train_file[MAX_FILE_LIST]; /**< names of the input files  */
   char m_output_file[MAX_STRING]; /**< name of the output file  */
+  char m_isa[MAX_STRING]; /**< instruction set of vector kernels */
+  char m_corpus_file[MAX_STRING]; /**< name of the compiled corpus */
+  char m_model_file[MAX_STRING]; /**< name of the native model file */
+  char m_checkpoint_file[MAX_STRING]; /**< name of the checkpoint file */
+  char m_resume_file[MAX_STRING]; /**< checkpoint to resume from */
+  char m_read_vocab_file[MAX_STRING]; /**< pre-built vocabulary */
+  char m_save_vocab_file[MAX_STRING]; /**< file to save the vocabulary to */
 
   long long m_layer1_size;	/**< dimensionality of the embeddings */
   long long m_iter;		/**< number of iterations to run */
@@ -75,17 +147,24 @@ struct opt {
   real m_alpha;			/**< Update rate for gradient descent.  */
   real m_sample;		/**< randomly discard frequent words
 				   while keeping the ranking same */
-  int m_binary;			/**< Store resulting embeddings in the binary format. */
+  int m_binary;			/**< Store resulting embeddings in the
+				   binary format (as 16-bit floats if
+				   equal to `BINARY_HALF'). */
   int m_cbow;			/**< Use continuous bag of words if > 0. */
   int m_debug_mode;		/**< Turn on debug messages. */
   int m_hs;			/**< Use hierarchical softmax if > 0.  */
   int m_min_count;		/**< Minimum number of occurrences for a word to be analyzed. */
-  int m_min_reduce;		/**< Reduce vocabulary. */
   int m_negative;    /**< Use negative sampling for word2vec
 			embeddings */
   int m_num_threads;		/**< Maximum number of threads to use. */
+  int m_vocab_threads;		/**< Number of threads counting the
+				   vocabulary (same as `m_num_threads'
+				   if <= 0). */
   int m_ts;			/**< Train task-specific embeddings only. */
   int m_window;			/**< Size of context window. */
+  int m_minibatch;		/**< Share negative samples among all
+				   context words of a skip-gram window
+				   if > 0. */
   int m_ts_w2v;			/**< Simultaneously train
 				   task-specific and word2vec
 				   embeddings.  */
@@ -97,6 +176,29 @@ struct opt {
    *  latter representation.
    */
   int m_ts_least_sq;
+  sync_mode_t m_sync;		/**< synchronization of model updates */
+  sampler_mode_t m_sampler;	/**< sampler of negative examples */
+  double m_sampler_power;	/**< exponent of the smoothed unigram
+				   distribution of negative examples */
+  sigmoid_mode_t m_sigmoid;	/**< approximation of the sigmoid */
+  numa_mode_t m_numa;		/**< placement of model matrices */
+  int m_pin;			/**< pin training threads to CPUs */
+  huge_pages_mode_t m_huge_pages; /**< pages backing model matrices */
+  int m_sync_stripes;		/**< number of locks in striped mode */
+  int m_checkpoint_interval;	/**< seconds between checkpoints */
+  long long m_stop_after;	/**< words after which each thread stops
+				   training (0 to train to the end) */
+  schedule_mode_t m_schedule;	/**< distribution of data among threads */
+  long long m_chunk_size;	/**< bytes per chunk of the `steal'
+				   schedule */
+  unsigned long long m_shuffle;	/**< seed of the per-epoch shuffle of
+				   chunks (0 if not shuffled) */
+  int m_stream_buffer;		/**< number of batches buffered between
+				   the stream reader and the training
+				   threads */
+  int m_read_threads;		/**< number of threads reading shards of
+				   streamed data (0 for as many as
+				   shards or training threads) */
 };
 
 /**
@@ -0,0 +1,291 @@
+//////////////
+// Includes //
+//////////////
+#include "corpus.h"
+#include "w2vio.h"
+
+#include <fcntl.h>     /* open() */
+#include <stdio.h>     /* fopen(), fwrite() */
+#include <string.h>    /* memcmp(), memset() */
+#include <sys/mman.h>  /* mmap() */
+#include <sys/stat.h>  /* stat() */
+#include <unistd.h>    /* close() */
+
+///////////////
+// Constants //
+///////////////
+static const char CORPUS_MAGIC[8] = "W2VCRPS";
+static const int64_t CORPUS_VERSION = 1;
+/** number of ids buffered before being written to disk */
+static const size_t ID_BUFFER_SIZE = 1 << 16;
+
+/////////////
+// Methods //
+/////////////
+void *grow_corpus_array(void *a_array, size_t *a_capacity,
+                        const size_t a_required, const size_t a_elem_size) {
+  if (a_required <= *a_capacity)
+    return a_array;
+
+  if (*a_capacity == 0)
+    *a_capacity = 1024;
+  while (*a_capacity < a_required)
+    *a_capacity *= 2;
+  a_array = realloc(a_array, *a_capacity * a_elem_size);
+  if (a_array == NULL) {
+    fprintf(stderr, "Could not allocate memory for the corpus.\n");
+    exit(EXIT_FAILURE);
+  }
+  return a_array;
+}
+
+void reset_corpus_lines(corpus_lines_t *a_lines) {
+  a_lines->m_lines = grow_corpus_array(a_lines->m_lines,
+                                       &a_lines->m_lines_capacity, 1,
+                                       sizeof(int64_t));
+  a_lines->m_lines[0] = 0;
+  a_lines->m_n_lines = 0;
+}
+
+/* close the current line at `a_end' with the labels read by
+   `a_reader' (unknown labels if `a_reader' is NULL) */
+static void add_corpus_line(corpus_lines_t *a_lines, reader_t *a_reader,
+                            const long long a_end, const int a_consume_tab,
+                            const size_t a_n_tasks) {
+  const size_t n_lines = a_lines->m_n_lines;
+  int active_tasks;
+  size_t i;
+  multiclass_t multiclass;
+  if (!a_consume_tab) {
+    memset(multiclass.m_classes, -1, sizeof(int) * MAX_TASKS);
+    if (a_reader) {
+      active_tasks = read_token_tags(a_reader, &multiclass);
+      if (active_tasks < 0) {
+        fprintf(stderr, "No active tasks found.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    a_lines->m_tags = grow_corpus_array(a_lines->m_tags,
+                                        &a_lines->m_tags_capacity,
+                                        (n_lines + 1) * a_n_tasks,
+                                        sizeof(int32_t));
+    for (i = 0; i < a_n_tasks; ++i)
+      a_lines->m_tags[n_lines * a_n_tasks + i] = multiclass.m_classes[i];
+  }
+  a_lines->m_lines = grow_corpus_array(a_lines->m_lines,
+                                       &a_lines->m_lines_capacity,
+                                       n_lines + 2, sizeof(int64_t));
+  a_lines->m_lines[n_lines + 1] = a_end;
+  a_lines->m_n_lines = n_lines + 1;
+}
+
+int read_corpus_id(reader_t *a_reader, const vocab_t *a_vocab,
+                   corpus_lines_t *a_lines, const long long a_n_ids,
+                   const int a_consume_tab, const size_t a_n_tasks) {
+  int word;
+  do {
+    word = read_token_index(a_reader, a_vocab, a_consume_tab);
+    if (reader_eof(a_reader)) {
+      /* incomplete last line */
+      if (a_lines->m_lines[a_lines->m_n_lines] != a_n_ids)
+        add_corpus_line(a_lines, NULL, a_n_ids, a_consume_tab, a_n_tasks);
+      return -1;
+    }
+  } while (word == -1);
+
+  /* end of line: remember its labels and the start of the next one */
+  if (word == 0)
+    add_corpus_line(a_lines, a_reader, a_n_ids + 1, a_consume_tab, a_n_tasks);
+  return word;
+}
+
+static int64_t align8(int64_t a_offset) {
+  return (a_offset + 7) & ~((int64_t) 7);
+}
+
+static void fill_header(corpus_header_t *a_header, const opt_t *a_opts,
+                        const vocab_t *a_vocab, const size_t a_n_tasks,
+                        const struct stat *a_train_stat) {
+  memset(a_header, 0, sizeof(corpus_header_t));
+  memcpy(a_header->m_magic, CORPUS_MAGIC, sizeof(CORPUS_MAGIC));
+  a_header->m_version = CORPUS_VERSION;
+  a_header->m_consume_tab = a_opts->m_ts <= 0 && a_opts->m_ts_w2v <= 0 \
+                            && a_opts->m_ts_least_sq <= 0;
+  a_header->m_n_tasks = a_header->m_consume_tab? 0: (int64_t) a_n_tasks;
+  a_header->m_vocab_size = a_vocab->m_vocab_size;
+  a_header->m_vocab_checksum = vocab_checksum(a_vocab);
+  a_header->m_train_size = a_train_stat->st_size;
+  a_header->m_train_mtime = a_train_stat->st_mtime;
+}
+
+static int is_compatible(const corpus_header_t *a_header,
+                         const corpus_header_t *a_expected) {
+  return memcmp(a_header->m_magic, a_expected->m_magic, sizeof(CORPUS_MAGIC)) == 0
+      && a_header->m_version == a_expected->m_version
+      && a_header->m_consume_tab == a_expected->m_consume_tab
+      && a_header->m_n_tasks == a_expected->m_n_tasks
+      && a_header->m_vocab_size == a_expected->m_vocab_size
+      && a_header->m_vocab_checksum == a_expected->m_vocab_checksum
+      && a_header->m_train_size == a_expected->m_train_size
+      && a_header->m_train_mtime == a_expected->m_train_mtime;
+}
+
+static void compile_corpus(const char *a_path, const opt_t *a_opts,
+                           const vocab_t *a_vocab, corpus_header_t *a_header) {
+  reader_t reader;
+  if (open_reader(&reader, a_opts->m_train_file, 0)) {
+    fprintf(stderr, "ERROR: training data file not found!\n");
+    exit(EXIT_FAILURE);
+  }
+  FILE *fo = fopen(a_path, "wb");
+  if (fo == NULL) {
+    fprintf(stderr, "ERROR: could not create compiled corpus '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  /* write a placeholder header, so that an interrupted compilation
+     is never mistaken for a valid corpus */
+  corpus_header_t header;
+  memset(&header, 0, sizeof(header));
+  fwrite(&header, sizeof(header), 1, fo);
+
+  const int consume_tab = (int) a_header->m_consume_tab;
+  const size_t n_tasks = (size_t) a_header->m_n_tasks;
+  int32_t *ids = (int32_t *) malloc(ID_BUFFER_SIZE * sizeof(int32_t));
+  corpus_lines_t layout = {NULL, NULL, 0, 0, 0};
+  size_t n_buffered = 0;
+  long long n_ids = 0;
+  int word;
+
+  reset_corpus_lines(&layout);
+  while ((word = read_corpus_id(&reader, a_vocab, &layout, n_ids, consume_tab,
+                                n_tasks)) >= 0) {
+    ids[n_buffered++] = word;
+    ++n_ids;
+    if (n_buffered == ID_BUFFER_SIZE) {
+      fwrite(ids, sizeof(int32_t), n_buffered, fo);
+      n_buffered = 0;
+    }
+  }
+  fwrite(ids, sizeof(int32_t), n_buffered, fo);
+  close_reader(&reader);
+  const size_t n_lines = layout.m_n_lines;
+
+  /* line offsets and labels */
+  static const char padding[8] = {0};
+  a_header->m_n_ids = n_ids;
+  a_header->m_n_lines = n_lines;
+  a_header->m_ids_offset = sizeof(corpus_header_t);
+  a_header->m_lines_offset = align8(a_header->m_ids_offset
+                                    + n_ids * sizeof(int32_t));
+  a_header->m_tags_offset = a_header->m_lines_offset
+                            + (n_lines + 1) * sizeof(int64_t);
+  fwrite(padding, 1, a_header->m_lines_offset - a_header->m_ids_offset
+         - n_ids * sizeof(int32_t), fo);
+  fwrite(layout.m_lines, sizeof(int64_t), n_lines + 1, fo);
+  if (n_tasks)
+    fwrite(layout.m_tags, sizeof(int32_t), n_lines * n_tasks, fo);
+
+  /* finally, write the actual header */
+  fseek(fo, 0, SEEK_SET);
+  fwrite(a_header, sizeof(corpus_header_t), 1, fo);
+  if (ferror(fo) || fclose(fo)) {
+    fprintf(stderr, "ERROR: writing compiled corpus '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  free(ids);
+  free(layout.m_lines);
+  free(layout.m_tags);
+}
+
+static int map_corpus(corpus_t *a_corpus, const char *a_path,
+                      const corpus_header_t *a_expected) {
+  int fd = open(a_path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t) st.st_size < sizeof(corpus_header_t)) {
+    close(fd);
+    return -1;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  const corpus_header_t *header = (const corpus_header_t *) map;
+  if (!is_compatible(header, a_expected)
+      || header->m_tags_offset + (int64_t) (header->m_n_lines
+                                            * header->m_n_tasks
+                                            * sizeof(int32_t))
+      > (int64_t) st.st_size) {
+    munmap(map, st.st_size);
+    return -1;
+  }
+  madvise(map, st.st_size, MADV_WILLNEED);
+
+  a_corpus->m_map = map;
+  a_corpus->m_map_size = st.st_size;
+  a_corpus->m_ids = (const int32_t *) ((const char *) map
+                                       + header->m_ids_offset);
+  a_corpus->m_lines = (const int64_t *) ((const char *) map
+                                         + header->m_lines_offset);
+  a_corpus->m_tags = (const int32_t *) ((const char *) map
+                                        + header->m_tags_offset);
+  a_corpus->m_n_ids = header->m_n_ids;
+  a_corpus->m_n_lines = header->m_n_lines;
+  a_corpus->m_n_tasks = header->m_n_tasks;
+  return 0;
+}
+
+void open_corpus(corpus_t *a_corpus, const char *a_path, const opt_t *a_opts,
+                 const vocab_t *a_vocab, const size_t a_n_tasks) {
+  struct stat train_stat;
+  if (stat(a_opts->m_train_file, &train_stat)) {
+    fprintf(stderr, "ERROR: training data file not found!\n");
+    exit(EXIT_FAILURE);
+  }
+  corpus_header_t header;
+  fill_header(&header, a_opts, a_vocab, a_n_tasks, &train_stat);
+  if (map_corpus(a_corpus, a_path, &header) == 0) {
+    if (a_opts->m_debug_mode > 0)
+      fprintf(stderr, "Reusing compiled corpus '%s'\n", a_path);
+  } else {
+    if (a_opts->m_debug_mode > 0)
+      fprintf(stderr, "Compiling corpus '%s'\n", a_path);
+
+    compile_corpus(a_path, a_opts, a_vocab, &header);
+    if (map_corpus(a_corpus, a_path, &header)) {
+      fprintf(stderr, "ERROR: could not map compiled corpus '%s'\n", a_path);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (a_opts->m_debug_mode > 0)
+    fprintf(stderr, "Corpus ids: %lld  lines: %lld\n",
+            a_corpus->m_n_ids, a_corpus->m_n_lines);
+}
+
+void close_corpus(corpus_t *a_corpus) {
+  if (a_corpus->m_map)
+    munmap(a_corpus->m_map, a_corpus->m_map_size);
+
+  a_corpus->m_map = NULL;
+  a_corpus->m_map_size = 0;
+  a_corpus->m_ids = NULL;
+  a_corpus->m_lines = NULL;
+  a_corpus->m_tags = NULL;
+  a_corpus->m_n_ids = a_corpus->m_n_lines = a_corpus->m_n_tasks = 0;
+}
+
+long long corpus_line_of(const corpus_t *a_corpus, long long a_pos) {
+  long long lo = 0, hi = a_corpus->m_n_lines, mid;
+  /* find the last line which starts at or before `a_pos' */
+  while (hi - lo > 1) {
+    mid = lo + (hi - lo) / 2;
+    if (a_corpus->m_lines[mid] <= a_pos)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file corpus.h
+ * @brief Declaration of the pre-tokenized binary corpus.
+ *
+ * A compiled corpus stores the training file as a packed array of
+ * vocabulary ids, so that the text has to be tokenized and hashed only
+ * once instead of once per epoch.  The file is laid out as follows:
+ *
+ *  - a #corpus_header_t;
+ *  - `m_n_ids' 32-bit vocabulary ids, where each line of the training
+ *    file is terminated by id `0' (the end-of-sentence mark) and
+ *    unknown words are omitted;
+ *  - `m_n_lines + 1' 64-bit offsets of the first id of each line
+ *    (the last entry is equal to `m_n_ids');
+ *  - `m_n_lines * m_n_tasks' 32-bit labels of user-defined tasks
+ *    (`-1' for unknown labels), only present in task-specific modes.
+ *
+ * The whole file is mapped into memory and shared by all training
+ * threads.
+ */
+
+#ifndef __WORD2VEC_CORPUS_H__
+# define __WORD2VEC_CORPUS_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "vocab.h"
+#include "w2vio.h"
+
+#include <stddef.h>  /* size_t */
+#include <stdint.h>  /* int32_t, int64_t */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Header of a compiled corpus file.
+ */
+typedef struct {
+  char m_magic[8];		/**< file signature ("W2VCRPS") */
+  int64_t m_version;		/**< version of the format */
+  int64_t m_n_ids;		/**< number of stored ids */
+  int64_t m_n_lines;		/**< number of lines */
+  int64_t m_n_tasks;		/**< number of labels per line */
+  int64_t m_consume_tab;	/**< tabs were treated as white spaces */
+  int64_t m_vocab_size;		/**< size of the vocabulary */
+  uint64_t m_vocab_checksum;	/**< checksum of the vocabulary */
+  int64_t m_train_size;		/**< size of the original training file */
+  int64_t m_train_mtime;	/**< modification time of the training file */
+  int64_t m_ids_offset;		/**< file offset of the ids */
+  int64_t m_lines_offset;	/**< file offset of the line offsets */
+  int64_t m_tags_offset;	/**< file offset of the labels */
+} corpus_header_t;
+
+/**
+ * @brief Compiled corpus mapped into memory.
+ */
+typedef struct {
+  void *m_map;			/**< start of the mapped file */
+  size_t m_map_size;		/**< size of the mapped file */
+  const int32_t *m_ids;		/**< vocabulary ids */
+  const int64_t *m_lines;	/**< offsets of line starts */
+  const int32_t *m_tags;	/**< task labels of each line */
+  long long m_n_ids;		/**< number of ids */
+  long long m_n_lines;		/**< number of lines */
+  long long m_n_tasks;		/**< number of labels per line */
+} corpus_t;
+
+/**
+ * @brief Line offsets and labels of a text being converted to ids.
+ */
+typedef struct {
+  int64_t *m_lines;		/**< offsets of line starts */
+  int32_t *m_tags;		/**< task labels of each line */
+  size_t m_n_lines;		/**< number of lines */
+  size_t m_lines_capacity;	/**< allocated size of `m_lines' */
+  size_t m_tags_capacity;	/**< allocated size of `m_tags' */
+} corpus_lines_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Make sure that a compiled version of the training file exists and
+ * map it into memory.
+ *
+ * An existing file is reused if it was compiled from the same
+ * training file with the same vocabulary; otherwise, it is
+ * (re-)created.
+ *
+ * @param a_corpus - corpus to populate
+ * @param a_path - path to the compiled corpus
+ * @param a_opts - command line options (training file and mode)
+ * @param a_vocab - vocabulary used to map words to ids
+ * @param a_n_tasks - number of user-defined tasks
+ *
+ * @return \c void
+ */
+void open_corpus(corpus_t *a_corpus, const char *a_path, const opt_t *a_opts,
+                 const vocab_t *a_vocab, const size_t a_n_tasks);
+
+/**
+ * Unmap compiled corpus.
+ *
+ * @param a_corpus - corpus to close
+ *
+ * @return \c void
+ */
+void close_corpus(corpus_t *a_corpus);
+
+/**
+ * Find the line which contains the given id position.
+ *
+ * @param a_corpus - compiled corpus
+ * @param a_pos - position of an id
+ *
+ * @return \c long long - index of the line
+ */
+long long corpus_line_of(const corpus_t *a_corpus, long long a_pos);
+
+/**
+ * Make sure that an array can hold at least the given number of
+ * elements.
+ *
+ * @param a_array - array to grow (may be \c NULL)
+ * @param a_capacity - allocated number of elements (updated)
+ * @param a_required - required number of elements
+ * @param a_elem_size - size of an element in bytes
+ *
+ * @return \c void* - possibly reallocated array
+ */
+void *grow_corpus_array(void *a_array, size_t *a_capacity,
+                        const size_t a_required, const size_t a_elem_size);
+
+/**
+ * Start a new sequence of lines (the first line starts at id `0').
+ *
+ * @param a_lines - lines to reset (their buffers are reused)
+ *
+ * @return \c void
+ */
+void reset_corpus_lines(corpus_lines_t *a_lines);
+
+/**
+ * Read the next vocabulary id of a text and record the lines of the
+ * text in the layout of compiled corpora.
+ *
+ * Unknown words are skipped.  When the id ends a line (id `0'), the
+ * labels of the line are read and the line is recorded, assuming that
+ * the caller stores the returned id after `a_n_ids' other ids.  At the
+ * end of the text, an incomplete last line is closed with unknown
+ * labels.
+ *
+ * @param a_reader - reader of the text
+ * @param a_vocab - vocabulary used to map words to ids
+ * @param a_lines - lines read so far (updated)
+ * @param a_n_ids - number of ids stored before this one
+ * @param a_consume_tab - tabs are white spaces (the text has no labels)
+ * @param a_n_tasks - number of labels per line
+ *
+ * @return \c int - vocabulary id or \c -1 at the end of the text
+ */
+int read_corpus_id(reader_t *a_reader, const vocab_t *a_vocab,
+                   corpus_lines_t *a_lines, const long long a_n_ids,
+                   const int a_consume_tab, const size_t a_n_tasks);
+#endif  /* ifndef __WORD2VEC_CORPUS_H__ */
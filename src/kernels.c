@@ -0,0 +1,320 @@
+//////////////
+// Includes //
+//////////////
+#include "kernels.h"
+
+#include <string.h>  /* strcmp() */
+
+#if defined(__x86_64__) || defined(__i386__)
+# define W2V_X86 1
+# include <immintrin.h>
+#endif
+
+/////////////
+// Methods //
+/////////////
+
+/* Note: the vectorized kernels assume that `real' is a single-precision
+   float. */
+
+/* scalar fallback */
+static real dot_scalar(const real *x, const real *y, long long n) {
+  long long i;
+  real f = 0;
+  for (i = 0; i < n; ++i)
+    f += x[i] * y[i];
+  return f;
+}
+
+static void axpy_scalar(real a, const real *x, real *y, long long n) {
+  long long i;
+  for (i = 0; i < n; ++i)
+    y[i] += a * x[i];
+}
+
+static void axpy2_scalar(real a, const real *x, real *y, real *e, long long n) {
+  long long i;
+  real xi, yi;
+  for (i = 0; i < n; ++i) {
+    xi = x[i];
+    yi = y[i];
+    e[i] += a * yi;
+    y[i] = yi + a * xi;
+  }
+}
+
+static void scale_scalar(real a, real *x, long long n) {
+  long long i;
+  for (i = 0; i < n; ++i)
+    x[i] *= a;
+}
+
+#ifdef W2V_X86
+/* SSE4.2 */
+__attribute__((target("sse4.2")))
+static real dot_sse42(const real *x, const real *y, long long n) {
+  long long i = 0;
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                   _mm_loadu_ps(y + i + 4)));
+  }
+  if (i + 4 <= n) {
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
+    i += 4;
+  }
+  s0 = _mm_add_ps(s0, s1);
+  s0 = _mm_hadd_ps(s0, s0);
+  s0 = _mm_hadd_ps(s0, s0);
+  real f = _mm_cvtss_f32(s0);
+  for (; i < n; ++i)
+    f += x[i] * y[i];
+  return f;
+}
+
+__attribute__((target("sse4.2")))
+static void axpy_sse42(real a, const real *x, real *y, long long n) {
+  long long i = 0;
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                    _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  for (; i < n; ++i)
+    y[i] += a * x[i];
+}
+
+__attribute__((target("sse4.2")))
+static void axpy2_sse42(real a, const real *x, real *y, real *e, long long n) {
+  long long i = 0;
+  real xi, yi;
+  __m128 va = _mm_set1_ps(a), vx, vy;
+  for (; i + 4 <= n; i += 4) {
+    vx = _mm_loadu_ps(x + i);
+    vy = _mm_loadu_ps(y + i);
+    _mm_storeu_ps(e + i, _mm_add_ps(_mm_loadu_ps(e + i), _mm_mul_ps(va, vy)));
+    _mm_storeu_ps(y + i, _mm_add_ps(vy, _mm_mul_ps(va, vx)));
+  }
+  for (; i < n; ++i) {
+    xi = x[i];
+    yi = y[i];
+    e[i] += a * yi;
+    y[i] = yi + a * xi;
+  }
+}
+
+__attribute__((target("sse4.2")))
+static void scale_sse42(real a, real *x, long long n) {
+  long long i = 0;
+  __m128 va = _mm_set1_ps(a);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(x + i, _mm_mul_ps(va, _mm_loadu_ps(x + i)));
+  for (; i < n; ++i)
+    x[i] *= a;
+}
+
+/* AVX2 + FMA */
+__attribute__((target("avx2,fma")))
+static real dot_avx2(const real *x, const real *y, long long n) {
+  long long i = 0;
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  for (; i + 16 <= n; i += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8),
+                         _mm256_loadu_ps(y + i + 8), s1);
+  }
+  if (i + 8 <= n) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), s0);
+    i += 8;
+  }
+  s0 = _mm256_add_ps(s0, s1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0),
+                        _mm256_extractf128_ps(s0, 1));
+  s = _mm_hadd_ps(s, s);
+  s = _mm_hadd_ps(s, s);
+  real f = _mm_cvtss_f32(s);
+  for (; i < n; ++i)
+    f += x[i] * y[i];
+  return f;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(real a, const real *x, real *y, long long n) {
+  long long i = 0;
+  __m256 va = _mm256_set1_ps(a);
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i),
+                                            _mm256_loadu_ps(y + i)));
+  for (; i < n; ++i)
+    y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy2_avx2(real a, const real *x, real *y, real *e, long long n) {
+  long long i = 0;
+  real xi, yi;
+  __m256 va = _mm256_set1_ps(a), vx, vy;
+  for (; i + 8 <= n; i += 8) {
+    vx = _mm256_loadu_ps(x + i);
+    vy = _mm256_loadu_ps(y + i);
+    _mm256_storeu_ps(e + i, _mm256_fmadd_ps(va, vy, _mm256_loadu_ps(e + i)));
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, vx, vy));
+  }
+  for (; i < n; ++i) {
+    xi = x[i];
+    yi = y[i];
+    e[i] += a * yi;
+    y[i] = yi + a * xi;
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void scale_avx2(real a, real *x, long long n) {
+  long long i = 0;
+  __m256 va = _mm256_set1_ps(a);
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+  for (; i < n; ++i)
+    x[i] *= a;
+}
+
+/* AVX-512 (tails are handled with masked loads and stores) */
+# define TAIL_MASK(n) ((__mmask16) ((1U << (n)) - 1))
+
+__attribute__((target("avx512f")))
+static real dot_avx512(const real *x, const real *y, long long n) {
+  long long i = 0;
+  __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+  for (; i + 32 <= n; i += 32) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i + 16),
+                         _mm512_loadu_ps(y + i + 16), s1);
+  }
+  if (i + 16 <= n) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), s0);
+    i += 16;
+  }
+  if (i < n) {
+    __mmask16 m = TAIL_MASK(n - i);
+    s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + i),
+                         _mm512_maskz_loadu_ps(m, y + i), s1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
+
+__attribute__((target("avx512f")))
+static void axpy_avx512(real a, const real *x, real *y, long long n) {
+  long long i = 0;
+  __m512 va = _mm512_set1_ps(a);
+  for (; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i),
+                                            _mm512_loadu_ps(y + i)));
+  if (i < n) {
+    __mmask16 m = TAIL_MASK(n - i);
+    _mm512_mask_storeu_ps(y + i, m,
+                          _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i),
+                                          _mm512_maskz_loadu_ps(m, y + i)));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void axpy2_avx512(real a, const real *x, real *y, real *e, long long n) {
+  long long i = 0;
+  __m512 va = _mm512_set1_ps(a), vx, vy;
+  for (; i + 16 <= n; i += 16) {
+    vx = _mm512_loadu_ps(x + i);
+    vy = _mm512_loadu_ps(y + i);
+    _mm512_storeu_ps(e + i, _mm512_fmadd_ps(va, vy, _mm512_loadu_ps(e + i)));
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, vx, vy));
+  }
+  if (i < n) {
+    __mmask16 m = TAIL_MASK(n - i);
+    vx = _mm512_maskz_loadu_ps(m, x + i);
+    vy = _mm512_maskz_loadu_ps(m, y + i);
+    _mm512_mask_storeu_ps(e + i, m,
+                          _mm512_fmadd_ps(va, vy,
+                                          _mm512_maskz_loadu_ps(m, e + i)));
+    _mm512_mask_storeu_ps(y + i, m, _mm512_fmadd_ps(va, vx, vy));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void scale_avx512(real a, real *x, long long n) {
+  long long i = 0;
+  __m512 va = _mm512_set1_ps(a);
+  for (; i + 16 <= n; i += 16)
+    _mm512_storeu_ps(x + i, _mm512_mul_ps(va, _mm512_loadu_ps(x + i)));
+  if (i < n) {
+    __mmask16 m = TAIL_MASK(n - i);
+    _mm512_mask_storeu_ps(x + i, m,
+                          _mm512_mul_ps(va, _mm512_maskz_loadu_ps(m, x + i)));
+  }
+}
+#endif  /* ifdef W2V_X86 */
+
+///////////////
+// Variables //
+///////////////
+static const kernels_t SCALAR_KERNELS = {
+  "scalar", dot_scalar, axpy_scalar, axpy2_scalar, scale_scalar
+};
+
+kernels_t KERNELS = {
+  "scalar", dot_scalar, axpy_scalar, axpy2_scalar, scale_scalar
+};
+
+#ifdef W2V_X86
+static const kernels_t SSE42_KERNELS = {
+  "sse4.2", dot_sse42, axpy_sse42, axpy2_sse42, scale_sse42
+};
+
+static const kernels_t AVX2_KERNELS = {
+  "avx2", dot_avx2, axpy_avx2, axpy2_avx2, scale_avx2
+};
+
+static const kernels_t AVX512_KERNELS = {
+  "avx512", dot_avx512, axpy_avx512, axpy2_avx512, scale_avx512
+};
+#endif
+
+static kernels_t VARIANTS[4];
+static size_t N_VARIANTS = 0;
+
+/////////////
+// Methods //
+/////////////
+const kernels_t *get_kernel_variants(size_t *a_n) {
+  if (N_VARIANTS == 0) {
+    VARIANTS[N_VARIANTS++] = SCALAR_KERNELS;
+#ifdef W2V_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+      VARIANTS[N_VARIANTS++] = SSE42_KERNELS;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      VARIANTS[N_VARIANTS++] = AVX2_KERNELS;
+
+    if (__builtin_cpu_supports("avx512f"))
+      VARIANTS[N_VARIANTS++] = AVX512_KERNELS;
+#endif
+  }
+  *a_n = N_VARIANTS;
+  return VARIANTS;
+}
+
+int init_kernels(const char *a_isa) {
+  size_t i, n;
+  const kernels_t *variants = get_kernel_variants(&n);
+  if (a_isa == NULL || a_isa[0] == '\0' || strcmp(a_isa, "auto") == 0) {
+    KERNELS = variants[n - 1];
+    return 0;
+  }
+
+  for (i = 0; i < n; ++i) {
+    if (strcmp(a_isa, variants[i].m_isa) == 0) {
+      KERNELS = variants[i];
+      return 0;
+    }
+  }
+  return -1;
+}
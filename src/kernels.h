@@ -0,0 +1,159 @@
+/**
+ * @file kernels.h
+ * @brief Declaration of vector kernels used in the training hot loop.
+ */
+
+#ifndef __WORD2VEC_KERNELS_H__
+# define __WORD2VEC_KERNELS_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+
+#include <stddef.h>  /* size_t */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Set of vector kernels implemented for one instruction set.
+ */
+typedef struct {
+  /**
+   * @brief Name of the instruction set (e.g., `avx2')
+   */
+  const char *m_isa;
+  /**
+   * @brief Compute dot product of `x' and `y'.
+   */
+  real (*m_dot)(const real *x, const real *y, long long n);
+  /**
+   * @brief Compute `y += a * x'.
+   */
+  void (*m_axpy)(real a, const real *x, real *y, long long n);
+  /**
+   * @brief Compute `e += a * y' and `y += a * x' in one pass.
+   *
+   * This is the update which follows a dot product in the training
+   * loop: `e' accumulates the error of the hidden layer, `y' is the
+   * output row, and `x' is the input row.  `x' and `e' may alias, in
+   * which case the update of `y' uses the original values of `x'.
+   */
+  void (*m_axpy2)(real a, const real *x, real *y, real *e, long long n);
+  /**
+   * @brief Compute `x *= a'.
+   */
+  void (*m_scale)(real a, real *x, long long n);
+} kernels_t;
+
+///////////////
+// Variables //
+///////////////
+
+/** @brief Kernels selected for the current CPU (scalar until
+    init_kernels() is called). */
+extern kernels_t KERNELS;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Select kernels for the given instruction set.
+ *
+ * @param a_isa - name of the instruction set (`scalar', `sse4.2',
+ *   `avx2', or `avx512'); \c NULL or `auto' selects the fastest one
+ *   supported by the current CPU
+ *
+ * @return \c 0 on success, \c -1 if the instruction set is unknown
+ *   or not supported by the CPU
+ */
+int init_kernels(const char *a_isa);
+
+/**
+ * Return all kernel variants supported by the current CPU.
+ *
+ * @param a_n - number of returned variants
+ *
+ * @return \c const kernels_t* - array of supported variants (the
+ *   fastest one comes last)
+ */
+const kernels_t *get_kernel_variants(size_t *a_n);
+
+/**
+ * Compute dot product of two vectors.
+ *
+ * @param x - first vector
+ * @param y - second vector
+ * @param n - number of elements
+ *
+ * @return \c real - dot product
+ */
+static inline real vec_dot(const real *x, const real *y, long long n) {
+  return KERNELS.m_dot(x, y, n);
+}
+
+/**
+ * Add scaled vector `x' to vector `y'.
+ *
+ * @param a - scaling factor
+ * @param x - vector to add
+ * @param y - vector to update
+ * @param n - number of elements
+ *
+ * @return \c void
+ */
+static inline void vec_axpy(real a, const real *x, real *y, long long n) {
+  KERNELS.m_axpy(a, x, y, n);
+}
+
+/**
+ * Simultaneously update error vector `e' and output row `y'.
+ *
+ * @param a - scaled gradient
+ * @param x - input row (may alias `e')
+ * @param y - output row
+ * @param e - error accumulator
+ * @param n - number of elements
+ *
+ * @return \c void
+ */
+static inline void vec_axpy2(real a, const real *x, real *y, real *e,
+                             long long n) {
+  KERNELS.m_axpy2(a, x, y, e, n);
+}
+
+/**
+ * Scale vector in place.
+ *
+ * @param a - scaling factor
+ * @param x - vector to scale
+ * @param n - number of elements
+ *
+ * @return \c void
+ */
+static inline void vec_scale(real a, real *x, long long n) {
+  KERNELS.m_scale(a, x, n);
+}
+
+/**
+ * Prefetch vector which is going to be updated.
+ *
+ * @param x - vector to prefetch
+ * @param n - number of elements
+ *
+ * @return \c void
+ */
+static inline void vec_prefetch(const real *x, long long n) {
+#if defined(__GNUC__)
+  const char *p = (const char *) x, *end = (const char *) (x + n);
+  for (; p < end; p += 64)
+    __builtin_prefetch(p, 1, 3);
+#else
+  UNUSED(x);
+  UNUSED(n);
+#endif
+}
+#endif  /* ifndef __WORD2VEC_KERNELS_H__ */
@@ -0,0 +1,158 @@
+//////////////
+// Includes //
+//////////////
+#include "pages.h"
+
+#include <stdint.h>    /* uintptr_t */
+#include <stdio.h>     /* fprintf(), sscanf() */
+#include <string.h>    /* strcmp() */
+#include <sys/mman.h>  /* mmap(), madvise() */
+#include <unistd.h>    /* sysconf() */
+
+/////////////
+// Structs //
+/////////////
+
+/* bookkeeping stored right in front of each allocated region */
+typedef struct {
+  void *m_base;			/* start of the underlying allocation */
+  size_t m_map_size;		/* size of the mapping (huge pages only) */
+  page_backing_t m_backing;	/* kind of pages */
+} page_header_t;
+
+/////////////
+// Methods //
+/////////////
+static size_t round_up(size_t a_size, size_t a_align) {
+  return (a_size + a_align - 1) / a_align * a_align;
+}
+
+static void *finish_region(void *a_base, size_t a_offset, size_t a_map_size,
+                           page_backing_t a_backing) {
+  char *addr = (char *) a_base + a_offset;
+  page_header_t *header = (page_header_t *) (addr - sizeof(page_header_t));
+  header->m_base = a_base;
+  header->m_map_size = a_map_size;
+  header->m_backing = a_backing;
+  return addr;
+}
+
+void *alloc_pages(size_t a_size, const huge_pages_mode_t a_mode,
+                  page_backing_t *a_backing) {
+  void *base;
+  /* the first (huge) page only holds the header, so that the region
+     itself starts at a page boundary */
+  if (a_mode == HUGE_PAGES_EXPLICIT) {
+#ifdef MAP_HUGETLB
+    size_t map_size = round_up(a_size, HUGE_PAGE_SIZE) + HUGE_PAGE_SIZE;
+    base = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+      *a_backing = PAGES_HUGETLB;
+      return finish_region(base, HUGE_PAGE_SIZE, map_size, PAGES_HUGETLB);
+    }
+#endif
+    /* no reserved huge pages: fall back to transparent ones */
+  }
+  if (a_mode != HUGE_PAGES_NONE) {
+    size_t size = round_up(a_size, HUGE_PAGE_SIZE);
+    if (posix_memalign(&base, HUGE_PAGE_SIZE, size + HUGE_PAGE_SIZE) == 0) {
+      *a_backing = PAGES_REGULAR;
+#ifdef MADV_HUGEPAGE
+      if (madvise((char *) base + HUGE_PAGE_SIZE, size, MADV_HUGEPAGE) == 0)
+        *a_backing = PAGES_THP;
+#endif
+      return finish_region(base, HUGE_PAGE_SIZE, 0, *a_backing);
+    }
+  } else {
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (posix_memalign(&base, page, a_size + page) == 0) {
+      *a_backing = PAGES_REGULAR;
+      return finish_region(base, page, 0, PAGES_REGULAR);
+    }
+  }
+  fprintf(stderr, "Memory allocation failed\n");
+  exit(EXIT_FAILURE);
+}
+
+void free_pages(void *a_addr) {
+  if (a_addr == NULL)
+    return;
+
+  page_header_t *header = (page_header_t *) ((char *) a_addr
+                                             - sizeof(page_header_t));
+  if (header->m_backing == PAGES_HUGETLB)
+    munmap(header->m_base, header->m_map_size);
+  else
+    free(header->m_base);
+}
+
+page_backing_t page_backing_of(const void *a_addr) {
+  const page_header_t *header = (const page_header_t *) ((const char *) a_addr
+                                                         - sizeof(page_header_t));
+  return header->m_backing;
+}
+
+size_t huge_pages_in(const void *a_addr) {
+  FILE *fin = fopen("/proc/self/smaps", "r");
+  if (fin == NULL)
+    return 0;
+
+  char line[256];
+  unsigned long lo, hi, kb, addr = (uintptr_t) a_addr;
+  size_t ret = 0;
+  int in_region = 0;
+  /* each mapping starts with a `lo-hi perms ...' line followed by
+     `Field: value' lines */
+  while (fgets(line, sizeof(line), fin)) {
+    if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+      if (in_region)
+        break;
+
+      in_region = lo <= addr && addr < hi;
+    } else if (in_region) {
+      if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1
+          || sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1)
+        ret += kb << 10;
+    }
+  }
+  fclose(fin);
+  return ret;
+}
+
+const char *page_backing2str(const page_backing_t a_backing) {
+  switch (a_backing) {
+  case PAGES_REGULAR:
+    return "regular pages";
+  case PAGES_THP:
+    return "transparent huge pages";
+  case PAGES_HUGETLB:
+    return "explicit huge pages";
+  }
+  return "unknown";
+}
+
+const char *huge_pages_mode2str(const huge_pages_mode_t a_mode) {
+  switch (a_mode) {
+  case HUGE_PAGES_NONE:
+    return "none";
+  case HUGE_PAGES_THP:
+    return "thp";
+  case HUGE_PAGES_EXPLICIT:
+    return "explicit";
+  }
+  return "unknown";
+}
+
+int str2huge_pages_mode(const char *a_str, huge_pages_mode_t *a_mode) {
+  if (strcmp(a_str, "none") == 0)
+    *a_mode = HUGE_PAGES_NONE;
+  else if (strcmp(a_str, "thp") == 0)
+    *a_mode = HUGE_PAGES_THP;
+  else if (strcmp(a_str, "explicit") == 0)
+    *a_mode = HUGE_PAGES_EXPLICIT;
+  else
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file pages.h
+ * @brief Declaration of page-aligned allocation of large matrices,
+ * optionally backed by huge pages.
+ *
+ * Rows of the embedding matrices are accessed in random order, so
+ * with regular 4 KB pages nearly every row access misses the TLB.
+ * Backing the matrices with 2 MB pages reduces the number of TLB
+ * entries needed by a factor of 512.  Huge pages are either requested
+ * from the pool reserved by the administrator (`MAP_HUGETLB') or as
+ * transparent huge pages (`madvise(MADV_HUGEPAGE)'); if neither is
+ * available, regular pages are used.
+ */
+
+#ifndef __WORD2VEC_PAGES_H__
+# define __WORD2VEC_PAGES_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+
+#include <stddef.h>  /* size_t */
+
+////////////
+// Macros //
+////////////
+/** @brief Size of a huge page on x86-64 and most other platforms */
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @typedef page_backing_t
+ * @brief kind of pages which back an allocated region
+ */
+typedef enum {
+  PAGES_REGULAR = 0,		/**< regular pages */
+  PAGES_THP,			/**< transparent huge pages requested */
+  PAGES_HUGETLB			/**< explicit huge pages */
+} page_backing_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Allocate page-aligned memory region.
+ *
+ * @param a_size - size of the region in bytes
+ * @param a_mode - requested kind of pages
+ * @param a_backing - kind of pages actually obtained
+ *
+ * @return \c void* - start of the region (must be released with
+ *   free_pages())
+ */
+void *alloc_pages(size_t a_size, const huge_pages_mode_t a_mode,
+                  page_backing_t *a_backing);
+
+/**
+ * Release memory region allocated by alloc_pages().
+ *
+ * @param a_addr - start of the region (may be \c NULL)
+ *
+ * @return \c void
+ */
+void free_pages(void *a_addr);
+
+/**
+ * Determine kind of pages obtained for a region.
+ *
+ * @param a_addr - start of a region allocated by alloc_pages()
+ *
+ * @return \c page_backing_t - kind of pages
+ */
+page_backing_t page_backing_of(const void *a_addr);
+
+/**
+ * Determine how much of a region is currently backed by huge pages.
+ *
+ * The information is read from `/proc/self/smaps' and is therefore
+ * only meaningful after the region has been touched.
+ *
+ * @param a_addr - start of a region allocated by alloc_pages()
+ *
+ * @return \c size_t - number of bytes in huge pages, \c 0 if unknown
+ */
+size_t huge_pages_in(const void *a_addr);
+
+/**
+ * Convert kind of pages to a readable name.
+ *
+ * @param a_backing - kind of pages
+ *
+ * @return \c const char* - name of the backing
+ */
+const char *page_backing2str(const page_backing_t a_backing);
+
+/**
+ * Convert requested kind of pages to its command line name.
+ *
+ * @param a_mode - requested kind of pages
+ *
+ * @return \c const char* - name of the mode
+ */
+const char *huge_pages_mode2str(const huge_pages_mode_t a_mode);
+
+/**
+ * Parse command line name of the requested kind of pages.
+ *
+ * @param a_str - name of the mode (`none', `thp', or `explicit')
+ * @param a_mode - parsed mode
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2huge_pages_mode(const char *a_str, huge_pages_mode_t *a_mode);
+#endif  /* ifndef __WORD2VEC_PAGES_H__ */
@@ -0,0 +1,66 @@
+/**
+ * @file rng.h
+ * @brief Seekable version of the linear congruential generator used
+ * throughout word2vec.
+ *
+ * The generator `x' = x * 25214903917 + 11 (mod 2^64)' is an affine
+ * map, so `n' steps of it are again an affine map whose coefficients
+ * can be computed in O(log n) by repeated squaring.  This allows
+ * threads to jump directly to their part of a random sequence and
+ * still produce exactly the same numbers as a serial loop.
+ */
+
+#ifndef __WORD2VEC_RNG_H__
+# define __WORD2VEC_RNG_H__
+
+////////////
+// Macros //
+////////////
+#define LCG_MULT 25214903917ULL	/**< multiplier of the generator */
+#define LCG_INC 11ULL		/**< increment of the generator */
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute coefficients of `n' consecutive steps of the generator.
+ *
+ * @param a_n - number of steps
+ * @param a_mult - multiplier of the combined step
+ * @param a_inc - increment of the combined step
+ *
+ * @return \c void
+ */
+static inline void lcg_jump(unsigned long long a_n, unsigned long long *a_mult,
+                            unsigned long long *a_inc) {
+  unsigned long long mult = 1, inc = 0;
+  unsigned long long step_mult = LCG_MULT, step_inc = LCG_INC;
+  while (a_n) {
+    if (a_n & 1) {
+      mult *= step_mult;
+      inc = inc * step_mult + step_inc;
+    }
+    step_inc *= step_mult + 1;
+    step_mult *= step_mult;
+    a_n >>= 1;
+  }
+  *a_mult = mult;
+  *a_inc = inc;
+}
+
+/**
+ * Advance generator by the given number of steps.
+ *
+ * @param a_state - current state
+ * @param a_n - number of steps
+ *
+ * @return \c unsigned long long - state after `a_n' steps
+ */
+static inline unsigned long long lcg_skip(unsigned long long a_state,
+                                          unsigned long long a_n) {
+  unsigned long long mult, inc;
+  lcg_jump(a_n, &mult, &inc);
+  return a_state * mult + inc;
+}
+#endif  /* ifndef __WORD2VEC_RNG_H__ */
@@ -0,0 +1,162 @@
+//////////////
+// Includes //
+//////////////
+#include "sampler.h"
+
+#include <math.h>    /* fabs(), pow() */
+#include <stdio.h>   /* fprintf() */
+#include <string.h>  /* strcmp() */
+
+/////////////
+// Methods //
+/////////////
+
+/* Vose's construction of alias tables in O(V) */
+static void init_alias(sampler_t *a_sampler, const vocab_t *a_vocab,
+                       const double a_power) {
+  const long long n = a_vocab->m_vocab_size;
+  double *scaled = (double *) malloc(n * sizeof(double));
+  long long *small = (long long *) malloc(n * sizeof(long long));
+  long long *large = (long long *) malloc(n * sizeof(long long));
+  a_sampler->m_prob = (float *) malloc(n * sizeof(float));
+  a_sampler->m_alias = (int *) malloc(n * sizeof(int));
+  if (scaled == NULL || small == NULL || large == NULL
+      || a_sampler->m_prob == NULL || a_sampler->m_alias == NULL) {
+    fprintf(stderr, "Could not allocate memory for alias sampler.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  double total = 0;
+  long long i, s, l, n_small = 0, n_large = 0;
+  for (i = 0; i < n; ++i) {
+    scaled[i] = pow(a_vocab->m_vocab[i].cn, a_power);
+    total += scaled[i];
+  }
+  for (i = 0; i < n; ++i) {
+    scaled[i] *= n / total;
+    if (scaled[i] < 1.)
+      small[n_small++] = i;
+    else
+      large[n_large++] = i;
+  }
+  /* fill each under-full column with the excess of an over-full one */
+  while (n_small > 0 && n_large > 0) {
+    s = small[--n_small];
+    l = large[n_large - 1];
+    a_sampler->m_prob[s] = scaled[s];
+    a_sampler->m_alias[s] = l;
+    scaled[l] -= 1. - scaled[s];
+    if (scaled[l] < 1.) {
+      --n_large;
+      small[n_small++] = l;
+    }
+  }
+  /* remaining columns are full up to rounding errors */
+  while (n_large > 0) {
+    l = large[--n_large];
+    a_sampler->m_prob[l] = 1.;
+    a_sampler->m_alias[l] = l;
+  }
+  while (n_small > 0) {
+    s = small[--n_small];
+    a_sampler->m_prob[s] = 1.;
+    a_sampler->m_alias[s] = s;
+  }
+  free(scaled);
+  free(small);
+  free(large);
+}
+
+void init_sampler(sampler_t *a_sampler, const sampler_mode_t a_mode,
+                  vocab_t *a_vocab, const double a_power) {
+  a_sampler->m_mode = a_mode;
+  a_sampler->m_vocab_size = a_vocab->m_vocab_size;
+  a_sampler->m_table = NULL;
+  a_sampler->m_prob = NULL;
+  a_sampler->m_alias = NULL;
+  if (a_vocab->m_vocab_size == 0)
+    return;
+
+  if (a_mode == SAMPLER_ALIAS)
+    init_alias(a_sampler, a_vocab, a_power);
+  else
+    a_sampler->m_table = init_unigram_table(a_vocab, a_power);
+}
+
+double alias_deviation(const sampler_t *a_sampler, const vocab_t *a_vocab,
+                       const double a_power) {
+  const long long n = a_sampler->m_vocab_size;
+  if (a_sampler->m_mode != SAMPLER_ALIAS || n == 0)
+    return 0.;
+
+  double *p = (double *) calloc(n, sizeof(double));
+  if (p == NULL) {
+    fprintf(stderr, "Could not allocate memory for alias sampler.\n");
+    exit(EXIT_FAILURE);
+  }
+  double total = 0, deviation = 0, diff;
+  long long i;
+  /* column `i' yields its word with probability `m_prob[i]' and its
+     alias otherwise */
+  for (i = 0; i < n; ++i) {
+    p[i] += a_sampler->m_prob[i] / n;
+    p[a_sampler->m_alias[i]] += (1. - a_sampler->m_prob[i]) / n;
+    total += pow(a_vocab->m_vocab[i].cn, a_power);
+  }
+  for (i = 0; i < n; ++i) {
+    diff = fabs(p[i] - pow(a_vocab->m_vocab[i].cn, a_power) / total);
+    if (diff > deviation)
+      deviation = diff;
+  }
+  free(p);
+  return deviation;
+}
+
+void free_sampler(sampler_t *a_sampler) {
+  free(a_sampler->m_table);
+  free(a_sampler->m_prob);
+  free(a_sampler->m_alias);
+  a_sampler->m_table = NULL;
+  a_sampler->m_prob = NULL;
+  a_sampler->m_alias = NULL;
+  a_sampler->m_vocab_size = 0;
+}
+
+void init_negatives(negatives_t *a_negatives, const long long a_capacity) {
+  a_negatives->m_ids = (long long *) calloc(a_capacity > 0? a_capacity: 1,
+                                            sizeof(long long));
+  if (a_negatives->m_ids == NULL) {
+    fprintf(stderr, "Could not allocate memory for negative examples.\n");
+    exit(EXIT_FAILURE);
+  }
+  a_negatives->m_capacity = a_capacity;
+  a_negatives->m_size = a_negatives->m_pos = 0;
+  a_negatives->m_drawn = a_negatives->m_rejected = 0;
+}
+
+void free_negatives(negatives_t *a_negatives) {
+  free(a_negatives->m_ids);
+  a_negatives->m_ids = NULL;
+  a_negatives->m_capacity = a_negatives->m_size = a_negatives->m_pos = 0;
+}
+
+const char *sampler_mode2str(const sampler_mode_t a_mode) {
+  switch (a_mode) {
+  case SAMPLER_TABLE:
+    return "table";
+  case SAMPLER_ALIAS:
+    return "alias";
+  }
+  return "unknown";
+}
+
+int str2sampler_mode(const char *a_str, sampler_mode_t *a_mode) {
+  if (strcmp(a_str, "table") == 0)
+    *a_mode = SAMPLER_TABLE;
+  else if (strcmp(a_str, "alias") == 0)
+    *a_mode = SAMPLER_ALIAS;
+  else
+    return -1;
+
+  return 0;
+}
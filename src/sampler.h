@@ -0,0 +1,194 @@
+/**
+ * @file sampler.h
+ * @brief Declaration of samplers drawing negative examples.
+ */
+
+#ifndef __WORD2VEC_SAMPLER_H__
+# define __WORD2VEC_SAMPLER_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "vocab.h"
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Sampler of negative examples from the smoothed unigram
+ * distribution `cn^power'.
+ *
+ * In the #SAMPLER_TABLE mode, words are looked up in the original
+ * word2vec unigram table of `TABLE_SIZE' entries.  In the
+ * #SAMPLER_ALIAS mode, they are drawn in constant time from the alias
+ * tables of Walker and Vose, which only take two entries per
+ * vocabulary word.
+ */
+typedef struct {
+  sampler_mode_t m_mode;	/**< active sampling method */
+  long long m_vocab_size;	/**< number of words to sample from */
+  int *m_table;			/**< unigram table (table mode) */
+  float *m_prob;		/**< probabilities of keeping the drawn
+				   column (alias mode) */
+  int *m_alias;			/**< alternative words of each column
+				   (alias mode) */
+} sampler_t;
+
+/**
+ * @brief Per-thread buffer of pre-drawn negative examples.
+ *
+ * All negative examples of a training window are drawn in one go, so
+ * that the rows of the output layer which belong to them can be
+ * prefetched while the preceding examples are being trained.
+ */
+typedef struct {
+  long long *m_ids;		/**< pre-drawn negative examples */
+  long long m_capacity;		/**< maximum number of buffered examples */
+  long long m_size;		/**< number of buffered examples */
+  long long m_pos;		/**< next example to consume */
+  long long m_drawn;		/**< total number of drawn examples */
+  long long m_rejected;		/**< drawn examples which coincided with
+				   the predicted word */
+} negatives_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Build sampler for the given vocabulary.
+ *
+ * @param a_sampler - sampler to initialize
+ * @param a_mode - sampling method
+ * @param a_vocab - vocabulary with word counts
+ * @param a_power - exponent applied to word counts
+ *
+ * @return \c void
+ */
+void init_sampler(sampler_t *a_sampler, const sampler_mode_t a_mode,
+                  vocab_t *a_vocab, const double a_power);
+
+/**
+ * Release memory held by the sampler.
+ *
+ * @param a_sampler - sampler to free
+ *
+ * @return \c void
+ */
+void free_sampler(sampler_t *a_sampler);
+
+/**
+ * Compare the distribution of the alias tables with the smoothed
+ * unigram distribution they were built from.
+ *
+ * @param a_sampler - sampler in the #SAMPLER_ALIAS mode
+ * @param a_vocab - vocabulary with word counts
+ * @param a_power - exponent applied to word counts
+ *
+ * @return \c double - largest absolute difference between the
+ *   probabilities of a word (\c 0 in the #SAMPLER_TABLE mode)
+ */
+double alias_deviation(const sampler_t *a_sampler, const vocab_t *a_vocab,
+                       const double a_power);
+
+/**
+ * Convert sampling method to its command line name.
+ *
+ * @param a_mode - sampling method
+ *
+ * @return \c const char* - name of the method
+ */
+const char *sampler_mode2str(const sampler_mode_t a_mode);
+
+/**
+ * Parse command line name of a sampling method.
+ *
+ * @param a_str - name of the method (`table' or `alias')
+ * @param a_mode - parsed method
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2sampler_mode(const char *a_str, sampler_mode_t *a_mode);
+
+/**
+ * Draw a negative example.
+ *
+ * The end-of-sentence mark is replaced by a uniformly drawn word, as
+ * in the original word2vec.
+ *
+ * @param a_sampler - sampler to draw from
+ * @param a_random - current state of the thread's random generator
+ *
+ * @return \c long long - index of the drawn word
+ */
+static inline long long draw_negative(const sampler_t *a_sampler,
+                                      const unsigned long long a_random) {
+  long long target;
+  if (a_sampler->m_mode == SAMPLER_ALIAS) {
+    /* the integer part selects the column, the fractional part decides
+       between the column's word and its alias */
+    double u = (a_random >> 16) * (1. / (1ULL << 48)) * a_sampler->m_vocab_size;
+    long long column = (long long) u;
+    if (column >= a_sampler->m_vocab_size)   /* rounding of `u' */
+      column = a_sampler->m_vocab_size - 1;
+    target = (u - column < a_sampler->m_prob[column])?
+             column: a_sampler->m_alias[column];
+  } else {
+    target = a_sampler->m_table[(a_random >> 16) % TABLE_SIZE];
+  }
+  if (target == 0)
+    target = a_random % (a_sampler->m_vocab_size - 1) + 1;
+  return target;
+}
+
+/**
+ * Allocate buffer of pre-drawn negative examples.
+ *
+ * @param a_negatives - buffer to initialize
+ * @param a_capacity - maximum number of examples drawn at once
+ *
+ * @return \c void
+ */
+void init_negatives(negatives_t *a_negatives, const long long a_capacity);
+
+/**
+ * Release buffer of pre-drawn negative examples.
+ *
+ * @param a_negatives - buffer to free
+ *
+ * @return \c void
+ */
+void free_negatives(negatives_t *a_negatives);
+
+/**
+ * Refill buffer with negative examples for the given word.
+ *
+ * The random generator is advanced exactly as if the examples were
+ * drawn one by one right before their use.
+ *
+ * @param a_negatives - buffer to refill
+ * @param a_sampler - sampler to draw from
+ * @param a_n - number of examples to draw
+ * @param a_word - predicted word (drawing it counts as a rejection)
+ * @param a_random - state of the thread's random generator
+ *
+ * @return \c void
+ */
+static inline void draw_negatives(negatives_t *a_negatives,
+                                  const sampler_t *a_sampler,
+                                  const long long a_n, const long long a_word,
+                                  unsigned long long *a_random) {
+  long long i, target;
+  for (i = 0; i < a_n; ++i) {
+    *a_random = (*a_random) * (unsigned long long)25214903917 + 11;
+    target = draw_negative(a_sampler, *a_random);
+    a_negatives->m_rejected += (target == a_word);
+    a_negatives->m_ids[i] = target;
+  }
+  a_negatives->m_drawn += a_n;
+  a_negatives->m_size = a_n;
+  a_negatives->m_pos = 0;
+}
+#endif  /* ifndef __WORD2VEC_SAMPLER_H__ */
@@ -0,0 +1,265 @@
+//////////////
+// Includes //
+//////////////
+#include "rng.h"
+#include "schedule.h"
+#include "w2vio.h"
+
+#include <string.h>  /* strcmp() */
+#include <time.h>    /* clock_gettime() */
+
+/////////////
+// Methods //
+/////////////
+static inline uint64_t pack_range(uint64_t a_first, uint64_t a_end) {
+  return (a_first << 32) | a_end;
+}
+
+/* give each thread a contiguous share of the chunks */
+static void reset_ranges(scheduler_t *a_scheduler, chunk_range_t *a_ranges) {
+  const long long n_chunks = a_scheduler->m_n_chunks;
+  const int num_threads = a_scheduler->m_num_threads;
+  int t;
+  for (t = 0; t < num_threads; ++t)
+    __atomic_store_n(&a_ranges[t].m_range,
+                     pack_range(n_chunks * t / num_threads,
+                                n_chunks * (t + 1) / num_threads),
+                     __ATOMIC_RELEASE);
+}
+
+/* draw the order of chunks in epoch `a_epoch' (Fisher-Yates shuffle
+   with a generator depending only on the seed and the epoch) */
+static void shuffle_chunks(scheduler_t *a_scheduler, long long *a_order,
+                           const long long a_epoch) {
+  unsigned long long random = a_scheduler->m_seed
+                              ^ (0x9E3779B97F4A7C15ULL * (a_epoch + 1));
+  long long i, j, tmp;
+  for (i = 0; i < a_scheduler->m_n_chunks; ++i)
+    a_order[i] = i;
+  /* the first outputs of nearby seeds are strongly correlated */
+  random = lcg_skip(random, 16);
+  for (i = a_scheduler->m_n_chunks - 1; i > 0; --i) {
+    random = random * LCG_MULT + LCG_INC;
+    j = (random >> 16) % (i + 1);
+    tmp = a_order[i];
+    a_order[i] = a_order[j];
+    a_order[j] = tmp;
+  }
+}
+
+/* add a chunk ending at `a_end' unless it would be empty */
+static void add_chunk(scheduler_t *a_scheduler, long long *a_capacity,
+                      long long a_start, long long a_end, long long a_line) {
+  if (a_end <= a_start)
+    return;
+
+  /* pack_range() keeps chunk indices in 32 bits */
+  if (a_scheduler->m_n_chunks >= (1LL << 32) - 1) {
+    fprintf(stderr, "Too many training chunks, increase -chunk-size.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (a_scheduler->m_n_chunks == *a_capacity) {
+    *a_capacity = *a_capacity? 2 * *a_capacity: 1024;
+    a_scheduler->m_chunks = (chunk_t *) realloc(a_scheduler->m_chunks,
+                                                *a_capacity * sizeof(chunk_t));
+    if (a_scheduler->m_chunks == NULL) {
+      fprintf(stderr, "Could not allocate memory for training chunks.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  chunk_t *chunk = &a_scheduler->m_chunks[a_scheduler->m_n_chunks++];
+  chunk->m_start = a_start;
+  chunk->m_end = a_end;
+  chunk->m_line = a_line;
+}
+
+static void cut_text(scheduler_t *a_scheduler, const char *a_path,
+                     const long long a_file_size, const long long a_chunk_size) {
+  FILE *fin = fopen(a_path, "rb");
+  if (fin == NULL) {
+    fprintf(stderr, "ERROR: training data file not found!\n");
+    exit(EXIT_FAILURE);
+  }
+  long long capacity = 0, start = 0, end, offset;
+  for (offset = a_chunk_size; offset < a_file_size; offset += a_chunk_size) {
+    /* the chunk ends at the beginning of the line containing `offset' */
+    end = align_to_line(fin, offset + 1);
+    add_chunk(a_scheduler, &capacity, start, end, 0);
+    if (end > start)
+      start = end;
+  }
+  add_chunk(a_scheduler, &capacity, start, a_file_size, 0);
+  fclose(fin);
+}
+
+static void cut_corpus(scheduler_t *a_scheduler, const corpus_t *a_corpus,
+                       const long long a_chunk_ids) {
+  long long capacity = 0, line = 0, next;
+  while (line < a_corpus->m_n_lines) {
+    next = corpus_line_of(a_corpus, a_corpus->m_lines[line] + a_chunk_ids);
+    if (next <= line)
+      next = line + 1;
+    if (a_corpus->m_lines[next] >= a_corpus->m_n_ids)
+      next = a_corpus->m_n_lines;
+    add_chunk(a_scheduler, &capacity, a_corpus->m_lines[line],
+              a_corpus->m_lines[next], line);
+    line = next;
+  }
+}
+
+void init_scheduler(scheduler_t *a_scheduler, const opt_t *a_opts,
+                    const corpus_t *a_corpus, const long long a_file_size) {
+  const int num_threads = a_opts->m_num_threads;
+  long long chunk_size = a_opts->m_chunk_size > 0? a_opts->m_chunk_size: 1;
+  int i;
+  a_scheduler->m_chunks = NULL;
+  a_scheduler->m_n_chunks = 0;
+  a_scheduler->m_num_threads = num_threads;
+  a_scheduler->m_seed = a_opts->m_shuffle;
+  a_scheduler->m_order[0] = a_scheduler->m_order[1] = NULL;
+  if (a_corpus)
+    cut_corpus(a_scheduler, a_corpus, (chunk_size + 3) / 4);
+  else
+    cut_text(a_scheduler, a_opts->m_train_file, a_file_size, chunk_size);
+
+  a_scheduler->m_stats = (schedule_stats_t *) calloc(num_threads,
+                                                     sizeof(schedule_stats_t));
+  for (i = 0; i < 2; ++i) {
+    if (posix_memalign((void **) &a_scheduler->m_ranges[i], SCHEDULE_CACHE_LINE,
+                       num_threads * sizeof(chunk_range_t))) {
+      fprintf(stderr, "Could not allocate memory for the scheduler.\n");
+      exit(EXIT_FAILURE);
+    }
+    reset_ranges(a_scheduler, a_scheduler->m_ranges[i]);
+    if (a_scheduler->m_seed == 0)
+      continue;
+
+    a_scheduler->m_order[i] = (long long *) malloc(a_scheduler->m_n_chunks
+                                                   * sizeof(long long));
+    if (a_scheduler->m_order[i] == NULL) {
+      fprintf(stderr, "Could not allocate memory for the scheduler.\n");
+      exit(EXIT_FAILURE);
+    }
+    shuffle_chunks(a_scheduler, a_scheduler->m_order[i], i);
+  }
+  if (a_scheduler->m_stats == NULL) {
+    fprintf(stderr, "Could not allocate memory for the scheduler.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_barrier_init(&a_scheduler->m_barrier, NULL, num_threads);
+}
+
+void free_scheduler(scheduler_t *a_scheduler) {
+  pthread_barrier_destroy(&a_scheduler->m_barrier);
+  free(a_scheduler->m_chunks);
+  free(a_scheduler->m_ranges[0]);
+  free(a_scheduler->m_ranges[1]);
+  free(a_scheduler->m_order[0]);
+  free(a_scheduler->m_order[1]);
+  free(a_scheduler->m_stats);
+  a_scheduler->m_chunks = NULL;
+  a_scheduler->m_ranges[0] = a_scheduler->m_ranges[1] = NULL;
+  a_scheduler->m_order[0] = a_scheduler->m_order[1] = NULL;
+  a_scheduler->m_stats = NULL;
+  a_scheduler->m_n_chunks = 0;
+}
+
+/* take the first (`a_back' == 0) or last chunk of a range, return -1
+   if the range is empty */
+static long long pop_chunk(chunk_range_t *a_range, const int a_back) {
+  uint64_t range = __atomic_load_n(&a_range->m_range, __ATOMIC_ACQUIRE);
+  uint64_t first, end;
+  do {
+    first = range >> 32;
+    end = range & 0xFFFFFFFFULL;
+    if (first >= end)
+      return -1;
+  } while (!__atomic_compare_exchange_n(&a_range->m_range, &range,
+                                        a_back? pack_range(first, end - 1):
+                                        pack_range(first + 1, end),
+                                        1, __ATOMIC_ACQ_REL,
+                                        __ATOMIC_ACQUIRE));
+  return a_back? (long long) end - 1: (long long) first;
+}
+
+const chunk_t *next_chunk(scheduler_t *a_scheduler, const long a_thread_id,
+                          const long long a_epoch) {
+  chunk_range_t *ranges = a_scheduler->m_ranges[a_epoch & 1];
+  schedule_stats_t *stats = &a_scheduler->m_stats[a_thread_id];
+  long long idx = pop_chunk(&ranges[a_thread_id], 0);
+  long long remaining, max_remaining;
+  uint64_t range;
+  int t, victim;
+  /* steal from the thread with the most remaining chunks */
+  while (idx < 0) {
+    victim = -1;
+    max_remaining = 0;
+    for (t = 0; t < a_scheduler->m_num_threads; ++t) {
+      range = __atomic_load_n(&ranges[t].m_range, __ATOMIC_RELAXED);
+      remaining = (long long) (range & 0xFFFFFFFFULL) - (long long) (range >> 32);
+      if (remaining > max_remaining) {
+        max_remaining = remaining;
+        victim = t;
+      }
+    }
+    if (victim < 0)
+      return NULL;
+
+    idx = pop_chunk(&ranges[victim], 1);
+    if (idx >= 0)
+      ++stats->m_stolen;
+  }
+  ++stats->m_chunks;
+  if (a_scheduler->m_order[a_epoch & 1])
+    idx = a_scheduler->m_order[a_epoch & 1][idx];
+  return &a_scheduler->m_chunks[idx];
+}
+
+void finish_epoch(scheduler_t *a_scheduler, const long a_thread_id,
+                  const long long a_epoch) {
+  struct timespec start, finish;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int ret = pthread_barrier_wait(&a_scheduler->m_barrier);
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  a_scheduler->m_stats[a_thread_id].m_idle += (finish.tv_sec - start.tv_sec)
+      + (finish.tv_nsec - start.tv_nsec) / 1e9;
+  /* nobody uses the ranges of this epoch until the epoch after the
+     next one, which cannot start before the next barrier */
+  if (ret == PTHREAD_BARRIER_SERIAL_THREAD) {
+    reset_ranges(a_scheduler, a_scheduler->m_ranges[a_epoch & 1]);
+    if (a_scheduler->m_order[a_epoch & 1])
+      shuffle_chunks(a_scheduler, a_scheduler->m_order[a_epoch & 1],
+                     a_epoch + 2);
+  }
+}
+
+void output_schedule_stats(FILE *a_fstream, const scheduler_t *a_scheduler) {
+  int t;
+  fprintf(a_fstream, "Scheduler: steal  Chunks per epoch: %lld  Shuffle: %s\n",
+          a_scheduler->m_n_chunks, a_scheduler->m_seed? "yes": "no");
+  for (t = 0; t < a_scheduler->m_num_threads; ++t)
+    fprintf(a_fstream, "  thread %d: chunks %lld  stolen %lld  idle %.2f sec\n",
+            t, a_scheduler->m_stats[t].m_chunks,
+            a_scheduler->m_stats[t].m_stolen, a_scheduler->m_stats[t].m_idle);
+}
+
+const char *schedule_mode2str(const schedule_mode_t a_mode) {
+  switch (a_mode) {
+  case SCHEDULE_STATIC:
+    return "static";
+  case SCHEDULE_STEAL:
+    return "steal";
+  }
+  return "unknown";
+}
+
+int str2schedule_mode(const char *a_str, schedule_mode_t *a_mode) {
+  if (strcmp(a_str, "static") == 0)
+    *a_mode = SCHEDULE_STATIC;
+  else if (strcmp(a_str, "steal") == 0)
+    *a_mode = SCHEDULE_STEAL;
+  else
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file schedule.h
+ * @brief Declaration of the work-stealing scheduler of training chunks.
+ *
+ * With the #SCHEDULE_STEAL mode, the training data are cut into many
+ * line-aligned chunks.  At the start of each epoch, every thread owns
+ * a contiguous range of chunks, which it processes from the front.  A
+ * thread which has run out of chunks steals them one by one from the
+ * back of the range with the most remaining chunks, so that all
+ * threads finish an epoch at about the same time.  With `-shuffle',
+ * the ranges refer to a permutation of the chunks, which is drawn anew
+ * for each epoch from the given seed, so that the data are visited in
+ * a different (but reproducible) order while each chunk is still read
+ * sequentially.  Ranges are packed
+ * into single 64-bit words which are updated with compare-and-swap,
+ * so neither taking nor stealing a chunk requires a lock.  Threads
+ * wait for each other at the end of each epoch; this wait is reported
+ * as idle time.
+ */
+
+#ifndef __WORD2VEC_SCHEDULE_H__
+# define __WORD2VEC_SCHEDULE_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "corpus.h"
+
+#include <pthread.h>
+#include <stdint.h>  /* uint64_t */
+#include <stdio.h>   /* FILE * */
+
+////////////
+// Macros //
+////////////
+/** @brief Size of a cache line, used to keep ranges of different
+    threads apart */
+# define SCHEDULE_CACHE_LINE 64
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Line-aligned part of the training data.
+ */
+typedef struct {
+  long long m_start;		/**< first byte (or corpus id) */
+  long long m_end;		/**< end of the chunk */
+  long long m_line;		/**< corpus line of `m_start' */
+} chunk_t;
+
+/**
+ * @brief Chunks which remain to be processed by a thread.
+ */
+typedef struct {
+  uint64_t m_range;		/**< first chunk (upper half) and end
+				   (lower half) of the range */
+  char m_pad[SCHEDULE_CACHE_LINE - sizeof(uint64_t)];
+} chunk_range_t;
+
+/**
+ * @brief Scheduling statistics of a single thread.
+ */
+typedef struct {
+  long long m_chunks;		/**< processed chunks */
+  long long m_stolen;		/**< chunks stolen from other threads */
+  double m_idle;		/**< seconds spent waiting for other
+				   threads at the end of epochs */
+} schedule_stats_t;
+
+/**
+ * @brief Work-stealing scheduler.
+ */
+typedef struct {
+  chunk_t *m_chunks;		/**< all chunks of the training data */
+  long long m_n_chunks;		/**< number of chunks */
+  int m_num_threads;		/**< number of training threads */
+  /** ranges of each thread in even and odd epochs (the ranges of the
+      next epoch are prepared while the current one is running) */
+  chunk_range_t *m_ranges[2];
+  /** order of the chunks in even and odd epochs (NULL if the chunks
+      are not shuffled) */
+  long long *m_order[2];
+  unsigned long long m_seed;	/**< seed of the shuffle */
+  schedule_stats_t *m_stats;	/**< statistics of each thread */
+  pthread_barrier_t m_barrier;	/**< end of epoch */
+} scheduler_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Cut training data into chunks.
+ *
+ * @param a_scheduler - scheduler to initialize
+ * @param a_opts - command line options (training file, chunk size,
+ *   shuffle seed, and number of threads)
+ * @param a_corpus - compiled corpus (\c NULL if the text file is read)
+ * @param a_file_size - size of the training file
+ *
+ * @return \c void
+ */
+void init_scheduler(scheduler_t *a_scheduler, const opt_t *a_opts,
+                    const corpus_t *a_corpus, const long long a_file_size);
+
+/**
+ * Release memory held by the scheduler.
+ *
+ * @param a_scheduler - scheduler to free
+ *
+ * @return \c void
+ */
+void free_scheduler(scheduler_t *a_scheduler);
+
+/**
+ * Take the next chunk of the current epoch, stealing it from another
+ * thread if necessary.
+ *
+ * @param a_scheduler - scheduler
+ * @param a_thread_id - index of the calling thread
+ * @param a_epoch - number of the current epoch of the thread
+ *
+ * @return \c const chunk_t* - chunk to process, \c NULL if all chunks
+ *   of the epoch have been taken
+ */
+const chunk_t *next_chunk(scheduler_t *a_scheduler, const long a_thread_id,
+                          const long long a_epoch);
+
+/**
+ * Wait until all threads have finished the current epoch.
+ *
+ * @param a_scheduler - scheduler
+ * @param a_thread_id - index of the calling thread
+ * @param a_epoch - number of the finished epoch
+ *
+ * @return \c void
+ */
+void finish_epoch(scheduler_t *a_scheduler, const long a_thread_id,
+                  const long long a_epoch);
+
+/**
+ * Output scheduling statistics of all threads.
+ *
+ * @param a_fstream - output stream
+ * @param a_scheduler - scheduler
+ *
+ * @return \c void
+ */
+void output_schedule_stats(FILE *a_fstream, const scheduler_t *a_scheduler);
+
+/**
+ * Convert scheduling mode to its command line name.
+ *
+ * @param a_mode - scheduling mode
+ *
+ * @return \c const char* - name of the mode
+ */
+const char *schedule_mode2str(const schedule_mode_t a_mode);
+
+/**
+ * Parse command line name of a scheduling mode.
+ *
+ * @param a_str - name of the mode (`static' or `steal')
+ * @param a_mode - parsed mode
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2schedule_mode(const char *a_str, schedule_mode_t *a_mode);
+#endif  /* ifndef __WORD2VEC_SCHEDULE_H__ */
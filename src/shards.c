@@ -0,0 +1,259 @@
+//////////////
+// Includes //
+//////////////
+#include "shards.h"
+#include "w2vio.h"
+
+#include <dirent.h>    /* scandir() */
+#include <stdlib.h>    /* malloc(), exit() */
+#include <string.h>    /* strchr(), strrchr(), strcmp() */
+#include <sys/stat.h>  /* stat() */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Growing list of paths collected by expand_file_list().
+ */
+typedef struct {
+  char **m_paths;		/**< collected paths */
+  int m_n_paths;		/**< number of paths */
+  int m_capacity;		/**< allocated size of `m_paths' */
+  size_t m_size;		/**< total length of the paths */
+} path_list_t;
+
+/////////////
+// Methods //
+/////////////
+
+/* append a copy of the first `a_len' characters of `a_path' (or of a
+   path joined to the directory `a_dir') */
+static void add_path(path_list_t *a_list, const char *a_dir,
+                     const char *a_path, size_t a_len) {
+  if (a_list->m_n_paths == a_list->m_capacity) {
+    a_list->m_capacity = a_list->m_capacity? 2 * a_list->m_capacity: 16;
+    a_list->m_paths = (char **) realloc(a_list->m_paths, a_list->m_capacity
+                                        * sizeof(char *));
+  }
+  const size_t dir_len = a_dir? strlen(a_dir) + 1: 0;
+  char *path = (char *) malloc(dir_len + a_len + 1);
+  if (a_list->m_paths == NULL || path == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  if (a_dir) {
+    memcpy(path, a_dir, dir_len - 1);
+    path[dir_len - 1] = '/';
+  }
+  memcpy(path + dir_len, a_path, a_len);
+  path[dir_len + a_len] = '\0';
+  a_list->m_paths[a_list->m_n_paths++] = path;
+  a_list->m_size += dir_len + a_len + 1;
+}
+
+static int skip_hidden(const struct dirent *a_entry) {
+  return a_entry->d_name[0] != '.';
+}
+
+/* add a file, or the regular files of a directory in name order */
+static void add_file_or_dir(path_list_t *a_list, const char *a_dir,
+                            const char *a_path, size_t a_len) {
+  const int n_paths = a_list->m_n_paths;
+  add_path(a_list, a_dir, a_path, a_len);
+  char *path = a_list->m_paths[n_paths];
+  struct stat st;
+  if (stat(path, &st) || !S_ISDIR(st.st_mode))
+    return;
+
+  --a_list->m_n_paths;
+  a_list->m_size -= strlen(path) + 1;
+  struct dirent **entries;
+  int i, n_entries = scandir(path, &entries, skip_hidden, alphasort);
+  if (n_entries < 0) {
+    fprintf(stderr, "ERROR: could not read directory '%s'\n", path);
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < n_entries; ++i) {
+    add_path(a_list, path, entries[i]->d_name, strlen(entries[i]->d_name));
+    if (stat(a_list->m_paths[a_list->m_n_paths - 1], &st)
+        || !S_ISREG(st.st_mode)) {
+      --a_list->m_n_paths;
+      a_list->m_size -= strlen(a_list->m_paths[a_list->m_n_paths]) + 1;
+      free(a_list->m_paths[a_list->m_n_paths]);
+    }
+    free(entries[i]);
+  }
+  free(entries);
+  free(path);
+}
+
+/* add the files listed in a manifest */
+static void add_manifest(path_list_t *a_list, const char *a_path) {
+  FILE *fin = fopen(a_path, "r");
+  if (fin == NULL) {
+    fprintf(stderr, "ERROR: manifest '%s' not found!\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  /* relative paths are resolved against the directory of the manifest */
+  char *dir = NULL;
+  const char *slash = strrchr(a_path, '/');
+  if (slash) {
+    dir = strndup(a_path, slash == a_path? 1: (size_t) (slash - a_path));
+    if (dir == NULL) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t read;
+  while ((read = getline(&line, &len, fin)) != -1) {
+    while (read > 0 && (line[read - 1] == '\n' || line[read - 1] == '\r'))
+      --read;
+    /* skip empty lines and comments */
+    if (read == 0 || line[0] == '#')
+      continue;
+
+    add_file_or_dir(a_list, line[0] == '/'? NULL: dir, line, read);
+  }
+  free(line);
+  free(dir);
+  fclose(fin);
+}
+
+int expand_file_list(const char *a_list, char ***a_paths) {
+  path_list_t list = {NULL, 0, 0, 0};
+  const char *start = a_list, *end;
+  size_t len;
+  do {
+    end = strchr(start, ',');
+    len = end? (size_t) (end - start): strlen(start);
+    if (len > 1 && start[0] == '@') {
+      char *manifest = strndup(start + 1, len - 1);
+      if (manifest == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+      }
+      add_manifest(&list, manifest);
+      free(manifest);
+    } else if (len > 0) {
+      add_file_or_dir(&list, NULL, start, len);
+    }
+    start = end + 1;
+  } while (end);
+  if (list.m_n_paths == 0) {
+    fprintf(stderr, "ERROR: no training files found in '%s'\n", a_list);
+    exit(EXIT_FAILURE);
+  }
+
+  /* the array and the strings share a single allocation */
+  char **paths = (char **) malloc((list.m_n_paths + 1) * sizeof(char *)
+                                  + list.m_size);
+  if (paths == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  char *buf = (char *) (paths + list.m_n_paths + 1);
+  int i;
+  for (i = 0; i < list.m_n_paths; ++i) {
+    len = strlen(list.m_paths[i]) + 1;
+    memcpy(buf, list.m_paths[i], len);
+    paths[i] = buf;
+    buf += len;
+    free(list.m_paths[i]);
+  }
+  paths[list.m_n_paths] = NULL;
+  free(list.m_paths);
+  *a_paths = paths;
+  return list.m_n_paths;
+}
+
+int is_sharded_input(const char *a_train_file) {
+  char **paths;
+  const int n_paths = expand_file_list(a_train_file, &paths);
+  /* a directory or a manifest is sharded even if it names a single
+     plain file */
+  int ret = n_paths > 1 || strcmp(paths[0], a_train_file)
+            || file_codec(paths[0]) != CODEC_NONE;
+  free(paths);
+  return ret;
+}
+
+void open_shards(shards_t *a_shards, const char *a_train_file) {
+  a_shards->m_n_shards = expand_file_list(a_train_file, &a_shards->m_paths);
+  a_shards->m_starts = (long long *) malloc((a_shards->m_n_shards + 1)
+                                            * sizeof(long long));
+  a_shards->m_codecs = (codec_t *) malloc(a_shards->m_n_shards
+                                          * sizeof(codec_t));
+  if (a_shards->m_starts == NULL || a_shards->m_codecs == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  struct stat st;
+  int i;
+  a_shards->m_starts[0] = 0;
+  for (i = 0; i < a_shards->m_n_shards; ++i) {
+    if (stat(a_shards->m_paths[i], &st)) {
+      fprintf(stderr, "ERROR: training data file '%s' not found!\n",
+              a_shards->m_paths[i]);
+      exit(EXIT_FAILURE);
+    }
+    a_shards->m_starts[i + 1] = a_shards->m_starts[i] + st.st_size;
+    a_shards->m_codecs[i] = file_codec(a_shards->m_paths[i]);
+  }
+}
+
+void free_shards(shards_t *a_shards) {
+  free(a_shards->m_paths);
+  free(a_shards->m_starts);
+  free(a_shards->m_codecs);
+  a_shards->m_paths = NULL;
+  a_shards->m_starts = NULL;
+  a_shards->m_codecs = NULL;
+  a_shards->m_n_shards = 0;
+}
+
+int shard_of(const shards_t *a_shards, long long a_offset) {
+  /* last shard starting at or before the offset */
+  int lo = 0, hi = a_shards->m_n_shards - 1, mid;
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (a_shards->m_starts[mid] <= a_offset)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+long long align_to_shard_line(const shards_t *a_shards, long long a_offset) {
+  if (a_offset <= 0)
+    return 0;
+
+  const int shard = shard_of(a_shards, a_offset - 1);
+  const long long start = a_shards->m_starts[shard];
+  const long long end = a_shards->m_starts[shard + 1];
+  if (a_shards->m_codecs[shard] != CODEC_NONE)
+    return 2 * (a_offset - 1 - start) < end - start? start: end;
+
+  FILE *fin = fopen(a_shards->m_paths[shard], "rb");
+  if (fin == NULL) {
+    fprintf(stderr, "ERROR: training data file '%s' not found!\n",
+            a_shards->m_paths[shard]);
+    exit(EXIT_FAILURE);
+  }
+  long long offset = start + align_to_line(fin, a_offset - start);
+  fclose(fin);
+  return offset;
+}
+
+void output_shards(FILE *a_fstream, const shards_t *a_shards) {
+  int i, n_compressed = 0;
+  for (i = 0; i < a_shards->m_n_shards; ++i)
+    n_compressed += a_shards->m_codecs[i] != CODEC_NONE;
+  fprintf(a_fstream, "Shards: %d (%d compressed)  Size: %.1f MB\n",
+          a_shards->m_n_shards, n_compressed,
+          shards_size(a_shards) / 1048576.);
+}
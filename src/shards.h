@@ -0,0 +1,144 @@
+/**
+ * @file shards.h
+ * @brief Declaration of training data split into several files.
+ *
+ * The argument of `-train' is a comma-separated list whose elements
+ * are files, directories (all regular files in them whose names do
+ * not start with a dot, in the order of their names), or manifests
+ * (`@file' with one path per line, relative paths being resolved
+ * against the directory of the manifest).  The resulting shards are
+ * treated as one concatenated file: a position in the training data
+ * is an offset into this concatenation, where each shard occupies as
+ * many bytes as it has on disk.  Plain shards can be entered at any
+ * line start, whereas compressed shards can only be read from their
+ * beginning, so that positions which fall into them are moved to a
+ * shard boundary.
+ */
+
+#ifndef __WORD2VEC_SHARDS_H__
+# define __WORD2VEC_SHARDS_H__
+
+//////////////
+// Includes //
+//////////////
+#include "codec.h"
+
+#include <stdio.h>  /* FILE * */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Files making up the training data.
+ */
+typedef struct {
+  char **m_paths;		/**< paths of the shards */
+  int m_n_shards;		/**< number of shards */
+  long long *m_starts;		/**< offset of each shard in the
+				   concatenation (followed by the total
+				   size) */
+  codec_t *m_codecs;		/**< compression format of each shard */
+} shards_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Expand the argument of `-train' into a list of paths.
+ *
+ * @param a_list - comma-separated list of files, directories, and
+ *   manifests
+ * @param a_paths - NULL-terminated array of the paths (release with
+ *   free())
+ *
+ * @return \c int - number of paths (exits if there is none)
+ */
+int expand_file_list(const char *a_list, char ***a_paths);
+
+/**
+ * Check whether training data consist of several or of compressed
+ * files, or are given as a directory or a manifest.
+ *
+ * @param a_train_file - argument of `-train'
+ *
+ * @return \c int - non-zero unless the argument names a single plain
+ *   file
+ */
+int is_sharded_input(const char *a_train_file);
+
+/**
+ * Look up the sizes and compression formats of the shards.
+ *
+ * @param a_shards - shards to initialize
+ * @param a_train_file - argument of `-train'
+ *
+ * @return \c void (exits if a shard does not exist)
+ */
+void open_shards(shards_t *a_shards, const char *a_train_file);
+
+/**
+ * Release the list of shards.
+ *
+ * @param a_shards - shards to release
+ *
+ * @return \c void
+ */
+void free_shards(shards_t *a_shards);
+
+/**
+ * Total size of the shards.
+ *
+ * @param a_shards - shards
+ *
+ * @return \c long long - size of the concatenation
+ */
+static inline long long shards_size(const shards_t *a_shards) {
+  return a_shards->m_starts[a_shards->m_n_shards];
+}
+
+/**
+ * Check whether shards differ from a single plain file.
+ *
+ * @param a_shards - shards
+ *
+ * @return \c int - non-zero if there are several or compressed shards
+ */
+static inline int is_sharded(const shards_t *a_shards) {
+  return a_shards->m_n_shards > 1 || a_shards->m_codecs[0] != CODEC_NONE;
+}
+
+/**
+ * Find the shard which contains a position (empty shards are skipped).
+ *
+ * @param a_shards - shards
+ * @param a_offset - offset in the concatenation
+ *
+ * @return \c int - index of the shard (the last one for the end of
+ *   the data)
+ */
+int shard_of(const shards_t *a_shards, long long a_offset);
+
+/**
+ * Counterpart of align_to_line() for the concatenation of shards:
+ * find the start of the line which contains byte `a_offset' - 1, or
+ * the nearest boundary of a compressed shard containing it.
+ *
+ * @param a_shards - shards
+ * @param a_offset - offset past the byte in question
+ *
+ * @return \c long long - offset at which reading can start
+ */
+long long align_to_shard_line(const shards_t *a_shards, long long a_offset);
+
+/**
+ * Output the number, size, and compression of the shards.
+ *
+ * @param a_fstream - output stream
+ * @param a_shards - shards
+ *
+ * @return \c void
+ */
+void output_shards(FILE *a_fstream, const shards_t *a_shards);
+#endif  /* ifndef __WORD2VEC_SHARDS_H__ */
@@ -0,0 +1,88 @@
+//////////////
+// Includes //
+//////////////
+#include "sigmoid.h"
+
+#include <math.h>    /* exp() */
+#include <stdio.h>   /* fprintf() */
+#include <string.h>  /* strcmp() */
+
+/////////////
+// Methods //
+/////////////
+void init_sigmoid(sigmoid_t *a_sigmoid, const sigmoid_mode_t a_mode) {
+  a_sigmoid->m_mode = a_mode;
+  a_sigmoid->m_table = (real *) malloc((EXP_TABLE_SIZE + 1) * sizeof(real));
+  if (a_sigmoid->m_table == NULL) {
+    fprintf(stderr, "Could not allocate memory for sigmoid table.\n");
+    exit(EXIT_FAILURE);
+  }
+  int i;
+  for (i = 0; i <= EXP_TABLE_SIZE; ++i) {
+    a_sigmoid->m_table[i] = exp((i / (real)EXP_TABLE_SIZE * 2 - 1) * MAX_EXP); // Precompute the exp() table
+    a_sigmoid->m_table[i] = a_sigmoid->m_table[i] / (a_sigmoid->m_table[i] + 1); // Precompute f(x) = x / (x + 1)
+  }
+}
+
+void free_sigmoid(sigmoid_t *a_sigmoid) {
+  free(a_sigmoid->m_table);
+  a_sigmoid->m_table = NULL;
+}
+
+const char *sigmoid_mode2str(const sigmoid_mode_t a_mode) {
+  switch (a_mode) {
+  case SIGMOID_TABLE:
+    return "table";
+  case SIGMOID_INTERP:
+    return "interp";
+  case SIGMOID_POLY:
+    return "poly";
+  }
+  return "unknown";
+}
+
+int str2sigmoid_mode(const char *a_str, sigmoid_mode_t *a_mode) {
+  if (strcmp(a_str, "table") == 0)
+    *a_mode = SIGMOID_TABLE;
+  else if (strcmp(a_str, "interp") == 0)
+    *a_mode = SIGMOID_INTERP;
+  else if (strcmp(a_str, "poly") == 0)
+    *a_mode = SIGMOID_POLY;
+  else
+    return -1;
+
+  return 0;
+}
+
+void sigmoid_batch(const sigmoid_t *a_sigmoid, const real *a_scores,
+                   real *a_out, long long a_n) {
+  const real *table = a_sigmoid->m_table;
+  long long i;
+  real f, s;
+  /* one loop per method, so that each of them can be vectorized; the
+     score is clamped before the lookup and the result saturated after
+     it */
+  switch (a_sigmoid->m_mode) {
+  case SIGMOID_INTERP:
+    for (i = 0; i < a_n; ++i) {
+      f = a_scores[i];
+      s = sigmoid_interp(table, f < -MAX_EXP? -MAX_EXP: (f > MAX_EXP? MAX_EXP: f));
+      a_out[i] = f > MAX_EXP? 1: (f < -MAX_EXP? 0: s);
+    }
+    break;
+  case SIGMOID_POLY:
+    for (i = 0; i < a_n; ++i) {
+      f = a_scores[i];
+      s = sigmoid_poly(f < -MAX_EXP? -MAX_EXP: (f > MAX_EXP? MAX_EXP: f));
+      a_out[i] = f > MAX_EXP? 1: (f < -MAX_EXP? 0: s);
+    }
+    break;
+  default:
+    for (i = 0; i < a_n; ++i) {
+      f = a_scores[i];
+      s = sigmoid_table(table, f < -MAX_EXP? -MAX_EXP: (f > MAX_EXP? MAX_EXP: f));
+      a_out[i] = f > MAX_EXP? 1: (f < -MAX_EXP? 0: s);
+    }
+    break;
+  }
+}
@@ -0,0 +1,169 @@
+/**
+ * @file sigmoid.h
+ * @brief Declaration of approximations of the logistic sigmoid.
+ *
+ * Scores are only evaluated in the range (-MAX_EXP, MAX_EXP), outside
+ * of which the training code treats the sigmoid as saturated.  Three
+ * approximations are available:
+ *
+ *  - #SIGMOID_TABLE looks scores up in the table of the original
+ *    word2vec (including its rounding of the table scale);
+ *  - #SIGMOID_INTERP linearly interpolates between the entries of the
+ *    same table;
+ *  - #SIGMOID_POLY computes a rational approximation of `tanh()' and
+ *    does not touch memory at all.
+ */
+
+#ifndef __WORD2VEC_SIGMOID_H__
+# define __WORD2VEC_SIGMOID_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+
+////////////
+// Macros //
+////////////
+#define EXP_TABLE_SIZE 1000	/**< size of the exponents table */
+#define MAX_EXP 6		/**< maximum power for an exponent */
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Approximation of the logistic sigmoid.
+ */
+typedef struct {
+  sigmoid_mode_t m_mode;	/**< active approximation */
+  real *m_table;		/**< values of the sigmoid at
+				   `EXP_TABLE_SIZE + 1' equidistant
+				   points of [-MAX_EXP, MAX_EXP] */
+} sigmoid_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Initialize sigmoid approximation.
+ *
+ * @param a_sigmoid - approximation to initialize
+ * @param a_mode - approximation method
+ *
+ * @return \c void
+ */
+void init_sigmoid(sigmoid_t *a_sigmoid, const sigmoid_mode_t a_mode);
+
+/**
+ * Release memory held by the sigmoid approximation.
+ *
+ * @param a_sigmoid - approximation to free
+ *
+ * @return \c void
+ */
+void free_sigmoid(sigmoid_t *a_sigmoid);
+
+/**
+ * Convert approximation method to its command line name.
+ *
+ * @param a_mode - approximation method
+ *
+ * @return \c const char* - name of the method
+ */
+const char *sigmoid_mode2str(const sigmoid_mode_t a_mode);
+
+/**
+ * Parse command line name of an approximation method.
+ *
+ * @param a_str - name of the method (`table', `interp', or `poly')
+ * @param a_mode - parsed method
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2sigmoid_mode(const char *a_str, sigmoid_mode_t *a_mode);
+
+/**
+ * Compute saturated sigmoid of a batch of scores.
+ *
+ * Scores above `MAX_EXP' are mapped to 1, scores below `-MAX_EXP' to
+ * 0.  The loop of each method is free of branches; the one of
+ * #SIGMOID_POLY does not need gathers from the table and is
+ * vectorized for any SIMD instruction set.
+ *
+ * @param a_sigmoid - approximation to use
+ * @param a_scores - input scores
+ * @param a_out - output values (may alias `a_scores')
+ * @param a_n - number of scores
+ *
+ * @return \c void
+ */
+void sigmoid_batch(const sigmoid_t *a_sigmoid, const real *a_scores,
+                   real *a_out, long long a_n);
+
+/**
+ * Look up sigmoid in the table of the original word2vec.
+ *
+ * @param a_table - sigmoid table
+ * @param a_f - score in the range [-MAX_EXP, MAX_EXP)
+ *
+ * @return \c real - sigmoid of the nearest lower table point
+ */
+static inline real sigmoid_table(const real *a_table, real a_f) {
+  return a_table[(int)((a_f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
+}
+
+/**
+ * Interpolate sigmoid linearly between table entries.
+ *
+ * @param a_table - sigmoid table
+ * @param a_f - score in the range [-MAX_EXP, MAX_EXP]
+ *
+ * @return \c real - interpolated sigmoid
+ */
+static inline real sigmoid_interp(const real *a_table, real a_f) {
+  real pos = (a_f + MAX_EXP) * ((real) EXP_TABLE_SIZE / (2 * MAX_EXP));
+  int i = (int) pos;
+  i = i < EXP_TABLE_SIZE - 1? i: EXP_TABLE_SIZE - 1;
+  pos -= i;
+  return a_table[i] + pos * (a_table[i + 1] - a_table[i]);
+}
+
+/**
+ * Compute sigmoid as `(1 + tanh(f / 2)) / 2' with Lambert's
+ * continued fraction of `tanh()' (absolute error below 1e-6 in the
+ * range [-MAX_EXP, MAX_EXP]).
+ *
+ * @param a_f - score in the range [-MAX_EXP, MAX_EXP]
+ *
+ * @return \c real - approximated sigmoid
+ */
+static inline real sigmoid_poly(real a_f) {
+  real x = 0.5f * a_f, x2 = x * x;
+  real t = x * (135135.f + x2 * (17325.f + x2 * (378.f + x2)))
+           / (135135.f + x2 * (62370.f + x2 * (3150.f + x2 * 28.f)));
+  t = t > 1.f? 1.f: t;
+  t = t < -1.f? -1.f: t;
+  return 0.5f + 0.5f * t;
+}
+
+/**
+ * Compute sigmoid of a single score.
+ *
+ * @param a_sigmoid - approximation to use
+ * @param a_f - score in the range [-MAX_EXP, MAX_EXP)
+ *
+ * @return \c real - approximated sigmoid
+ */
+static inline real sigmoid_eval(const sigmoid_t *a_sigmoid, real a_f) {
+  switch (a_sigmoid->m_mode) {
+  case SIGMOID_INTERP:
+    return sigmoid_interp(a_sigmoid->m_table, a_f);
+  case SIGMOID_POLY:
+    return sigmoid_poly(a_f);
+  default:
+    return sigmoid_table(a_sigmoid->m_table, a_f);
+  }
+}
+#endif  /* ifndef __WORD2VEC_SIGMOID_H__ */
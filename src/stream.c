@@ -0,0 +1,276 @@
+//////////////
+// Includes //
+//////////////
+#include "stream.h"
+
+#include <string.h>    /* strcmp() */
+#include <sys/stat.h>  /* stat() */
+#include <time.h>      /* clock_gettime() */
+
+/////////////
+// Methods //
+/////////////
+static double seconds_since(const struct timespec *a_start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - a_start->tv_sec)
+      + (now.tv_nsec - a_start->tv_nsec) / 1e9;
+}
+
+int is_stream_file(const char *a_path) {
+  if (strcmp(a_path, "-") == 0)
+    return 1;
+
+  struct stat st;
+  if (stat(a_path, &st))
+    return 0;
+
+  return S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISCHR(st.st_mode);
+}
+
+int has_stream_file(const char *a_train_file) {
+  char **paths;
+  int i, ret = 0;
+  const int n_paths = expand_file_list(a_train_file, &paths);
+  for (i = 0; i < n_paths && !ret; ++i)
+    ret = is_stream_file(paths[i]);
+  free(paths);
+  return ret;
+}
+
+int is_streamed_input(const opt_t *a_opts) {
+  if (has_stream_file(a_opts->m_train_file))
+    return 1;
+
+  shards_t shards;
+  int i, n_compressed = 0;
+  open_shards(&shards, a_opts->m_train_file);
+  for (i = 0; i < shards.m_n_shards; ++i)
+    n_compressed += shards.m_codecs[i] != CODEC_NONE;
+  free_shards(&shards);
+  /* a compressed shard is never split among threads */
+  return n_compressed > 0 && n_compressed < a_opts->m_num_threads;
+}
+
+/* read lines into `a_batch' until it holds STREAM_BATCH_IDS ids (in
+   the same way as compiled corpora are built), return non-zero at the
+   end of the shard */
+static int fill_batch(stream_t *a_stream, reader_t *a_reader,
+                      stream_batch_t *a_batch) {
+  const int consume_tab = a_stream->m_consume_tab;
+  const size_t n_tasks = a_stream->m_n_tasks;
+  corpus_lines_t *layout = &a_batch->m_layout;
+  size_t n_ids = 0;
+  int word, eof = 0;
+
+  reset_corpus_lines(layout);
+  while (1) {
+    word = read_corpus_id(a_reader, a_stream->m_vocab, layout, n_ids,
+                          consume_tab, n_tasks);
+    if (word < 0) {
+      eof = 1;
+      break;
+    }
+    a_batch->m_ids = grow_corpus_array(a_batch->m_ids,
+                                       &a_batch->m_ids_capacity, n_ids + 1,
+                                       sizeof(int32_t));
+    a_batch->m_ids[n_ids++] = word;
+    if (word == 0 && n_ids >= STREAM_BATCH_IDS)
+      break;
+  }
+
+  corpus_t *corpus = &a_batch->m_corpus;
+  corpus->m_map = NULL;
+  corpus->m_map_size = 0;
+  corpus->m_ids = a_batch->m_ids;
+  corpus->m_lines = layout->m_lines;
+  corpus->m_tags = layout->m_tags;
+  corpus->m_n_ids = n_ids;
+  corpus->m_n_lines = layout->m_n_lines;
+  corpus->m_n_tasks = consume_tab? 0: n_tasks;
+  return eof;
+}
+
+/* read shards until all passes over them have been taken by the
+   readers */
+static void *read_stream_thread(void *a_stream) {
+  stream_t *stream = (stream_t *) a_stream;
+  struct timespec start, wait_start;
+  reader_t reader;
+  const char *path;
+  long long n_ids = 0, n_bytes = 0;
+  double waited = 0.;
+  int idx, shard, eof;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while ((shard = __atomic_fetch_add(&stream->m_next_path, 1,
+                                     __ATOMIC_RELAXED))
+         < stream->m_n_paths * stream->m_passes) {
+    path = stream->m_paths[shard % stream->m_n_paths];
+    if (strcmp(path, "-") == 0)
+      path = "/dev/stdin";
+    if (open_reader(&reader, path, 0)) {
+      fprintf(stderr, "ERROR: training data file '%s' not found!\n", path);
+      exit(EXIT_FAILURE);
+    }
+    eof = 0;
+    while (!eof) {
+      /* backpressure: wait until the trainers give a batch back */
+      pthread_mutex_lock(&stream->m_mutex);
+      if (stream->m_n_free == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &wait_start);
+        while (stream->m_n_free == 0)
+          pthread_cond_wait(&stream->m_has_free, &stream->m_mutex);
+        waited += seconds_since(&wait_start);
+      }
+      idx = stream->m_free[--stream->m_n_free];
+      pthread_mutex_unlock(&stream->m_mutex);
+
+      eof = fill_batch(stream, &reader, &stream->m_batches[idx]);
+      n_ids += stream->m_batches[idx].m_corpus.m_n_ids;
+
+      pthread_mutex_lock(&stream->m_mutex);
+      if (stream->m_batches[idx].m_corpus.m_n_ids > 0) {
+        stream->m_full[(stream->m_head + stream->m_n_full)
+                       % stream->m_n_batches] = idx;
+        ++stream->m_n_full;
+        pthread_cond_signal(&stream->m_has_full);
+      } else {
+        stream->m_free[stream->m_n_free++] = idx;
+        pthread_cond_signal(&stream->m_has_free);
+      }
+      pthread_mutex_unlock(&stream->m_mutex);
+    }
+    n_bytes += tell_reader(&reader);
+    close_reader(&reader);
+  }
+  pthread_mutex_lock(&stream->m_mutex);
+  stream->m_bytes += n_bytes;
+  stream->m_ids += n_ids;
+  stream->m_reader_wait += waited;
+  stream->m_reader_busy += seconds_since(&start) - waited;
+  /* the last reader ends the stream */
+  if (--stream->m_active_readers == 0) {
+    stream->m_done = 1;
+    stream->m_elapsed = seconds_since(&stream->m_start);
+    pthread_cond_broadcast(&stream->m_has_full);
+  }
+  pthread_mutex_unlock(&stream->m_mutex);
+  return NULL;
+}
+
+void open_stream(stream_t *a_stream, const opt_t *a_opts,
+                 const vocab_t *a_vocab, const size_t a_n_tasks) {
+  a_stream->m_n_paths = expand_file_list(a_opts->m_train_file,
+                                        &a_stream->m_paths);
+  /* pipes can only be read once, so they have to be streamed `-iter'
+     times */
+  a_stream->m_passes = has_stream_file(a_opts->m_train_file)?
+                       1: (int) a_opts->m_iter;
+  a_stream->m_next_path = 0;
+  a_stream->m_n_readers = a_opts->m_read_threads > 0?
+                          a_opts->m_read_threads: a_opts->m_num_threads;
+  if (a_stream->m_n_readers > a_stream->m_n_paths * a_stream->m_passes)
+    a_stream->m_n_readers = a_stream->m_n_paths * a_stream->m_passes;
+  if (a_stream->m_n_readers < 1)
+    a_stream->m_n_readers = 1;
+  a_stream->m_active_readers = a_stream->m_n_readers;
+  a_stream->m_vocab = a_vocab;
+  a_stream->m_consume_tab = a_opts->m_ts <= 0 && a_opts->m_ts_w2v <= 0 \
+                            && a_opts->m_ts_least_sq <= 0;
+  a_stream->m_n_tasks = a_n_tasks;
+  a_stream->m_n_batches = a_opts->m_stream_buffer > 0?
+                          a_opts->m_stream_buffer: 1;
+  a_stream->m_batches = (stream_batch_t *) calloc(a_stream->m_n_batches,
+                                                  sizeof(stream_batch_t));
+  a_stream->m_free = (int *) malloc(a_stream->m_n_batches * sizeof(int));
+  a_stream->m_full = (int *) malloc(a_stream->m_n_batches * sizeof(int));
+  a_stream->m_threads = (pthread_t *) malloc(a_stream->m_n_readers
+                                             * sizeof(pthread_t));
+  if (a_stream->m_batches == NULL || a_stream->m_free == NULL
+      || a_stream->m_full == NULL || a_stream->m_threads == NULL) {
+    fprintf(stderr, "Could not allocate memory for stream batches.\n");
+    exit(EXIT_FAILURE);
+  }
+  int i;
+  for (i = 0; i < a_stream->m_n_batches; ++i)
+    a_stream->m_free[i] = i;
+  a_stream->m_n_free = a_stream->m_n_batches;
+  a_stream->m_head = a_stream->m_n_full = 0;
+  a_stream->m_done = 0;
+  a_stream->m_bytes = a_stream->m_ids = 0;
+  a_stream->m_elapsed = a_stream->m_reader_busy = 0.;
+  a_stream->m_reader_wait = a_stream->m_trainer_wait = 0.;
+  pthread_mutex_init(&a_stream->m_mutex, NULL);
+  pthread_cond_init(&a_stream->m_has_free, NULL);
+  pthread_cond_init(&a_stream->m_has_full, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &a_stream->m_start);
+  for (i = 0; i < a_stream->m_n_readers; ++i)
+    pthread_create(&a_stream->m_threads[i], NULL, read_stream_thread,
+                   (void *) a_stream);
+}
+
+void close_stream(stream_t *a_stream) {
+  int i;
+  for (i = 0; i < a_stream->m_n_readers; ++i)
+    pthread_join(a_stream->m_threads[i], NULL);
+  pthread_mutex_destroy(&a_stream->m_mutex);
+  pthread_cond_destroy(&a_stream->m_has_free);
+  pthread_cond_destroy(&a_stream->m_has_full);
+  for (i = 0; i < a_stream->m_n_batches; ++i) {
+    free(a_stream->m_batches[i].m_ids);
+    free(a_stream->m_batches[i].m_layout.m_lines);
+    free(a_stream->m_batches[i].m_layout.m_tags);
+  }
+  free(a_stream->m_batches);
+  free(a_stream->m_free);
+  free(a_stream->m_full);
+  free(a_stream->m_threads);
+  free(a_stream->m_paths);
+  a_stream->m_batches = NULL;
+  a_stream->m_free = a_stream->m_full = NULL;
+  a_stream->m_threads = NULL;
+  a_stream->m_paths = NULL;
+}
+
+const corpus_t *next_batch(stream_t *a_stream) {
+  struct timespec wait_start;
+  int idx;
+  pthread_mutex_lock(&a_stream->m_mutex);
+  if (a_stream->m_n_full == 0 && !a_stream->m_done) {
+    clock_gettime(CLOCK_MONOTONIC, &wait_start);
+    while (a_stream->m_n_full == 0 && !a_stream->m_done)
+      pthread_cond_wait(&a_stream->m_has_full, &a_stream->m_mutex);
+    a_stream->m_trainer_wait += seconds_since(&wait_start);
+  }
+  if (a_stream->m_n_full == 0) {
+    pthread_mutex_unlock(&a_stream->m_mutex);
+    return NULL;
+  }
+  idx = a_stream->m_full[a_stream->m_head];
+  a_stream->m_head = (a_stream->m_head + 1) % a_stream->m_n_batches;
+  --a_stream->m_n_full;
+  pthread_mutex_unlock(&a_stream->m_mutex);
+  return &a_stream->m_batches[idx].m_corpus;
+}
+
+void release_batch(stream_t *a_stream, const corpus_t *a_batch) {
+  /* the corpus view is the first member of its batch */
+  int idx = (int) ((const stream_batch_t *) a_batch - a_stream->m_batches);
+  pthread_mutex_lock(&a_stream->m_mutex);
+  a_stream->m_free[a_stream->m_n_free++] = idx;
+  pthread_cond_signal(&a_stream->m_has_free);
+  pthread_mutex_unlock(&a_stream->m_mutex);
+}
+
+void output_stream_stats(FILE *a_fstream, const stream_t *a_stream) {
+  fprintf(a_fstream, "Stream: %.1f MB  Words: %lld  Batches: %d  "
+          "Shards: %d  Passes: %d\n", a_stream->m_bytes / 1048576.,
+          a_stream->m_ids, a_stream->m_n_batches, a_stream->m_n_paths,
+          a_stream->m_passes);
+  fprintf(a_fstream, "  readers: %d  %.2fk words/sec per reader  waited "
+          "%.2f sec for training threads\n", a_stream->m_n_readers,
+          a_stream->m_ids / (a_stream->m_reader_busy + 1e-9) / 1000,
+          a_stream->m_reader_wait);
+  fprintf(a_fstream, "  training threads: waited %.2f sec for the readers\n",
+          a_stream->m_trainer_wait);
+}
@@ -0,0 +1,188 @@
+/**
+ * @file stream.h
+ * @brief Declaration of training on data streamed from a pipe.
+ *
+ * When the training data come from the standard input (`-train -') or
+ * from a FIFO, they can neither be counted in advance nor be read by
+ * several threads at different offsets.  Instead, reader threads
+ * tokenize the stream with a pre-built vocabulary and pack whole lines
+ * into batches, which have the layout of a compiled corpus (see
+ * corpus.h).  Filled batches are handed to the training threads
+ * through a bounded ring, and the readers wait for a free batch
+ * whenever the training threads fall behind, so that memory use stays
+ * bounded.
+ *
+ * If pipes are listed along with other shards (see shards.h), each
+ * reader takes the next unread shard, so that several shards are
+ * decompressed in parallel.  All shards are read exactly once.
+ *
+ * Compressed files cannot be split among the training threads, so
+ * sharded data with fewer compressed shards than training threads are
+ * streamed as well.  Since files (unlike pipes) can be read again,
+ * their shards are then read once per iteration.
+ */
+
+#ifndef __WORD2VEC_STREAM_H__
+# define __WORD2VEC_STREAM_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+#include "corpus.h"
+#include "shards.h"
+#include "vocab.h"
+#include "w2vio.h"
+
+#include <pthread.h>
+#include <stdint.h>  /* int32_t, int64_t */
+#include <stdio.h>   /* FILE * */
+#include <time.h>    /* struct timespec */
+
+////////////
+// Macros //
+////////////
+/** @brief Number of ids after which a batch is closed at the next end
+    of line */
+# define STREAM_BATCH_IDS (1 << 16)
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Lines of the stream converted to vocabulary ids.
+ */
+typedef struct {
+  corpus_t m_corpus;		/**< view of the batch as a corpus */
+  int32_t *m_ids;		/**< vocabulary ids */
+  size_t m_ids_capacity;	/**< allocated size of `m_ids' */
+  corpus_lines_t m_layout;	/**< line offsets and labels */
+} stream_batch_t;
+
+/**
+ * @brief Readers of a stream and queue of its batches.
+ */
+typedef struct {
+  const vocab_t *m_vocab;	/**< vocabulary */
+  char **m_paths;		/**< shards of the stream */
+  int m_n_paths;		/**< number of shards */
+  int m_passes;			/**< number of times the shards are read */
+  int m_next_path;		/**< next shard to read (counting the
+				   shards of all passes) */
+  int m_consume_tab;		/**< tabs are white spaces (no tasks) */
+  size_t m_n_tasks;		/**< number of labels per line */
+  stream_batch_t *m_batches;	/**< all batches */
+  int m_n_batches;		/**< number of batches */
+  int *m_free;			/**< stack of empty batches */
+  int m_n_free;			/**< number of empty batches */
+  int *m_full;			/**< ring of filled batches */
+  int m_head;			/**< oldest filled batch in `m_full' */
+  int m_n_full;			/**< number of filled batches */
+  int m_done;			/**< the whole stream has been read */
+  pthread_mutex_t m_mutex;	/**< lock guarding the queues */
+  pthread_cond_t m_has_free;	/**< signals an empty batch */
+  pthread_cond_t m_has_full;	/**< signals a filled batch or the end */
+  pthread_t *m_threads;		/**< reader threads */
+  int m_n_readers;		/**< number of reader threads */
+  int m_active_readers;		/**< readers which have not finished */
+  struct timespec m_start;	/**< time when the stream was opened */
+  long long m_bytes;		/**< (decompressed) bytes read */
+  long long m_ids;		/**< ids passed to training */
+  double m_elapsed;		/**< seconds until the end of the stream */
+  double m_reader_busy;		/**< seconds the readers spent reading */
+  double m_reader_wait;		/**< seconds the readers waited for an
+				   empty batch */
+  double m_trainer_wait;	/**< seconds the training threads waited
+				   for a filled batch */
+} stream_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Check whether training data can only be read sequentially.
+ *
+ * @param a_path - path to the training data (`-' for the standard
+ *   input)
+ *
+ * @return \c int - non-zero for the standard input, FIFOs, sockets,
+ *   and character devices
+ */
+int is_stream_file(const char *a_path);
+
+/**
+ * Check whether a list of training files contains a pipe.
+ *
+ * @param a_train_file - comma-separated list of training files
+ *
+ * @return \c int - non-zero if is_stream_file() holds for any of them
+ */
+int has_stream_file(const char *a_train_file);
+
+/**
+ * Check whether training data have to be read by stream readers,
+ * i.e., whether they contain a pipe or fewer compressed shards than
+ * there are training threads.
+ *
+ * @param a_opts - command line options (training files and threads)
+ *
+ * @return \c int - non-zero if the data should be streamed
+ */
+int is_streamed_input(const opt_t *a_opts);
+
+/**
+ * Open the stream and start reading it in the background.
+ *
+ * @param a_stream - stream to initialize
+ * @param a_opts - command line options (training files, task modes,
+ *   buffer size, and number of readers)
+ * @param a_vocab - vocabulary used for tokenization
+ * @param a_n_tasks - number of user-defined tasks
+ *
+ * @return \c void
+ */
+void open_stream(stream_t *a_stream, const opt_t *a_opts,
+                 const vocab_t *a_vocab, const size_t a_n_tasks);
+
+/**
+ * Wait for the readers to finish and release all batches.
+ *
+ * @param a_stream - stream to close
+ *
+ * @return \c void
+ */
+void close_stream(stream_t *a_stream);
+
+/**
+ * Take the oldest filled batch, waiting for the readers if necessary.
+ *
+ * @param a_stream - stream
+ *
+ * @return \c const corpus_t* - batch to train on, \c NULL if the
+ *   whole stream has been consumed
+ */
+const corpus_t *next_batch(stream_t *a_stream);
+
+/**
+ * Give a batch back to the readers.
+ *
+ * @param a_stream - stream
+ * @param a_batch - batch obtained from next_batch()
+ *
+ * @return \c void
+ */
+void release_batch(stream_t *a_stream, const corpus_t *a_batch);
+
+/**
+ * Output throughput of the readers and waiting times on both sides of
+ * the buffer.
+ *
+ * @param a_fstream - output stream
+ * @param a_stream - closed stream
+ *
+ * @return \c void
+ */
+void output_stream_stats(FILE *a_fstream, const stream_t *a_stream);
+#endif  /* ifndef __WORD2VEC_STREAM_H__ */
@@ -0,0 +1,136 @@
+//////////////
+// Includes //
+//////////////
+#include "sync.h"
+
+#include <errno.h>   /* EBUSY */
+#include <stdio.h>   /* fprintf() */
+#include <string.h>  /* strcmp() */
+
+/////////////
+// Methods //
+/////////////
+
+static size_t get_stripe(const sync_t *a_sync, unsigned long long a_key) {
+  /* multiplicative hashing spreads consecutive rows across stripes */
+  return ((a_key * 0x9E3779B97F4A7C15ULL) >> 32) % a_sync->m_n_stripes;
+}
+
+static void lock_stripe(sync_stripe_t *a_stripe) {
+  int ret = pthread_mutex_trylock(&a_stripe->m_lock);
+  if (ret == EBUSY) {
+    pthread_mutex_lock(&a_stripe->m_lock);
+    ++a_stripe->m_contended;
+  }
+  ++a_stripe->m_acquired;
+}
+
+void init_sync(sync_t *a_sync, const sync_mode_t a_mode,
+               const size_t a_n_stripes) {
+  a_sync->m_mode = a_mode;
+  a_sync->m_n_stripes = 0;
+  a_sync->m_stripes = NULL;
+  if (a_mode == SYNC_HOGWILD)
+    return;
+
+  size_t n_stripes = (a_mode == SYNC_MUTEX || a_n_stripes == 0)? 1: a_n_stripes;
+  if (posix_memalign((void **) &a_sync->m_stripes, sizeof(sync_stripe_t),
+                     n_stripes * sizeof(sync_stripe_t))) {
+    fprintf(stderr, "Could not allocate memory for lock stripes.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t i;
+  for (i = 0; i < n_stripes; ++i) {
+    if (pthread_mutex_init(&a_sync->m_stripes[i].m_lock, NULL)) {
+      fprintf(stderr, "\nmutex init failed\n");
+      exit(5);
+    }
+    a_sync->m_stripes[i].m_acquired = 0;
+    a_sync->m_stripes[i].m_contended = 0;
+  }
+  a_sync->m_n_stripes = n_stripes;
+}
+
+void free_sync(sync_t *a_sync) {
+  size_t i;
+  for (i = 0; i < a_sync->m_n_stripes; ++i)
+    pthread_mutex_destroy(&a_sync->m_stripes[i].m_lock);
+
+  free(a_sync->m_stripes);
+  a_sync->m_stripes = NULL;
+  a_sync->m_n_stripes = 0;
+}
+
+const char *sync_mode2str(const sync_mode_t a_mode) {
+  switch (a_mode) {
+  case SYNC_HOGWILD:
+    return "hogwild";
+  case SYNC_MUTEX:
+    return "mutex";
+  case SYNC_STRIPED:
+    return "striped";
+  }
+  return "unknown";
+}
+
+int str2sync_mode(const char *a_str, sync_mode_t *a_mode) {
+  if (strcmp(a_str, "hogwild") == 0)
+    *a_mode = SYNC_HOGWILD;
+  else if (strcmp(a_str, "mutex") == 0)
+    *a_mode = SYNC_MUTEX;
+  else if (strcmp(a_str, "striped") == 0)
+    *a_mode = SYNC_STRIPED;
+  else
+    return -1;
+
+  return 0;
+}
+
+void output_sync_stats(FILE *a_ostream, const sync_t *a_sync) {
+  fprintf(a_ostream, "Synchronization: %s", sync_mode2str(a_sync->m_mode));
+  if (a_sync->m_mode == SYNC_HOGWILD) {
+    fprintf(a_ostream, "\n");
+    return;
+  }
+
+  size_t i, busiest = 0;
+  long long acquired = 0, contended = 0;
+  for (i = 0; i < a_sync->m_n_stripes; ++i) {
+    acquired += a_sync->m_stripes[i].m_acquired;
+    contended += a_sync->m_stripes[i].m_contended;
+    if (a_sync->m_stripes[i].m_contended
+        > a_sync->m_stripes[busiest].m_contended)
+      busiest = i;
+  }
+  fprintf(a_ostream, "  Stripes: %zu  Acquired: %lld  Contended: %lld (%.2f%%)"
+          "  Busiest stripe: %zu (%lld contended)\n",
+          a_sync->m_n_stripes, acquired, contended,
+          acquired? 100. * contended / acquired: 0.,
+          busiest, a_sync->m_stripes[busiest].m_contended);
+}
+
+void sync_acquire(sync_t *a_sync, unsigned long long a_key1,
+                  unsigned long long a_key2) {
+  size_t i = get_stripe(a_sync, a_key1);
+  size_t j = (a_key2 == SYNC_NO_KEY)? i: get_stripe(a_sync, a_key2);
+  /* always lock stripes in ascending order to prevent deadlocks */
+  if (j < i) {
+    size_t tmp = i;
+    i = j;
+    j = tmp;
+  }
+  lock_stripe(&a_sync->m_stripes[i]);
+  if (j != i)
+    lock_stripe(&a_sync->m_stripes[j]);
+}
+
+void sync_release(sync_t *a_sync, unsigned long long a_key1,
+                  unsigned long long a_key2) {
+  size_t i = get_stripe(a_sync, a_key1);
+  size_t j = (a_key2 == SYNC_NO_KEY)? i: get_stripe(a_sync, a_key2);
+  if (j != i)
+    pthread_mutex_unlock(&a_sync->m_stripes[j].m_lock);
+
+  pthread_mutex_unlock(&a_sync->m_stripes[i].m_lock);
+}
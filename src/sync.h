@@ -0,0 +1,190 @@
+/**
+ * @file sync.h
+ * @brief Declaration of synchronization engines guarding model updates.
+ */
+
+#ifndef __WORD2VEC_SYNC_H__
+# define __WORD2VEC_SYNC_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+
+#include <pthread.h>
+#include <stdio.h>   /* FILE * */
+
+////////////
+// Macros //
+////////////
+
+/** @brief Key denoting the absence of a second locked row. */
+# define SYNC_NO_KEY (~0ULL)
+/**
+ * @brief Build lock key for the row of a particular model layer.
+ *
+ * @param layer - #sync_layer_t identifier of the layer
+ * @param row - index of the row in that layer
+ */
+# define SYNC_KEY(layer, row) \
+  ((((unsigned long long) (layer)) << 48) ^ ((unsigned long long) (row)))
+
+///////////////
+// Constants //
+///////////////
+
+/**
+ * @brief Identifiers of model layers whose rows can be locked.
+ *
+ * The weights for the i-th user-defined task are identified as
+ * `SYNC_VEC2TASK + i'.
+ */
+typedef enum {
+  SYNC_SYN0 = 0,		/**< word embeddings */
+  SYNC_SYN1,			/**< hierarchical softmax layer */
+  SYNC_SYN1NEG,			/**< negative sampling layer */
+  SYNC_TS_SYN0,			/**< isolated task-specific embeddings */
+  SYNC_VEC2TASK			/**< task-specific output layers */
+} sync_layer_t;
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Single lock stripe together with its usage statistics.
+ *
+ * The counters are only modified while holding the stripe's lock, so
+ * they do not require atomic operations.
+ */
+typedef struct {
+  pthread_mutex_t m_lock;	/**< lock guarding the stripe */
+  long long m_acquired;		/**< number of times lock was taken */
+  long long m_contended;	/**< number of times lock was busy */
+} __attribute__((aligned(64))) sync_stripe_t;
+
+/**
+ * @brief Synchronization engine shared by all training threads.
+ *
+ * In the #SYNC_HOGWILD mode, all lock operations are no-ops and the
+ * threads update model parameters without any coordination.  In the
+ * #SYNC_STRIPED mode, each row of a model layer is mapped to one of
+ * `m_n_stripes' locks, so that only threads which touch the same rows
+ * contend with each other.  The #SYNC_MUTEX mode is a special case of
+ * striping with one single stripe.
+ */
+typedef struct {
+  sync_mode_t m_mode;		/**< active synchronization mode */
+  size_t m_n_stripes;		/**< number of lock stripes */
+  sync_stripe_t *m_stripes;	/**< array of lock stripes */
+} sync_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Initialize synchronization engine.
+ *
+ * @param a_sync - engine to initialize
+ * @param a_mode - synchronization mode to use
+ * @param a_n_stripes - number of lock stripes (only used in
+ *   #SYNC_STRIPED mode)
+ *
+ * @return \c void
+ */
+void init_sync(sync_t *a_sync, const sync_mode_t a_mode,
+               const size_t a_n_stripes);
+
+/**
+ * Release resources held by synchronization engine.
+ *
+ * @param a_sync - engine to free
+ *
+ * @return \c void
+ */
+void free_sync(sync_t *a_sync);
+
+/**
+ * Return human-readable name of synchronization mode.
+ *
+ * @param a_mode - synchronization mode
+ *
+ * @return \c const char* - name of the mode
+ */
+const char *sync_mode2str(const sync_mode_t a_mode);
+
+/**
+ * Parse synchronization mode from its name.
+ *
+ * @param a_str - name of the mode
+ * @param a_mode - target mode to populate
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2sync_mode(const char *a_str, sync_mode_t *a_mode);
+
+/**
+ * Output lock contention statistics.
+ *
+ * @param a_ostream - output stream
+ * @param a_sync - synchronization engine
+ *
+ * @return \c void
+ */
+void output_sync_stats(FILE *a_ostream, const sync_t *a_sync);
+
+/**
+ * Acquire locks for the given rows (slow path).
+ *
+ * @param a_sync - synchronization engine
+ * @param a_key1 - key of the first row
+ * @param a_key2 - key of the second row or #SYNC_NO_KEY
+ *
+ * @return \c void
+ */
+void sync_acquire(sync_t *a_sync, unsigned long long a_key1,
+                  unsigned long long a_key2);
+
+/**
+ * Release locks for the given rows (slow path).
+ *
+ * @param a_sync - synchronization engine
+ * @param a_key1 - key of the first row
+ * @param a_key2 - key of the second row or #SYNC_NO_KEY
+ *
+ * @return \c void
+ */
+void sync_release(sync_t *a_sync, unsigned long long a_key1,
+                  unsigned long long a_key2);
+
+/**
+ * Acquire exclusive access to (up to) two model rows.
+ *
+ * @param a_sync - synchronization engine
+ * @param a_key1 - #SYNC_KEY of the first row
+ * @param a_key2 - #SYNC_KEY of the second row or #SYNC_NO_KEY
+ *
+ * @return \c void
+ */
+static inline void sync_lock(sync_t *a_sync, unsigned long long a_key1,
+                             unsigned long long a_key2) {
+  if (a_sync->m_mode != SYNC_HOGWILD)
+    sync_acquire(a_sync, a_key1, a_key2);
+}
+
+/**
+ * Release exclusive access to (up to) two model rows.
+ *
+ * @param a_sync - synchronization engine
+ * @param a_key1 - #SYNC_KEY of the first row
+ * @param a_key2 - #SYNC_KEY of the second row or #SYNC_NO_KEY
+ *
+ * @return \c void
+ */
+static inline void sync_unlock(sync_t *a_sync, unsigned long long a_key1,
+                               unsigned long long a_key2) {
+  if (a_sync->m_mode != SYNC_HOGWILD)
+    sync_release(a_sync, a_key1, a_key2);
+}
+#endif  /* ifndef __WORD2VEC_SYNC_H__ */
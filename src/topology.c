@@ -0,0 +1,261 @@
+//////////////
+// Includes //
+//////////////
+#define _GNU_SOURCE  /* sched_setaffinity(), CPU_SET() */
+#include "topology.h"
+
+#include <sched.h>        /* sched_getaffinity() */
+#include <stdint.h>       /* uintptr_t */
+#include <string.h>       /* strcmp() */
+#include <sys/syscall.h>  /* SYS_mbind */
+#include <unistd.h>       /* syscall(), sysconf() */
+
+////////////
+// Macros //
+////////////
+/* memory policies of mbind(2), see <linux/mempolicy.h> */
+#define W2V_MPOL_PREFERRED 1
+#define W2V_MPOL_INTERLEAVE 3
+
+/////////////
+// Methods //
+/////////////
+
+/* parse a kernel CPU list (e.g., `0-3,8-11') into a bit set */
+static void parse_cpulist(const char *a_list, cpu_set_t *a_set) {
+  const char *p = a_list;
+  char *end;
+  long lo, hi;
+  CPU_ZERO(a_set);
+  while (*p) {
+    lo = strtol(p, &end, 10);
+    if (end == p)
+      break;
+
+    hi = lo;
+    p = end;
+    if (*p == '-') {
+      hi = strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (; lo <= hi && lo < CPU_SETSIZE; ++lo)
+      CPU_SET(lo, a_set);
+    if (*p == ',')
+      ++p;
+    else
+      break;
+  }
+}
+
+static int read_node_cpus(int a_node, cpu_set_t *a_set) {
+  char path[MAX_STRING], list[4096];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+           a_node);
+  FILE *fin = fopen(path, "r");
+  if (fin == NULL)
+    return -1;
+
+  if (fgets(list, sizeof(list), fin) == NULL)
+    list[0] = '\0';
+  fclose(fin);
+  parse_cpulist(list, a_set);
+  return 0;
+}
+
+static long do_mbind(void *a_addr, size_t a_size, int a_mode,
+                     const unsigned long *a_mask) {
+#ifdef SYS_mbind
+  /* the kernel expects the number of mask bits plus one */
+  return syscall(SYS_mbind, a_addr, a_size, a_mode, a_mask,
+                 (unsigned long) MAX_NUMA_NODES + 1, 0);
+#else
+  UNUSED(a_addr);
+  UNUSED(a_size);
+  UNUSED(a_mode);
+  UNUSED(a_mask);
+  return -1;
+#endif
+}
+
+void init_topology(topology_t *a_topology) {
+  cpu_set_t allowed, node_cpus;
+  cpu_set_t *sets = (cpu_set_t *) malloc(MAX_NUMA_NODES * sizeof(cpu_set_t));
+  int *counts = (int *) calloc(MAX_NUMA_NODES, sizeof(int));
+  int node, cpu, i, k, n_nodes = 0, n_cpus = 0, max_count = 0;
+  a_topology->m_nodes = (int *) malloc(MAX_NUMA_NODES * sizeof(int));
+  if (sets == NULL || counts == NULL || a_topology->m_nodes == NULL) {
+    fprintf(stderr, "Could not allocate memory for CPU topology.\n");
+    exit(EXIT_FAILURE);
+  }
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    for (cpu = 0; cpu < n && cpu < CPU_SETSIZE; ++cpu)
+      CPU_SET(cpu, &allowed);
+  }
+
+  for (node = 0; node < MAX_NUMA_NODES; ++node) {
+    if (read_node_cpus(node, &node_cpus))
+      continue;
+
+    CPU_AND(&sets[n_nodes], &node_cpus, &allowed);
+    counts[n_nodes] = CPU_COUNT(&sets[n_nodes]);
+    if (counts[n_nodes] == 0)
+      continue;
+
+    if (counts[n_nodes] > max_count)
+      max_count = counts[n_nodes];
+    n_cpus += counts[n_nodes];
+    a_topology->m_nodes[n_nodes++] = node;
+  }
+  /* no NUMA information: one node with all allowed CPUs */
+  if (n_nodes == 0) {
+    CPU_ZERO(&sets[0]);
+    CPU_OR(&sets[0], &sets[0], &allowed);
+    counts[0] = max_count = n_cpus = CPU_COUNT(&allowed);
+    a_topology->m_nodes[0] = 0;
+    n_nodes = 1;
+  }
+
+  /* k-th CPU of each node, then (k+1)-th CPU of each node, etc. */
+  a_topology->m_cpus = (int *) malloc((n_cpus + 1) * sizeof(int));
+  a_topology->m_cpu_nodes = (int *) malloc((n_cpus + 1) * sizeof(int));
+  if (a_topology->m_cpus == NULL || a_topology->m_cpu_nodes == NULL) {
+    fprintf(stderr, "Could not allocate memory for CPU topology.\n");
+    exit(EXIT_FAILURE);
+  }
+  a_topology->m_n_cpus = 0;
+  for (k = 0; k < max_count; ++k) {
+    for (i = 0; i < n_nodes; ++i) {
+      int seen = 0;
+      for (cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &sets[i]))
+          continue;
+
+        if (seen++ == k) {
+          a_topology->m_cpus[a_topology->m_n_cpus] = cpu;
+          a_topology->m_cpu_nodes[a_topology->m_n_cpus++] = i;
+          break;
+        }
+      }
+    }
+  }
+  a_topology->m_n_nodes = n_nodes;
+  free(sets);
+  free(counts);
+}
+
+void free_topology(topology_t *a_topology) {
+  free(a_topology->m_nodes);
+  free(a_topology->m_cpus);
+  free(a_topology->m_cpu_nodes);
+  a_topology->m_nodes = a_topology->m_cpus = a_topology->m_cpu_nodes = NULL;
+  a_topology->m_n_nodes = a_topology->m_n_cpus = 0;
+}
+
+void output_topology(FILE *a_fstream, const topology_t *a_topology,
+                     const opt_t *a_opts) {
+  int i, j, first;
+  fprintf(a_fstream, "NUMA nodes: %d  CPUs: %d  Placement: %s  Pinning: %s\n",
+          a_topology->m_n_nodes, a_topology->m_n_cpus,
+          numa_mode2str(a_opts->m_numa), a_opts->m_pin? "on": "off");
+  for (i = 0; i < a_topology->m_n_nodes; ++i) {
+    fprintf(a_fstream, "  node %d: CPUs", a_topology->m_nodes[i]);
+    first = 1;
+    for (j = 0; j < a_topology->m_n_cpus; ++j) {
+      if (a_topology->m_cpu_nodes[j] == i) {
+        fprintf(a_fstream, "%c%d", first? ' ': ',', a_topology->m_cpus[j]);
+        first = 0;
+      }
+    }
+    fprintf(a_fstream, "\n");
+  }
+  if (a_opts->m_pin) {
+    for (i = 0; i < a_opts->m_num_threads; ++i) {
+      j = i % a_topology->m_n_cpus;
+      fprintf(a_fstream, "  thread %d: CPU %d (node %d)\n", i,
+              a_topology->m_cpus[j],
+              a_topology->m_nodes[a_topology->m_cpu_nodes[j]]);
+    }
+  }
+}
+
+int pin_thread(const topology_t *a_topology, const long a_thread_id) {
+  if (a_topology->m_n_cpus == 0)
+    return -1;
+
+  int cpu = a_topology->m_cpus[a_thread_id % a_topology->m_n_cpus];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set))
+    return -1;
+
+  return cpu;
+}
+
+int place_memory(const topology_t *a_topology, const numa_mode_t a_mode,
+                 void *a_addr, size_t a_size) {
+  if (a_mode == NUMA_NONE || a_topology->m_n_nodes < 2 || a_size == 0)
+    return 0;
+
+  const uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t) a_addr & ~(page - 1);
+  uintptr_t end = (uintptr_t) a_addr + a_size;
+  unsigned long mask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+  const int bits = 8 * sizeof(unsigned long);
+  int i, node, ret = 0;
+
+  memset(mask, 0, sizeof(mask));
+  if (a_mode == NUMA_INTERLEAVE) {
+    for (i = 0; i < a_topology->m_n_nodes; ++i) {
+      node = a_topology->m_nodes[i];
+      mask[node / bits] |= 1UL << (node % bits);
+    }
+    return do_mbind((void *) start, end - start, W2V_MPOL_INTERLEAVE,
+                    mask)? -1: 0;
+  }
+
+  /* partition: split the region into one contiguous block per node */
+  uintptr_t block = ((end - start) / a_topology->m_n_nodes + page - 1)
+                    & ~(page - 1);
+  uintptr_t lo, hi;
+  for (i = 0; i < a_topology->m_n_nodes; ++i) {
+    lo = start + i * block;
+    if (lo >= end)
+      break;
+
+    hi = lo + block < end? lo + block: end;
+    node = a_topology->m_nodes[i];
+    memset(mask, 0, sizeof(mask));
+    mask[node / bits] |= 1UL << (node % bits);
+    if (do_mbind((void *) lo, hi - lo, W2V_MPOL_PREFERRED, mask))
+      ret = -1;
+  }
+  return ret;
+}
+
+const char *numa_mode2str(const numa_mode_t a_mode) {
+  switch (a_mode) {
+  case NUMA_NONE:
+    return "none";
+  case NUMA_INTERLEAVE:
+    return "interleave";
+  case NUMA_PARTITION:
+    return "partition";
+  }
+  return "unknown";
+}
+
+int str2numa_mode(const char *a_str, numa_mode_t *a_mode) {
+  if (strcmp(a_str, "none") == 0)
+    *a_mode = NUMA_NONE;
+  else if (strcmp(a_str, "interleave") == 0)
+    *a_mode = NUMA_INTERLEAVE;
+  else if (strcmp(a_str, "partition") == 0)
+    *a_mode = NUMA_PARTITION;
+  else
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file topology.h
+ * @brief Declaration of NUMA topology detection, thread pinning, and
+ * memory placement.
+ *
+ * The topology is read from `/sys/devices/system/node', and memory
+ * policies are set with the `mbind()' system call directly, so that
+ * no NUMA library is required.  On machines (or kernels) without NUMA
+ * support, all CPUs are treated as a single node and memory placement
+ * is a no-op.
+ */
+
+#ifndef __WORD2VEC_TOPOLOGY_H__
+# define __WORD2VEC_TOPOLOGY_H__
+
+//////////////
+// Includes //
+//////////////
+#include "common.h"
+
+#include <stddef.h>  /* size_t */
+#include <stdio.h>   /* FILE */
+
+////////////
+// Macros //
+////////////
+/** @brief Maximum number of NUMA nodes considered for memory placement */
+#define MAX_NUMA_NODES 64
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief CPUs and NUMA nodes available to the process.
+ */
+typedef struct {
+  int m_n_nodes;		/**< number of NUMA nodes with CPUs */
+  int m_n_cpus;			/**< number of usable CPUs */
+  int *m_nodes;			/**< ids of the NUMA nodes */
+  int *m_cpus;			/**< CPUs in pinning order (consecutive
+				   entries alternate between nodes) */
+  int *m_cpu_nodes;		/**< index of the node of each entry of
+				   `m_cpus' */
+} topology_t;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Detect CPUs and NUMA nodes available to the process.
+ *
+ * @param a_topology - topology to populate
+ *
+ * @return \c void
+ */
+void init_topology(topology_t *a_topology);
+
+/**
+ * Release memory held by the topology.
+ *
+ * @param a_topology - topology to free
+ *
+ * @return \c void
+ */
+void free_topology(topology_t *a_topology);
+
+/**
+ * Output detected topology and the way it is used.
+ *
+ * @param a_fstream - output stream
+ * @param a_topology - detected topology
+ * @param a_opts - command line options (placement and pinning)
+ *
+ * @return \c void
+ */
+void output_topology(FILE *a_fstream, const topology_t *a_topology,
+                     const opt_t *a_opts);
+
+/**
+ * Pin the calling thread to a CPU.
+ *
+ * Threads with consecutive ids are assigned to CPUs of alternating
+ * nodes, so that the load is balanced across memory controllers.
+ *
+ * @param a_topology - detected topology
+ * @param a_thread_id - id of the calling thread
+ *
+ * @return \c id of the CPU, or \c -1 if the thread could not be pinned
+ */
+int pin_thread(const topology_t *a_topology, const long a_thread_id);
+
+/**
+ * Set placement policy for a memory region before it is touched.
+ *
+ * The region should be page-aligned.  Failures (e.g., due to missing
+ * kernel support) are not fatal: the region then keeps the default
+ * first-touch placement.
+ *
+ * @param a_topology - detected topology
+ * @param a_mode - placement policy
+ * @param a_addr - start of the region
+ * @param a_size - size of the region in bytes
+ *
+ * @return \c 0 on success, \c -1 if the policy could not be set
+ */
+int place_memory(const topology_t *a_topology, const numa_mode_t a_mode,
+                 void *a_addr, size_t a_size);
+
+/**
+ * Convert placement policy to its command line name.
+ *
+ * @param a_mode - placement policy
+ *
+ * @return \c const char* - name of the policy
+ */
+const char *numa_mode2str(const numa_mode_t a_mode);
+
+/**
+ * Parse command line name of a placement policy.
+ *
+ * @param a_str - name of the policy (`none', `interleave', or
+ *   `partition')
+ * @param a_mode - parsed policy
+ *
+ * @return \c 0 on success, \c -1 if the name is unknown
+ */
+int str2numa_mode(const char *a_str, numa_mode_t *a_mode);
+#endif  /* ifndef __WORD2VEC_TOPOLOGY_H__ */
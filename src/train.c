@@ -1,19 +1,46 @@
 //////////////
 // Includes //
 //////////////
+#include "checkpoint.h"
 #include "common.h"
+#include "corpus.h"
+#include "kernels.h"
+#include "pages.h"
+#include "rng.h"
+#include "sampler.h"
+#include "schedule.h"
+#include "shards.h"
+#include "sigmoid.h"
+#include "stream.h"
+#include "sync.h"
+#include "topology.h"
 #include "train.h"
 #include "vocab.h"
 #include "w2vio.h"
 
+#include <gsl/gsl_cblas.h>
 #include <gsl/gsl_multifit.h>
+#include <limits.h>  /* LLONG_MAX */
 #include <math.h>
 #include <pthread.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>  /* memset */
+#include <sys/stat.h>  /* stat() */
 #include <time.h>
 
+////////////
+// Macros //
+////////////
+/** @brief Number of negative examples whose output rows are prefetched
+    ahead of their use */
+#define NEGATIVE_PREFETCH 2
+/** @brief Number of interleaved random streams filled by each
+    initialization thread */
+#define INIT_LANES 8
+/** @brief Minimum number of matrix elements initialized per thread */
+#define INIT_MIN_PART (1 << 20)
+
 /////////////
 // Structs //
 /////////////
@@ -57,23 +84,211 @@ typedef struct {
    */
   nnet_t *m_nnet;
   /**
-   * @brief Table with exponents
+   * @brief Approximation of the sigmoid
    */
-  const real *m_exp_table;
+  const sigmoid_t *m_sigmoid;
   /**
-   * @brief Unigram table
+   * @brief Sampler of negative examples
    */
-  const int *m_ugram_table;
+  const sampler_t *m_sampler;
   /**
    * @brief Number of user-defined tasks for task-specific mode.
    */
   size_t m_n_tasks;
+  /**
+   * @brief Synchronization engine guarding model updates
+   */
+  sync_t *m_sync;
+  /**
+   * @brief Number of words processed by the thread
+   */
+  long long m_word_count;
+  /**
+   * @brief Compiled corpus (NULL if the text file should be read)
+   */
+  const corpus_t *m_corpus;
+  /**
+   * @brief Number of negative examples drawn by the thread
+   */
+  long long m_negatives_drawn;
+  /**
+   * @brief Number of drawn negative examples which coincided with the
+   * predicted word
+   */
+  long long m_negatives_rejected;
+  /**
+   * @brief CPU topology used for pinning (NULL if threads are not
+   * pinned)
+   */
+  const topology_t *m_topology;
+  /**
+   * @brief Writer of checkpoints (NULL if no checkpoints are written)
+   */
+  checkpointer_t *m_checkpointer;
+  /**
+   * @brief Progress to resume from (NULL if training starts afresh)
+   */
+  const progress_t *m_resume;
+  /**
+   * @brief Scheduler of training chunks (NULL if each thread reads a
+   * fixed share of the data)
+   */
+  scheduler_t *m_scheduler;
+  /**
+   * @brief Streamed training data (NULL if the training file is read
+   * by each thread)
+   */
+  stream_t *m_stream;
+  /**
+   * @brief Words processed by all threads (NULL if each thread
+   * follows its own progress)
+   */
+  long long *m_shared_words;
+  /**
+   * @brief Shards of the plain-text training data (NULL if the data
+   * are streamed)
+   */
+  const shards_t *m_shards;
 } thread_opts_t;
 
-///////////////
-// Constants //
-///////////////
-pthread_mutex_t tlock;
+/**
+ * \struct input_t
+ * \brief source of training words of a single thread
+ *
+ * Words are either read from the plain-text training file or from the
+ * memory-mapped compiled corpus.
+ */
+typedef struct {
+  /**
+   * @brief Reader of the plain-text training file (unused if corpus
+   * is given)
+   */
+  reader_t m_reader;
+  /**
+   * @brief Compiled corpus (NULL if text file is used)
+   */
+  const corpus_t *m_corpus;
+  /**
+   * @brief Position where the thread starts each epoch (byte offset in
+   * the text file or id position in the corpus)
+   */
+  long long m_start;
+  /**
+   * @brief Line of the corpus at which the thread starts each epoch
+   */
+  long long m_start_line;
+  /**
+   * @brief Current id position in the corpus
+   */
+  long long m_pos;
+  /**
+   * @brief Current line in the corpus
+   */
+  long long m_line;
+  /**
+   * @brief Last read id terminated a line
+   */
+  int m_eol;
+  /**
+   * @brief End of the corpus (or of the chunks of the current epoch,
+   * or of the stream) has been reached
+   */
+  int m_eof;
+  /**
+   * @brief Streamed training data (`m_corpus' then points to the
+   * current batch)
+   */
+  stream_t *m_stream;
+  /**
+   * @brief Scheduler of training chunks (NULL if the thread reads a
+   * fixed share of the data)
+   */
+  scheduler_t *m_scheduler;
+  /**
+   * @brief Index of the reading thread
+   */
+  long m_thread_id;
+  /**
+   * @brief Current epoch of the thread
+   */
+  long long m_epoch;
+  /**
+   * @brief End of the current chunk
+   */
+  long long m_end;
+} input_t;
+
+/**
+ * \struct sgns_batch_t
+ * \brief workspace of the minibatched skip-gram kernel
+ *
+ * Rows of all context words of a window are gathered into the input
+ * matrix `m_in', rows of the target word and of the shared negative
+ * samples into the output matrix `m_out', so that scores and
+ * gradients can be computed with matrix-matrix products.
+ */
+typedef struct {
+  /**
+   * @brief Indices of context words (rows of `m_syn0')
+   */
+  long long *m_inputs;
+  /**
+   * @brief Indices of target and negative words (rows of `m_syn1neg')
+   */
+  long long *m_outputs;
+  /**
+   * @brief Gathered input rows (|inputs| x layer1_size)
+   */
+  real *m_in;
+  /**
+   * @brief Gathered output rows (|outputs| x layer1_size)
+   */
+  real *m_out;
+  /**
+   * @brief Scores turned into scaled gradients (|inputs| x |outputs|)
+   */
+  real *m_grad;
+  /**
+   * @brief Updates of input rows (|inputs| x layer1_size)
+   */
+  real *m_in_upd;
+  /**
+   * @brief Updates of output rows (|outputs| x layer1_size)
+   */
+  real *m_out_upd;
+} sgns_batch_t;
+
+/**
+ * \struct init_part_t
+ * \brief slice of a matrix initialized by a single thread
+ */
+typedef struct {
+  /**
+   * @brief Initialized matrix
+   */
+  real *m_layer;
+  /**
+   * @brief First element of the slice
+   */
+  long long m_start;
+  /**
+   * @brief Element past the end of the slice
+   */
+  long long m_end;
+  /**
+   * @brief Number of columns of the matrix
+   */
+  long long m_layer1_size;
+  /**
+   * @brief State of the random generator before the first element of
+   * the matrix (ignored if `m_zero' is set)
+   */
+  unsigned long long m_seed;
+  /**
+   * @brief Fill slice with zeros instead of random values
+   */
+  int m_zero;
+} init_part_t;
 
 /////////////
 // Methods //
@@ -86,6 +301,29 @@ static void init_mtx(void **a_mtx, long long a_size) {
   }
 }
 
+/* allocate page-aligned model matrix (released with free_pages()) and
+   set its NUMA placement before it is first touched */
+static int init_layer(void **a_mtx, long long a_size, const opt_t *a_opts,
+                      const topology_t *a_topology) {
+  page_backing_t backing;
+  *a_mtx = alloc_pages(a_size, a_opts->m_huge_pages, &backing);
+  return place_memory(a_topology, a_opts->m_numa, *a_mtx, a_size);
+}
+
+static void output_layer(FILE *a_fstream, const char *a_name,
+                         const real *a_layer, long long a_size) {
+  if (a_layer == NULL)
+    return;
+
+  /* the mapping may be rounded up to whole huge pages */
+  long long in_huge_pages = huge_pages_in(a_layer);
+  if (in_huge_pages > a_size)
+    in_huge_pages = a_size;
+  fprintf(a_fstream, "Layer %s: %.1f MB in %s (%.1f MB in huge pages)\n",
+          a_name, a_size / 1048576., page_backing2str(page_backing_of(a_layer)),
+          in_huge_pages / 1048576.);
+}
+
 static void copy_thread_opts(const thread_opts_t *src_opts,
                              thread_opts_t *trg_opts, long a_thread_id) {
   trg_opts->m_start = clock();
@@ -96,9 +334,74 @@ static void copy_thread_opts(const thread_opts_t *src_opts,
   trg_opts->m_w2v_opts = src_opts->m_w2v_opts;
   trg_opts->m_vocab = src_opts->m_vocab;
   trg_opts->m_nnet = src_opts->m_nnet;
-  trg_opts->m_exp_table = src_opts->m_exp_table;
-  trg_opts->m_ugram_table = src_opts->m_ugram_table;
+  trg_opts->m_sigmoid = src_opts->m_sigmoid;
+  trg_opts->m_sampler = src_opts->m_sampler;
   trg_opts->m_n_tasks = src_opts->m_n_tasks;
+  trg_opts->m_sync = src_opts->m_sync;
+  trg_opts->m_word_count = 0;
+  trg_opts->m_corpus = src_opts->m_corpus;
+  trg_opts->m_negatives_drawn = 0;
+  trg_opts->m_negatives_rejected = 0;
+  trg_opts->m_topology = src_opts->m_topology;
+  trg_opts->m_checkpointer = src_opts->m_checkpointer;
+  trg_opts->m_scheduler = src_opts->m_scheduler;
+  trg_opts->m_stream = src_opts->m_stream;
+  trg_opts->m_shared_words = src_opts->m_shared_words;
+  trg_opts->m_shards = src_opts->m_shards;
+  /* the source holds the progress of all threads */
+  trg_opts->m_resume = src_opts->m_resume? &src_opts->m_resume[a_thread_id]:
+                       NULL;
+}
+
+static void init_sgns_batch(sgns_batch_t *a_batch, const int a_window,
+                            const int a_negative, const long long a_layer1_size) {
+  long long n_inputs = 2 * a_window;
+  long long n_outputs = a_negative + 1;
+  a_batch->m_inputs = (long long *) calloc(n_inputs, sizeof(long long));
+  a_batch->m_outputs = (long long *) calloc(n_outputs, sizeof(long long));
+  if (a_batch->m_inputs == NULL || a_batch->m_outputs == NULL) {
+    fprintf(stderr, "Could not allocate memory for minibatch indices.\n");
+    exit(EXIT_FAILURE);
+  }
+  init_mtx((void **) &a_batch->m_in, n_inputs * a_layer1_size * sizeof(real));
+  init_mtx((void **) &a_batch->m_out, n_outputs * a_layer1_size * sizeof(real));
+  init_mtx((void **) &a_batch->m_grad, n_inputs * n_outputs * sizeof(real));
+  init_mtx((void **) &a_batch->m_in_upd,
+           n_inputs * a_layer1_size * sizeof(real));
+  init_mtx((void **) &a_batch->m_out_upd,
+           n_outputs * a_layer1_size * sizeof(real));
+}
+
+static void free_sgns_batch(sgns_batch_t *a_batch) {
+  free(a_batch->m_inputs);
+  free(a_batch->m_outputs);
+  free(a_batch->m_in);
+  free(a_batch->m_out);
+  free(a_batch->m_grad);
+  free(a_batch->m_in_upd);
+  free(a_batch->m_out_upd);
+}
+
+/* prefetch output rows of the first pre-drawn negative examples */
+static inline void prefetch_negatives(const negatives_t *a_negatives,
+                                      const real *a_syn1neg,
+                                      const long long a_layer1_size) {
+  long long i;
+  for (i = 0; i < NEGATIVE_PREFETCH && i < a_negatives->m_size; ++i)
+    vec_prefetch(&a_syn1neg[a_negatives->m_ids[i] * a_layer1_size],
+                 a_layer1_size);
+}
+
+/* consume the next pre-drawn negative example and prefetch the output
+   row of a later one */
+static inline long long next_negative(negatives_t *a_negatives,
+                                      const real *a_syn1neg,
+                                      const long long a_layer1_size) {
+  long long ahead = a_negatives->m_pos + NEGATIVE_PREFETCH;
+  if (ahead < a_negatives->m_size)
+    vec_prefetch(&a_syn1neg[a_negatives->m_ids[ahead] * a_layer1_size],
+                 a_layer1_size);
+  return a_negatives->m_ids[a_negatives->m_pos++];
 }
 
 static void reset_multiclass(multiclass_t *a_multiclass) {
@@ -106,16 +409,6 @@ static void reset_multiclass(multiclass_t *a_multiclass) {
   memset(a_multiclass->m_classes, -1, sizeof(int) * MAX_TASKS);
 }
 
-static real *init_exp_table(void) {
-  real *exp_table = (real *) malloc((EXP_TABLE_SIZE + 1) * sizeof(real));
-  int i;
-  for (i = 0; i < EXP_TABLE_SIZE; ++i) {
-    exp_table[i] = exp((i / (real)EXP_TABLE_SIZE * 2 - 1) * MAX_EXP); // Precompute the exp() table
-    exp_table[i] = exp_table[i] / (exp_table[i] + 1); // Precompute f(x) = x / (x + 1)
-  }
-  return exp_table;
-}
-
 static void reset_nnet(nnet_t *a_nnet) {
   /*@null@*/
   a_nnet->m_syn0 = NULL;
@@ -133,11 +426,11 @@ static void reset_nnet(nnet_t *a_nnet) {
 }
 
 static void free_nnet(nnet_t *a_nnet) {
-  free(a_nnet->m_syn0);
-  free(a_nnet->m_ts_syn0);
+  free_pages(a_nnet->m_syn0);
+  free_pages(a_nnet->m_ts_syn0);
   free(a_nnet->m_ts_syn0_active);
-  free(a_nnet->m_syn1);
-  free(a_nnet->m_syn1neg);
+  free_pages(a_nnet->m_syn1);
+  free_pages(a_nnet->m_syn1neg);
 
   size_t i;
   for (i = 0; i < a_nnet->m_n_tasks; ++i) {
@@ -147,8 +440,108 @@ static void free_nnet(nnet_t *a_nnet) {
   reset_nnet(a_nnet);
 }
 
+/* overwrite an initialized matrix with its copy from a checkpoint */
+static void restore_layer(void *a_layer, const void *a_saved, size_t a_size,
+                          const char *a_name) {
+  if (a_layer == NULL)
+    return;
+
+  if (a_saved == NULL) {
+    fprintf(stderr, "ERROR: checkpoint does not contain layer %s\n", a_name);
+    exit(EXIT_FAILURE);
+  }
+  memcpy(a_layer, a_saved, a_size);
+}
+
+static void restore_nnet(nnet_t *a_nnet, const model_t *a_model) {
+  const long long layer1_size = a_model->m_layer1_size;
+  const size_t mtx_size = a_model->m_vocab_size * layer1_size * sizeof(real);
+  long long n_classes;
+  const real *saved;
+  size_t i;
+  restore_layer(a_nnet->m_syn0, a_model->m_syn0, mtx_size, "syn0");
+  restore_layer(a_nnet->m_syn1, a_model->m_syn1, mtx_size, "syn1");
+  restore_layer(a_nnet->m_syn1neg, a_model->m_syn1neg, mtx_size, "syn1neg");
+  restore_layer(a_nnet->m_ts_syn0, a_model->m_ts_syn0, mtx_size, "ts_syn0");
+  restore_layer(a_nnet->m_ts_syn0_active, a_model->m_ts_syn0_active,
+                a_model->m_vocab_size * sizeof(short), "ts_syn0_active");
+  for (i = 0; i < a_nnet->m_n_tasks; ++i) {
+    saved = model_task(a_model, i, &n_classes);
+    restore_layer(a_nnet->m_vec2task[i], saved,
+                  n_classes * layer1_size * sizeof(real), "vec2task");
+  }
+}
+
+static void *init_part_thread(void *a_part) {
+  init_part_t *part = (init_part_t *) a_part;
+  real *layer = part->m_layer;
+  const long long layer1_size = part->m_layer1_size;
+  long long i = part->m_start, j;
+  if (part->m_zero) {
+    memset(&layer[i], 0, (part->m_end - i) * sizeof(real));
+    return NULL;
+  }
+
+  /* element `k' of the matrix uses the state after `k + 1' steps;
+     interleaved lanes jump INIT_LANES steps at a time, so that their
+     updates are independent of each other */
+  unsigned long long lanes[INIT_LANES], mult, inc;
+  lcg_jump(INIT_LANES, &mult, &inc);
+  for (j = 0; j < INIT_LANES; ++j)
+    lanes[j] = lcg_skip(part->m_seed, i + j + 1);
+  for (; i + INIT_LANES <= part->m_end; i += INIT_LANES) {
+    for (j = 0; j < INIT_LANES; ++j) {
+      layer[i + j] = (((lanes[j] & 0xFFFF) / (real)65536) - 0.5) / layer1_size;
+      lanes[j] = lanes[j] * mult + inc;
+    }
+  }
+  for (j = 0; i < part->m_end; ++i, ++j)
+    layer[i] = (((lanes[j] & 0xFFFF) / (real)65536) - 0.5) / layer1_size;
+  return NULL;
+}
+
+/* fill `a_n' elements of a matrix with the same random values as a
+   serial loop starting at `*a_next_random' (which is advanced past
+   them), or with zeros if `a_next_random' is NULL */
+static void init_layer_values(real *a_layer, long long a_n,
+                              long long a_layer1_size,
+                              unsigned long long *a_next_random,
+                              int a_n_threads) {
+  long long n_parts = a_n / INIT_MIN_PART, t;
+  if (n_parts > a_n_threads)
+    n_parts = a_n_threads;
+  if (n_parts < 1)
+    n_parts = 1;
+
+  init_part_t *parts = (init_part_t *) malloc(n_parts * sizeof(init_part_t));
+  pthread_t *pt = (pthread_t *) malloc(n_parts * sizeof(pthread_t));
+  if (parts == NULL || pt == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  for (t = 0; t < n_parts; ++t) {
+    parts[t].m_layer = a_layer;
+    parts[t].m_start = a_n * t / n_parts;
+    parts[t].m_end = a_n * (t + 1) / n_parts;
+    parts[t].m_layer1_size = a_layer1_size;
+    parts[t].m_seed = a_next_random? *a_next_random: 0;
+    parts[t].m_zero = a_next_random == NULL;
+  }
+  for (t = 1; t < n_parts; ++t)
+    pthread_create(&pt[t], NULL, init_part_thread, (void *) &parts[t]);
+  init_part_thread(&parts[0]);
+  for (t = 1; t < n_parts; ++t)
+    pthread_join(pt[t], NULL);
+
+  if (a_next_random)
+    *a_next_random = lcg_skip(*a_next_random, a_n);
+  free(parts);
+  free(pt);
+}
+
 static void init_ts_nnet(nnet_t *a_nnet, const vocab_t *a_vocab,
-                         const opt_t *a_opts, const multiclass_t *a_multiclass) {
+                         const opt_t *a_opts, const multiclass_t *a_multiclass,
+                         const topology_t *a_topology) {
   unsigned long long next_random = 1;
   long long layer1_size = a_opts->m_layer1_size;
   long long vocab_size = a_vocab->m_vocab_size;
@@ -159,17 +552,13 @@ static void init_ts_nnet(nnet_t *a_nnet, const vocab_t *a_vocab,
     fprintf(stderr, "Could not allocate memory for m_vec2task.\n");
     exit(8);
   }
-  long long a, n;
-  real *v2t_layer;
+  long long n;
   size_t i;
   for (i = 0; i < a_nnet->m_n_tasks; ++i) {
     n = a_multiclass->m_classes[i] * layer1_size;
     init_mtx((void **) &a_nnet->m_vec2task[i], n * sizeof(real));
-    v2t_layer = a_nnet->m_vec2task[i];
-    for (a = 0; a < n; ++a) {
-      next_random = next_random * (unsigned long long)25214903917 + 11;
-      v2t_layer[a] = (((next_random & 0xFFFF) / (real)65536) - 0.5) / layer1_size;
-    }
+    init_layer_values(a_nnet->m_vec2task[i], n, layer1_size, &next_random,
+                      a_opts->m_num_threads);
   }
 
   /* initialize array for storing task-specific embeddings */
@@ -189,78 +578,77 @@ static void init_ts_nnet(nnet_t *a_nnet, const vocab_t *a_vocab,
   }
 
   if (layer_address) {
-    init_mtx(layer_address,
-	     vocab_size * layer1_size * sizeof(real));
-    real *layer = (real *) (*layer_address);
-    long long b;
-    for (a = 0; a < vocab_size; ++a) {
-      for (b = 0; b < layer1_size; ++b) {
-        next_random = next_random * (unsigned long long)25214903917 + 11;
-        layer[a * layer1_size + b] = (((next_random & 0xFFFF)
-                                       / (real)65536) - 0.5) / layer1_size;
-      }
-    }
+    init_layer(layer_address, vocab_size * layer1_size * sizeof(real),
+               a_opts, a_topology);
+    init_layer_values((real *) (*layer_address), vocab_size * layer1_size,
+                      layer1_size, &next_random, a_opts->m_num_threads);
   }
 }
 
-static void init_w2v_nnet(nnet_t *a_nnet, const vocab_t *a_vocab, const opt_t *a_opts) {
-  long long a, b;
+static void init_w2v_nnet(nnet_t *a_nnet, const vocab_t *a_vocab,
+                          const opt_t *a_opts, const topology_t *a_topology) {
   unsigned long long next_random = 1;
   long long vocab_size = a_vocab->m_vocab_size;
   long long layer1_size = a_opts->m_layer1_size;
-  init_mtx((void **) &a_nnet->m_syn0, vocab_size * layer1_size * sizeof(real));
+  int placement_failed = init_layer((void **) &a_nnet->m_syn0,
+                                    vocab_size * layer1_size * sizeof(real),
+                                    a_opts, a_topology);
 
   if (a_opts->m_hs) {
-    init_mtx((void **) &a_nnet->m_syn1,
-	     vocab_size * layer1_size * sizeof(real));
-    for (a = 0; a < vocab_size; ++a)
-      for (b = 0; b < layer1_size; ++b)
-        a_nnet->m_syn1[a * layer1_size + b] = 0;
+    placement_failed |= init_layer((void **) &a_nnet->m_syn1,
+                                   vocab_size * layer1_size * sizeof(real),
+                                   a_opts, a_topology);
+    init_layer_values(a_nnet->m_syn1, vocab_size * layer1_size, layer1_size,
+                      NULL, a_opts->m_num_threads);
   }
   if (a_opts->m_negative > 0) {
-    init_mtx((void **) &a_nnet->m_syn1neg,
-	     vocab_size * layer1_size * sizeof(real));
-    for (a = 0; a < vocab_size; ++a)
-      for (b = 0; b < layer1_size; ++b)
-        a_nnet->m_syn1neg[a * layer1_size + b] = 0;
-  }
-
-  for (a = 0; a < vocab_size; ++a) {
-    for (b = 0; b < layer1_size; ++b) {
-      next_random = next_random * (unsigned long long)25214903917 + 11;
-      a_nnet->m_syn0[a * layer1_size + b] = (((next_random & 0xFFFF)
-                                              / (real)65536) - 0.5) / layer1_size;
-    }
+    placement_failed |= init_layer((void **) &a_nnet->m_syn1neg,
+                                   vocab_size * layer1_size * sizeof(real),
+                                   a_opts, a_topology);
+    init_layer_values(a_nnet->m_syn1neg, vocab_size * layer1_size,
+                      layer1_size, NULL, a_opts->m_num_threads);
   }
+
+  init_layer_values(a_nnet->m_syn0, vocab_size * layer1_size, layer1_size,
+                    &next_random, a_opts->m_num_threads);
+  if (placement_failed)
+    fprintf(stderr, "WARNING: could not set NUMA placement of model matrices,"
+            " using first-touch placement instead\n");
 }
 
 static void init_nnet(nnet_t *a_nnet, vocab_t *a_vocab,
-                     const opt_t *a_opts, const multiclass_t *a_multiclass) {
+                      const opt_t *a_opts, const multiclass_t *a_multiclass,
+                      const topology_t *a_topology) {
   reset_nnet(a_nnet);
   if (a_opts->m_ts > 0 || a_opts->m_ts_w2v > 0 || a_opts->m_ts_least_sq > 0)
-    init_ts_nnet(a_nnet, a_vocab, a_opts, a_multiclass);
+    init_ts_nnet(a_nnet, a_vocab, a_opts, a_multiclass, a_topology);
 
   if (a_opts->m_ts <= 0)
-    init_w2v_nnet(a_nnet, a_vocab, a_opts);
+    init_w2v_nnet(a_nnet, a_vocab, a_opts, a_topology);
 }
 
-static real train_w2v(const opt_t *w2v_opts,
-                      const vw_t *vocab, const long long vocab_size,
-                      const real *exp_table, const int *table,
+static real train_w2v(const opt_t *w2v_opts, const vocab_t *a_vocab,
+                      const sigmoid_t *sigmoid, const sampler_t *sampler,
+                      negatives_t *negatives,
                       const int window, const long long layer1_size,
                       nnet_t *nnet, long long sen[], long long word,
                       real *neu1, real *neu1e,
                       long long sentence_length,
                       long long sentence_position,
-                      unsigned long long *next_random) {
+                      unsigned long long *next_random, sync_t *sync) {
   real f, g, total_cost = 0;
   long long a, b, c, cw, d, last_word, label, l1, l2, target;
+  const vw_t *vocab = a_vocab->m_vocab;
+  /* Huffman code and inner nodes of the predicted word */
+  const char *code = NULL;
+  const int *point = NULL;
+  if (w2v_opts->m_hs) {
+    code = &a_vocab->m_codes[vocab[word].code_offset];
+    point = &a_vocab->m_points[vocab[word].code_offset];
+  }
 
-  for (c = 0; c < layer1_size; ++c)
-    neu1[c] = 0;
-
-  for (c = 0; c < layer1_size; ++c)
-    neu1e[c] = 0;
+  memset(neu1, 0, layer1_size * sizeof(real));
+  memset(neu1e, 0, layer1_size * sizeof(real));
 
   *next_random = (*next_random) * (unsigned long long)25214903917 + 11;
   b = (*next_random) % window;
@@ -281,43 +669,42 @@ static real train_w2v(const opt_t *w2v_opts,
         if (last_word == -1)
           continue;
 
-        for (c = 0; c < layer1_size; ++c) {
-          neu1[c] += nnet->m_syn0[c + last_word * layer1_size];
-        }
+        vec_axpy(1, &nnet->m_syn0[last_word * layer1_size], neu1, layer1_size);
         ++cw;
       }
     }
     if (cw) {
-      for (c = 0; c < layer1_size; ++c)
-        neu1[c] /= cw;
+      if (w2v_opts->m_negative > 0) {
+        draw_negatives(negatives, sampler, w2v_opts->m_negative, word,
+                       next_random);
+        prefetch_negatives(negatives, nnet->m_syn1neg, layer1_size);
+      }
+      vec_scale(1. / cw, neu1, layer1_size);
 
       if (w2v_opts->m_hs) {
         for (d = 0; d < vocab[word].codelen; ++d) {
-          f = 0;
-          l2 = vocab[word].point[d] * layer1_size;
+          l2 = point[d] * layer1_size;
           // Propagate hidden -> output
-          pthread_mutex_lock(&tlock);
-          for (c = 0; c < layer1_size; ++c)
-            f += neu1[c] * nnet->m_syn1[c + l2];
+          sync_lock(sync, SYNC_KEY(SYNC_SYN1, point[d]),
+                    SYNC_NO_KEY);
+          f = vec_dot(neu1, &nnet->m_syn1[l2], layer1_size);
 
-          if (f <= -MAX_EXP || f >= MAX_EXP)
+          if (f <= -MAX_EXP || f >= MAX_EXP) {
+            sync_unlock(sync, SYNC_KEY(SYNC_SYN1, point[d]),
+                        SYNC_NO_KEY);
             continue;
-          else
-            f = exp_table[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
+          } else
+            f = sigmoid_eval(sigmoid, f);
 
           // 'g' is the gradient multiplied by the learning rate
-          g = (1 - vocab[word].code[d] - f);
+          g = (1 - code[d] - f);
           total_cost += g;
           g *= w2v_opts->m_alpha;
-          // Propagate errors output -> hidden
-          for (c = 0; c < layer1_size; ++c) {
-            neu1e[c] += g * nnet->m_syn1[c + l2];
-          }
-          // Learn weights hidden -> output
-          for (c = 0; c < layer1_size; ++c) {
-            nnet->m_syn1[c + l2] += g * neu1[c];
-          }
-          pthread_mutex_unlock(&tlock);
+          // Propagate errors output -> hidden and learn weights
+          // hidden -> output
+          vec_axpy2(g, neu1, &nnet->m_syn1[l2], neu1e, layer1_size);
+          sync_unlock(sync, SYNC_KEY(SYNC_SYN1, point[d]),
+                      SYNC_NO_KEY);
         }
       }
       // NEGATIVE SAMPLING
@@ -327,35 +714,24 @@ static real train_w2v(const opt_t *w2v_opts,
             target = word;
             label = 1;
           } else {
-            *next_random = (*next_random) * (unsigned long long)25214903917 + 11;
-            target = table[((*next_random) >> 16) % TABLE_SIZE];
-            if (target == 0) target = (*next_random) % (vocab_size - 1) + 1;
+            target = next_negative(negatives, nnet->m_syn1neg, layer1_size);
             if (target == word) continue;
             label = 0;
           }
           l2 = target * layer1_size;
-          f = 0;
-          pthread_mutex_lock(&tlock);
-          for (c = 0; c < layer1_size; ++c) {
-            f += neu1[c] * nnet->m_syn1neg[c + l2];
-          }
+          sync_lock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
+          f = vec_dot(neu1, &nnet->m_syn1neg[l2], layer1_size);
           if (f > MAX_EXP) {
             g = (label - 1) * w2v_opts->m_alpha;
           } else if (f < -MAX_EXP) {
             g = (label - 0) * w2v_opts->m_alpha;
           } else {
-            g = (label - exp_table[(int)((f + MAX_EXP)
-                                         * (EXP_TABLE_SIZE / MAX_EXP / 2))]);
+            g = (label - sigmoid_eval(sigmoid, f));
             total_cost += g;
             g *= w2v_opts->m_alpha;
           }
-          for (c = 0; c < layer1_size; ++c) {
-            neu1e[c] += g * nnet->m_syn1neg[c + l2];
-          }
-          for (c = 0; c < layer1_size; ++c) {
-            nnet->m_syn1neg[c + l2] += g * neu1[c];
-          }
-          pthread_mutex_unlock(&tlock);
+          vec_axpy2(g, neu1, &nnet->m_syn1neg[l2], neu1e, layer1_size);
+          sync_unlock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
         }
       // hidden -> in
       for (a = b; a < window * 2 + 1 - b; ++a) {
@@ -371,15 +747,26 @@ static real train_w2v(const opt_t *w2v_opts,
           if (last_word == -1)
             continue;
 
-          pthread_mutex_lock(&tlock);
-          for (c = 0; c < layer1_size; ++c) {
-            nnet->m_syn0[c + last_word * layer1_size] += neu1e[c];
-          }
-          pthread_mutex_unlock(&tlock);
+          sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+          vec_axpy(1, neu1e, &nnet->m_syn0[last_word * layer1_size],
+                   layer1_size);
+          sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
         }
       }
     }
   } else {  //train skip-gram
+    if (w2v_opts->m_negative > 0) {
+      /* draw negative examples of all context words at once */
+      cw = 0;
+      for (a = b; a < window * 2 + 1 - b; ++a) {
+        c = sentence_position - window + a;
+        if (a != window && c >= 0 && c < sentence_length && sen[c] != -1)
+          ++cw;
+      }
+      draw_negatives(negatives, sampler, cw * w2v_opts->m_negative, word,
+                     next_random);
+      prefetch_negatives(negatives, nnet->m_syn1neg, layer1_size);
+    }
     for (a = b; a < window * 2 + 1 - b; ++a) {
       if (a != window) {
         c = sentence_position - window + a;
@@ -388,33 +775,32 @@ static real train_w2v(const opt_t *w2v_opts,
         last_word = sen[c];
         if (last_word == -1) continue;
         l1 = last_word * layer1_size;
-        for (c = 0; c < layer1_size; ++c)
-          neu1e[c] = 0;
+        memset(neu1e, 0, layer1_size * sizeof(real));
         // HIERARCHICAL SOFTMAX
         if (w2v_opts->m_hs) for (d = 0; d < vocab[word].codelen; ++d) {
-            f = 0;
-            l2 = vocab[word].point[d] * layer1_size;
+            l2 = point[d] * layer1_size;
             // Propagate hidden -> output
-            pthread_mutex_lock(&tlock);
-            for (c = 0; c < layer1_size; c++)
-              f += nnet->m_syn0[c + l1] * nnet->m_syn1[c + l2];
+            sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word),
+                      SYNC_KEY(SYNC_SYN1, point[d]));
+            f = vec_dot(&nnet->m_syn0[l1], &nnet->m_syn1[l2], layer1_size);
 
-            if (f <= -MAX_EXP || f >= MAX_EXP)
+            if (f <= -MAX_EXP || f >= MAX_EXP) {
+              sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word),
+                          SYNC_KEY(SYNC_SYN1, point[d]));
               continue;
-            else
-              f = exp_table[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
+            } else
+              f = sigmoid_eval(sigmoid, f);
 
             // 'g' is the gradient multiplied by the learning rate
-            g = (1 - vocab[word].code[d] - f);
+            g = (1 - code[d] - f);
             total_cost += g;
             g *= w2v_opts->m_alpha;
-            // Propagate errors output -> hidden
-            for (c = 0; c < layer1_size; ++c) neu1e[c] += g * nnet->m_syn1[c + l2];
-            // Learn weights hidden -> output
-            for (c = 0; c < layer1_size; ++c) {
-              nnet->m_syn1[c + l2] += g * nnet->m_syn0[c + l1];
-            }
-            pthread_mutex_unlock(&tlock);
+            // Propagate errors output -> hidden and learn weights
+            // hidden -> output
+            vec_axpy2(g, &nnet->m_syn0[l1], &nnet->m_syn1[l2], neu1e,
+                      layer1_size);
+            sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word),
+                        SYNC_KEY(SYNC_SYN1, point[d]));
           }
         // NEGATIVE SAMPLING
         if (w2v_opts->m_negative > 0)
@@ -423,17 +809,14 @@ static real train_w2v(const opt_t *w2v_opts,
               target = word;
               label = 1;
             } else {
-              (*next_random) = (*next_random) * (unsigned long long)25214903917 + 11;
-              target = table[(*next_random >> 16) % TABLE_SIZE];
-              if (target == 0) target = (*next_random) % (vocab_size - 1) + 1;
+              target = next_negative(negatives, nnet->m_syn1neg, layer1_size);
               if (target == word) continue;
               label = 0;
             }
             l2 = target * layer1_size;
-            f = 0;
-            pthread_mutex_lock(&tlock);
-            for (c = 0; c < layer1_size; ++c)
-              f += nnet->m_syn0[c + l1] * nnet->m_syn1neg[c + l2];
+            sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word),
+                      SYNC_KEY(SYNC_SYN1NEG, target));
+            f = vec_dot(&nnet->m_syn0[l1], &nnet->m_syn1neg[l2], layer1_size);
 
             total_cost += f;
             if (f > MAX_EXP)
@@ -441,72 +824,168 @@ static real train_w2v(const opt_t *w2v_opts,
             else if (f < -MAX_EXP)
               g = (label - 0) * w2v_opts->m_alpha;
             else
-              g = (label - exp_table[(int)((f + MAX_EXP)
-                                           * (EXP_TABLE_SIZE / MAX_EXP / 2))])
-                  * w2v_opts->m_alpha;
+              g = (label - sigmoid_eval(sigmoid, f)) * w2v_opts->m_alpha;
 
-            for (c = 0; c < layer1_size; ++c)
-              neu1e[c] += g * nnet->m_syn1neg[c + l2];
-
-            for (c = 0; c < layer1_size; ++c) {
-              nnet->m_syn1neg[c + l2] += g * nnet->m_syn0[c + l1];
-            }
-            pthread_mutex_unlock(&tlock);
+            vec_axpy2(g, &nnet->m_syn0[l1], &nnet->m_syn1neg[l2], neu1e,
+                      layer1_size);
+            sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word),
+                        SYNC_KEY(SYNC_SYN1NEG, target));
           }
         // Learn weights input -> hidden
-        pthread_mutex_lock(&tlock);
-        for (c = 0; c < layer1_size; ++c) {
-          nnet->m_syn0[c + l1] += neu1e[c];
-        }
-        pthread_mutex_unlock(&tlock);
+        sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+        vec_axpy(1, neu1e, &nnet->m_syn0[l1], layer1_size);
+        sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
       }
     }
   }
   return total_cost;
 }
 
+/* Skip-gram with negative sampling, where all context words of the
+   window share the same set of negative samples, so that the
+   forward and backward passes become three small matrix-matrix
+   products (the pSGNScc scheme of Ji et al., 2016). */
+static real train_w2v_batch(const opt_t *w2v_opts, const sigmoid_t *sigmoid,
+                            const sampler_t *sampler, negatives_t *negatives,
+                            const int window, const long long layer1_size,
+                            nnet_t *nnet, long long sen[], long long word,
+                            sgns_batch_t *batch,
+                            long long sentence_length,
+                            long long sentence_position,
+                            unsigned long long *next_random, sync_t *sync) {
+  real f, total_cost = 0;
+  long long a, b, c, d, last_word, target;
+  long long n_inputs = 0, n_outputs = 0;
+
+  *next_random = (*next_random) * (unsigned long long)25214903917 + 11;
+  b = (*next_random) % window;
+  /* gather context words */
+  for (a = b; a < window * 2 + 1 - b; ++a) {
+    if (a == window)
+      continue;
+
+    c = sentence_position - window + a;
+    if (c < 0 || c >= sentence_length)
+      continue;
+
+    last_word = sen[c];
+    if (last_word == -1)
+      continue;
+
+    /* rows are copied under the same locks as their updates */
+    sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+    memcpy(&batch->m_in[n_inputs * layer1_size],
+           &nnet->m_syn0[last_word * layer1_size], layer1_size * sizeof(real));
+    sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+    batch->m_inputs[n_inputs++] = last_word;
+  }
+  if (n_inputs == 0)
+    return total_cost;
+
+  /* gather target word and shared negative samples */
+  draw_negatives(negatives, sampler, w2v_opts->m_negative, word, next_random);
+  prefetch_negatives(negatives, nnet->m_syn1neg, layer1_size);
+  for (d = 0; d < w2v_opts->m_negative + 1; ++d) {
+    if (d == 0) {
+      target = word;
+    } else {
+      target = next_negative(negatives, nnet->m_syn1neg, layer1_size);
+      if (target == word) continue;
+    }
+    sync_lock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
+    memcpy(&batch->m_out[n_outputs * layer1_size],
+           &nnet->m_syn1neg[target * layer1_size], layer1_size * sizeof(real));
+    sync_unlock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
+    batch->m_outputs[n_outputs++] = target;
+  }
+
+  /* scores: grad = in * out^T */
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans,
+              n_inputs, n_outputs, layer1_size,
+              1., batch->m_in, layer1_size, batch->m_out, layer1_size,
+              0., batch->m_grad, n_outputs);
+  /* turn scores into gradients multiplied by the learning rate (the
+     first output is the positive example) */
+  for (a = 0; a < n_inputs * n_outputs; ++a)
+    total_cost += batch->m_grad[a];
+  sigmoid_batch(sigmoid, batch->m_grad, batch->m_grad, n_inputs * n_outputs);
+  for (a = 0; a < n_inputs; ++a) {
+    for (d = 0; d < n_outputs; ++d) {
+      f = (d == 0) - batch->m_grad[a * n_outputs + d];
+      batch->m_grad[a * n_outputs + d] = f * w2v_opts->m_alpha;
+    }
+  }
+  /* input updates: in_upd = grad * out */
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+              n_inputs, layer1_size, n_outputs,
+              1., batch->m_grad, n_outputs, batch->m_out, layer1_size,
+              0., batch->m_in_upd, layer1_size);
+  /* output updates: out_upd = grad^T * in */
+  cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans,
+              n_outputs, layer1_size, n_inputs,
+              1., batch->m_grad, n_outputs, batch->m_in, layer1_size,
+              0., batch->m_out_upd, layer1_size);
+
+  /* scatter updates back to the model */
+  real *row, *upd;
+  for (d = 0; d < n_outputs; ++d) {
+    target = batch->m_outputs[d];
+    row = &nnet->m_syn1neg[target * layer1_size];
+    upd = &batch->m_out_upd[d * layer1_size];
+    sync_lock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
+    vec_axpy(1, upd, row, layer1_size);
+    sync_unlock(sync, SYNC_KEY(SYNC_SYN1NEG, target), SYNC_NO_KEY);
+  }
+  for (a = 0; a < n_inputs; ++a) {
+    last_word = batch->m_inputs[a];
+    row = &nnet->m_syn0[last_word * layer1_size];
+    upd = &batch->m_in_upd[a * layer1_size];
+    sync_lock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+    vec_axpy(1, upd, row, layer1_size);
+    sync_unlock(sync, SYNC_KEY(SYNC_SYN0, last_word), SYNC_NO_KEY);
+  }
+  return total_cost;
+}
+
 static real train_ts(const multiclass_t  *multiclass, long long word,
                      const real alpha, const int active_tasks,
-                     const long long layer1_size, const real *exp_table,
-                     nnet_t *nnet, real *embeddings) {
-  real f, g, emb_orig, total_cost = 0;
+                     const long long layer1_size, const sigmoid_t *sigmoid,
+                     nnet_t *nnet, real *embeddings,
+                     const sync_layer_t emb_layer, sync_t *sync) {
+  real f, g, total_cost = 0;
   long long l2, w_idx = word * layer1_size;
   real *label_weights = NULL;
   size_t i;
-  int label, j = 0, c = 0;
+  int label, j = 0;
   for (i = 0; i < multiclass->m_n_tasks && j < active_tasks; ++i) {
     label = multiclass->m_classes[i];
     if (label >= 0) {
       ++j;
-      f = 0;
-
       label_weights = nnet->m_vec2task[i];
       l2 = label * layer1_size;
-      pthread_mutex_lock(&tlock);
+      sync_lock(sync, SYNC_KEY(emb_layer, word),
+                SYNC_KEY(SYNC_VEC2TASK + i, label));
       /* compute decision */
-      for (c = 0; c < layer1_size; ++c)
-        f += embeddings[c + w_idx]  * label_weights[l2 + c];
+      f = vec_dot(&embeddings[w_idx], &label_weights[l2], layer1_size);
 
       /* compute gradient */
       if (f > MAX_EXP) {
         /* for maximum scores, do nothing */
-        pthread_mutex_unlock(&tlock);
+        sync_unlock(sync, SYNC_KEY(emb_layer, word),
+                    SYNC_KEY(SYNC_VEC2TASK + i, label));
         continue;
       } else {
         if (f < -MAX_EXP)
           f = -MAX_EXP;
 
-        g = exp_table[(int)((f + MAX_EXP)
-                            * (EXP_TABLE_SIZE / MAX_EXP / 2))];
+        g = sigmoid_eval(sigmoid, f);
         total_cost += 1 - g;
         g *= alpha;
         /* propagate gradient to word embeddings and task-specific coefficients */
-        for (c = 0; c < layer1_size; ++c) {
-          emb_orig = embeddings[c + w_idx];
-          embeddings[c + w_idx] += g * label_weights[l2 + c];
-          label_weights[l2 + c] += g * emb_orig;
-        }
-        pthread_mutex_unlock(&tlock);
+        vec_axpy2(g, &embeddings[w_idx], &label_weights[l2],
+                  &embeddings[w_idx], layer1_size);
+        sync_unlock(sync, SYNC_KEY(emb_layer, word),
+                    SYNC_KEY(SYNC_VEC2TASK + i, label));
       }
     }
   }
@@ -617,16 +1096,236 @@ static void finalize_least_sq(long long a_vocab_size, long long a_layer_size,
   free(w2v2ts);
 }
 
+static void input_open(input_t *a_input, const thread_opts_t *a_thread_opts) {
+  const opt_t *w2v_opts = a_thread_opts->m_w2v_opts;
+  const long long thread_id = a_thread_opts->m_thread_id;
+  const long long num_threads = w2v_opts->m_num_threads;
+
+  a_input->m_corpus = a_thread_opts->m_corpus;
+  a_input->m_start = a_input->m_start_line = 0;
+  a_input->m_scheduler = a_thread_opts->m_scheduler;
+  a_input->m_stream = a_thread_opts->m_stream;
+  a_input->m_thread_id = thread_id;
+  a_input->m_epoch = a_input->m_end = 0;
+  if (a_input->m_stream) {
+    /* batches are taken on the first read */
+    a_input->m_corpus = NULL;
+  } else if (a_input->m_scheduler) {
+    /* chunks are taken on the first read */
+    if (a_input->m_corpus == NULL
+        && open_reader(&a_input->m_reader, w2v_opts->m_train_file, 0)) {
+      fprintf(stderr, "ERROR: training data file not found!\n");
+      exit(EXIT_FAILURE);
+    }
+  } else if (a_input->m_corpus) {
+    /* start at the beginning of the line containing the thread's share */
+    a_input->m_start_line = corpus_line_of(a_input->m_corpus,
+                                           a_input->m_corpus->m_n_ids
+                                           * thread_id / num_threads);
+    a_input->m_start = a_input->m_corpus->m_lines[a_input->m_start_line];
+  } else {
+    /* proceed to the beginning of the line (or of a compressed shard) */
+    const shards_t *shards = a_thread_opts->m_shards;
+    const long long file_size = a_thread_opts->m_file_size;
+    long long offset = align_to_shard_line(shards, 1 + thread_id * file_size
+                                           / num_threads);
+    long long limit = LLONG_MAX;
+    /* several threads may start at the same shard boundary, so sharded
+       data are split into disjoint ranges that end where the next
+       thread starts */
+    if (is_sharded(shards) && thread_id + 1 < num_threads)
+      limit = align_to_shard_line(shards, 1 + (thread_id + 1) * file_size
+                                  / num_threads);
+    /* a thread without data stays at the start (the end of the data
+       might lie in a compressed shard) */
+    if (offset >= limit || offset >= shards_size(shards))
+      offset = limit = 0;
+    open_shard_reader(&a_input->m_reader, shards, offset, limit);
+    a_input->m_start = offset;
+  }
+  a_input->m_pos = a_input->m_start;
+  a_input->m_line = a_input->m_start_line;
+  a_input->m_eol = a_input->m_eof = 0;
+}
+
+static void input_close(input_t *a_input) {
+  if (a_input->m_stream) {
+    if (a_input->m_corpus)
+      release_batch(a_input->m_stream, a_input->m_corpus);
+    a_input->m_corpus = NULL;
+  } else if (a_input->m_corpus == NULL)
+    close_reader(&a_input->m_reader);
+}
+
+static void input_rewind(input_t *a_input) {
+  if (a_input->m_scheduler) {
+    /* the first chunk of the next epoch is taken on the next read */
+    ++a_input->m_epoch;
+    a_input->m_end = 0;
+    a_input->m_eol = a_input->m_eof = 0;
+    return;
+  }
+  if (a_input->m_corpus == NULL)
+    seek_reader(&a_input->m_reader, a_input->m_start);
+
+  a_input->m_pos = a_input->m_start;
+  a_input->m_line = a_input->m_start_line;
+  a_input->m_eol = a_input->m_eof = 0;
+}
+
+/* continue reading at a position recorded by input_tell() */
+static void input_seek(input_t *a_input, const progress_t *a_progress) {
+  if (a_input->m_corpus == NULL)
+    seek_reader(&a_input->m_reader, a_progress->m_pos);
+
+  a_input->m_pos = a_progress->m_pos;
+  a_input->m_line = a_progress->m_line;
+  a_input->m_eol = a_progress->m_eol;
+  a_input->m_eof = 0;
+}
+
+static void input_tell(const input_t *a_input, progress_t *a_progress) {
+  a_progress->m_pos = a_input->m_corpus? a_input->m_pos:
+                      tell_reader(&a_input->m_reader);
+  a_progress->m_line = a_input->m_line;
+  a_progress->m_eol = a_input->m_eol;
+}
+
+static int input_eof(const input_t *a_input) {
+  return a_input->m_corpus || a_input->m_scheduler || a_input->m_stream?
+         a_input->m_eof: reader_eof(&a_input->m_reader);
+}
+
+/* move to the next chunk of the current epoch, return -1 if there is
+   none */
+static int input_next_chunk(input_t *a_input, const long long a_pos) {
+  const chunk_t *chunk = next_chunk(a_input->m_scheduler, a_input->m_thread_id,
+                                    a_input->m_epoch);
+  if (chunk == NULL) {
+    a_input->m_eof = 1;
+    return -1;
+  }
+  /* consecutive chunks are read without seeking */
+  if (chunk->m_start != a_pos) {
+    if (a_input->m_corpus == NULL)
+      seek_reader(&a_input->m_reader, chunk->m_start);
+    a_input->m_line = chunk->m_line;
+  }
+  a_input->m_pos = chunk->m_start;
+  a_input->m_end = chunk->m_end;
+  return 0;
+}
+
+static long long input_read_chunked_word(input_t *a_input,
+                                         const vocab_t *a_vocab,
+                                         const int a_consume_tab) {
+  long long pos = a_input->m_corpus? a_input->m_pos:
+                  tell_reader(&a_input->m_reader);
+  /* a file which ends before the chunk does (e.g., because it was
+     truncated after the chunks had been cut) ends the chunk, too */
+  if (a_input->m_corpus == NULL && reader_eof(&a_input->m_reader))
+    pos = a_input->m_end;
+  while (pos >= a_input->m_end) {
+    if (input_next_chunk(a_input, pos))
+      return -1;
+    pos = a_input->m_pos;
+  }
+  if (a_input->m_corpus) {
+    long long word = a_input->m_corpus->m_ids[a_input->m_pos++];
+    a_input->m_eol = (word == 0);
+    if (a_input->m_eol)
+      ++a_input->m_line;
+    return word;
+  }
+  long long word = read_token_index(&a_input->m_reader, a_vocab,
+                                    a_consume_tab);
+  /* a word cut off by the end of the file is dropped, just as in the
+     static schedule */
+  return reader_eof(&a_input->m_reader)? -1: word;
+}
+
+static long long input_read_word(input_t *a_input, const vocab_t *a_vocab,
+                                 const int a_consume_tab) {
+  /* continue with the next batch of the stream */
+  while (a_input->m_stream && (a_input->m_corpus == NULL
+                               || a_input->m_pos >= a_input->m_corpus->m_n_ids)) {
+    if (a_input->m_corpus)
+      release_batch(a_input->m_stream, a_input->m_corpus);
+    a_input->m_corpus = next_batch(a_input->m_stream);
+    a_input->m_pos = a_input->m_line = 0;
+    if (a_input->m_corpus == NULL) {
+      a_input->m_eof = 1;
+      return -1;
+    }
+  }
+  if (a_input->m_scheduler)
+    return input_read_chunked_word(a_input, a_vocab, a_consume_tab);
+
+  if (a_input->m_corpus == NULL)
+    return read_token_index(&a_input->m_reader, a_vocab, a_consume_tab);
+
+  if (a_input->m_pos >= a_input->m_corpus->m_n_ids) {
+    a_input->m_eof = 1;
+    return -1;
+  }
+  long long word = a_input->m_corpus->m_ids[a_input->m_pos++];
+  a_input->m_eol = (word == 0);
+  if (a_input->m_eol)
+    ++a_input->m_line;
+  return word;
+}
+
+static int input_read_tags(input_t *a_input, multiclass_t *a_multiclass) {
+  /* the reader may be positioned anywhere after the last chunk, and
+     no batch is left at the end of a stream */
+  if ((a_input->m_scheduler || a_input->m_stream) && a_input->m_eof)
+    return 0;
+
+  if (a_input->m_corpus == NULL)
+    return read_token_tags(&a_input->m_reader, a_multiclass);
+
+  /* the labels belong to the line which has just been finished */
+  long long line = a_input->m_eol? a_input->m_line - 1: a_input->m_line;
+  if (a_input->m_eof || line >= a_input->m_corpus->m_n_lines)
+    return 0;
+
+  const long long n_tasks = a_input->m_corpus->m_n_tasks;
+  const int32_t *tags = &a_input->m_corpus->m_tags[line * n_tasks];
+  int active_tasks = 0;
+  long long i;
+  for (i = 0; i < n_tasks; ++i) {
+    a_multiclass->m_classes[i] = tags[i];
+    if (tags[i] >= 0)
+      ++active_tasks;
+  }
+  return active_tasks;
+}
+
+/* make the current position of a thread available to checkpoints */
+static void publish_thread_progress(const thread_opts_t *a_thread_opts,
+                                    const input_t *a_input,
+                                    const long long a_local_iter,
+                                    const long long a_word_count,
+                                    const long long a_word_count_actual,
+                                    const unsigned long long a_next_random) {
+  progress_t progress;
+  progress.m_local_iter = a_local_iter;
+  progress.m_word_count = a_word_count;
+  progress.m_word_count_actual = a_word_count_actual;
+  progress.m_next_random = a_next_random;
+  progress.m_alpha = a_thread_opts->m_alpha;
+  input_tell(a_input, &progress);
+  publish_progress(a_thread_opts->m_checkpointer, a_thread_opts->m_thread_id,
+                   &progress);
+}
+
 static void *train_model_thread(void *a_opts) {
   real total_cost = 0;
   thread_opts_t *thread_opts = (thread_opts_t *) a_opts;
-  const long long file_size = thread_opts->m_file_size;
   nnet_t *nnet = thread_opts->m_nnet;
-  const real *exp_table = thread_opts->m_exp_table;
-  const int *table = thread_opts->m_ugram_table;
+  const sigmoid_t *sigmoid = thread_opts->m_sigmoid;
+  const sampler_t *sampler = thread_opts->m_sampler;
   const vw_t *vocab = thread_opts->m_vocab->m_vocab;
-  const int *vocab_hash = thread_opts->m_vocab->m_vocab_hash;
-  const long long vocab_size = thread_opts->m_vocab->m_vocab_size;
   const long long train_words = thread_opts->m_vocab->m_train_words;
 
   const opt_t *w2v_opts = thread_opts->m_w2v_opts;
@@ -640,53 +1339,87 @@ static void *train_model_thread(void *a_opts) {
 
   real *neu1 = (real *)calloc(layer1_size, sizeof(real));
   real *neu1e = (real *)calloc(layer1_size, sizeof(real));
+  sgns_batch_t batch;
+  if (w2v_opts->m_minibatch > 0)
+    init_sgns_batch(&batch, window, w2v_opts->m_negative, layer1_size);
+  negatives_t negatives;
+  init_negatives(&negatives, 2 * window * w2v_opts->m_negative);
 
   int active_tasks = 0;
   multiclass_t multiclass;
   reset_multiclass(&multiclass);
   multiclass.m_n_tasks = thread_opts->m_n_tasks;
   long long word, sentence_length = 0, sentence_position = 0;
-  long long word_count_actual = 0;
+  long long word_count_actual = 0, progress_words = 0, start_words = 0;
   long long word_count = 0, last_word_count = 0, sen[MAX_SENTENCE_LENGTH + 1];
   long long local_iter = w2v_opts->m_iter;
   unsigned long long next_random = thread_id;
   clock_t now;
 
-  FILE *fi = fopen(w2v_opts->m_train_file, "rb");
-  long offset = 1 + (long long) next_random * file_size / (long long) num_threads;
-  /* proceed to the beginning of the line */
-  do {
-    fseek(fi, --offset, SEEK_SET);
-  } while (offset > 0 && fgetc(fi) != '\n');
-
-  if (offset > 0)
-    ++offset;
+  if (thread_opts->m_topology
+      && pin_thread(thread_opts->m_topology, thread_id) < 0
+      && w2v_opts->m_debug_mode > 0)
+    fprintf(stderr, "WARNING: could not pin thread %lld\n", thread_id);
+
+  input_t input;
+  input_open(&input, thread_opts);
+  /* a stream is read only once; to train for several epochs, the data
+     are streamed `-iter' times (see open_stream()) */
+  if (thread_opts->m_stream)
+    local_iter = 1;
+  const progress_t *resume = thread_opts->m_resume;
+  if (resume && resume->m_local_iter >= 0) {
+    local_iter = resume->m_local_iter;
+    word_count = last_word_count = resume->m_word_count;
+    word_count_actual = start_words = resume->m_word_count_actual;
+    next_random = resume->m_next_random;
+    thread_opts->m_alpha = resume->m_alpha;
+    input_seek(&input, resume);
+  }
 
-  while (1) {
+  while (local_iter > 0) {
     if (word_count - last_word_count > 10000) {
       word_count_actual += word_count - last_word_count;
+      /* if threads process different numbers of words, the learning
+         rate follows the average progress of all threads */
+      progress_words = thread_opts->m_shared_words?
+          __atomic_add_fetch(thread_opts->m_shared_words,
+                             word_count - last_word_count,
+                             __ATOMIC_RELAXED) / num_threads:
+          word_count_actual;
       last_word_count = word_count;
       if ((w2v_opts->m_debug_mode > 1)) {
         now = clock();
         fprintf(stderr,
                 "%cAlpha: %f  Progress: %.2f%%  Words/thread/sec: %.2fk  ", 13,
                 thread_opts->m_alpha,
-                word_count_actual / (real)(w2v_opts->m_iter * train_words + 1) * 100,
+                progress_words / (real)(w2v_opts->m_iter * train_words + 1) * 100,
                 word_count_actual / ((real)(now - thread_opts->m_start + 1)
                                      / (real) CLOCKS_PER_SEC * 1000));
         fflush(stderr);
       }
       thread_opts->m_alpha = thread_opts->m_starting_alpha              \
-                             * (1 - word_count_actual /                 \
+                             * (1 - progress_words /                    \
                                 (real)(w2v_opts->m_iter * train_words + 1));
       if (thread_opts->m_alpha < thread_opts->m_starting_alpha * 0.0001)
         thread_opts->m_alpha = thread_opts->m_starting_alpha * 0.0001;
     }
 
     if (sentence_length == 0) {
+      if (thread_opts->m_checkpointer)
+        publish_thread_progress(thread_opts, &input, local_iter, word_count,
+                                word_count_actual + word_count
+                                - last_word_count, next_random);
+      /* the published position becomes the final checkpoint */
+      if (w2v_opts->m_stop_after > 0
+          && word_count_actual + word_count - last_word_count - start_words
+          >= w2v_opts->m_stop_after) {
+        word_count_actual += word_count - last_word_count;
+        break;
+      }
       while (1) {
-        word = read_word_index(fi, vocab, vocab_hash, consume_tab);
-        if (feof(fi))
+        word = input_read_word(&input, thread_opts->m_vocab, consume_tab);
+        if (input_eof(&input))
           break;
 
         if (word == -1)
@@ -711,7 +1444,7 @@ static void *train_model_thread(void *a_opts) {
           break;
       }
       if (!consume_tab) {
-        active_tasks = read_tags(fi, &multiclass);
+        active_tasks = input_read_tags(&input, &multiclass);
         if (active_tasks < 0) {
 	  fprintf(stderr, "No active tasks found.\n");
           exit(EXIT_FAILURE);
@@ -723,9 +1456,15 @@ static void *train_model_thread(void *a_opts) {
       sentence_position = 0;
     }
 
-    if (feof(fi) || (word_count > (train_words / num_threads + 1))) {
+    if (input_eof(&input) || (thread_opts->m_shared_words == NULL
+                              && word_count > (train_words / num_threads + 1))) {
       word_count_actual += word_count - last_word_count;
       --local_iter;
+      if (thread_opts->m_shared_words)
+        __atomic_add_fetch(thread_opts->m_shared_words,
+                           word_count - last_word_count, __ATOMIC_RELAXED);
+      if (thread_opts->m_scheduler)
+        finish_epoch(thread_opts->m_scheduler, thread_id, input.m_epoch);
 
       if (local_iter == 0)
         break;
@@ -734,7 +1473,7 @@ static void *train_model_thread(void *a_opts) {
       word_count = 0;
       last_word_count = 0;
       sentence_length = 0;
-      fseek(fi, offset, SEEK_SET);
+      input_rewind(&input);
       continue;
     }
     word = sen[sentence_position];
@@ -745,20 +1484,28 @@ static void *train_model_thread(void *a_opts) {
     if (active_tasks) {
       if (w2v_opts->m_ts > 0 || w2v_opts->m_ts_w2v > 0) {
 	total_cost += train_ts(&multiclass, word, thread_opts->m_alpha,
-			       active_tasks, layer1_size, exp_table,
-			       nnet, nnet->m_syn0);
+			       active_tasks, layer1_size, sigmoid,
+			       nnet, nnet->m_syn0, SYNC_SYN0, thread_opts->m_sync);
       } else if (w2v_opts->m_ts_least_sq > 0) {
 	total_cost += train_ts(&multiclass, word, thread_opts->m_alpha,
-			       active_tasks, layer1_size, exp_table,
-			       nnet, nnet->m_ts_syn0);
+			       active_tasks, layer1_size, sigmoid,
+			       nnet, nnet->m_ts_syn0, SYNC_TS_SYN0,
+			       thread_opts->m_sync);
 	nnet->m_ts_syn0_active[word] = 1;
       }
     }
     /* train plain word2vec embeddings */
-    if (w2v_opts->m_ts <= 0) {
-      total_cost += train_w2v(w2v_opts, vocab, vocab_size, exp_table, table, window,
+    if (w2v_opts->m_ts <= 0 && w2v_opts->m_minibatch > 0) {
+      total_cost += train_w2v_batch(w2v_opts, sigmoid, sampler, &negatives,
+                                    window, layer1_size, nnet, sen, word,
+                                    &batch, sentence_length, sentence_position,
+                                    &next_random, thread_opts->m_sync);
+    } else if (w2v_opts->m_ts <= 0) {
+      total_cost += train_w2v(w2v_opts, thread_opts->m_vocab, sigmoid,
+                              sampler, &negatives, window,
                               layer1_size, nnet, sen, word, neu1, neu1e, sentence_length,
-                              sentence_position, &next_random);
+                              sentence_position, &next_random,
+                              thread_opts->m_sync);
     }
 
     ++sentence_position;
@@ -767,48 +1514,171 @@ static void *train_model_thread(void *a_opts) {
       continue;
     }
   }
-  fclose(fi);
+  if (thread_opts->m_checkpointer && local_iter == 0)
+    publish_thread_progress(thread_opts, &input, 0, word_count,
+                            word_count_actual, next_random);
+  thread_opts->m_word_count = word_count_actual;
+  thread_opts->m_negatives_drawn = negatives.m_drawn;
+  thread_opts->m_negatives_rejected = negatives.m_rejected;
+  input_close(&input);
+  free_negatives(&negatives);
   free(neu1);
   free(neu1e);
+  if (w2v_opts->m_minibatch > 0)
+    free_sgns_batch(&batch);
   pthread_exit(NULL);
 }
 
 void train_model(opt_t *a_opts) {
   fprintf(stderr, "Starting training using file '%s'\n",
           a_opts->m_train_file);
+  if (init_kernels(a_opts->m_isa)) {
+    fprintf(stderr, "Instruction set '%s' is not supported by this CPU.\n",
+            a_opts->m_isa);
+    exit(EXIT_FAILURE);
+  }
+  if (a_opts->m_debug_mode > 0)
+    fprintf(stderr, "Vector kernels: %s\n", KERNELS.m_isa);
 
   /* initialize vocabulary and exp table */
   vocab_t vocab;
   init_vocab(&vocab);
   multiclass_t multiclass;
   reset_multiclass(&multiclass);
-  size_t file_size = learn_vocab_from_trainfile(&vocab, &multiclass, a_opts);
-  real *exp_table = init_exp_table();
+  size_t file_size;
+  model_t checkpoint;
+  const checkpoint_state_t *resume = NULL;
+  if (a_opts->m_resume_file[0]) {
+    /* take the vocabulary from the checkpoint instead of recounting it */
+    resume = open_checkpoint(&checkpoint, a_opts->m_resume_file, a_opts);
+    load_model_vocab(&checkpoint, &vocab, &multiclass, a_opts->m_hs);
+    struct stat train_stat;
+    if (stat(a_opts->m_train_file, &train_stat)) {
+      fprintf(stderr, "ERROR: training data file not found!\n");
+      exit(EXIT_FAILURE);
+    }
+    file_size = train_stat.st_size;
+    if ((long long) file_size != resume->m_train_size) {
+      fprintf(stderr, "ERROR: checkpoint '%s' was written for a different "
+              "training file\n", a_opts->m_resume_file);
+      exit(EXIT_FAILURE);
+    }
+    if (a_opts->m_debug_mode > 0)
+      fprintf(stderr, "Resuming from checkpoint %lld of '%s'\n",
+              (long long) resume->m_seq, a_opts->m_resume_file);
+  } else if (a_opts->m_read_vocab_file[0]) {
+    read_vocab(&vocab, &multiclass, a_opts);
+    /* the size of streamed data is not known in advance */
+    if (has_stream_file(a_opts->m_train_file)) {
+      file_size = 0;
+    } else {
+      shards_t shards;
+      open_shards(&shards, a_opts->m_train_file);
+      file_size = shards_size(&shards);
+      free_shards(&shards);
+    }
+  } else {
+    file_size = learn_vocab_from_trainfile(&vocab, &multiclass, a_opts);
+  }
+  if (a_opts->m_save_vocab_file[0])
+    save_vocab(a_opts->m_save_vocab_file, &vocab);
+  sigmoid_t sigmoid;
+  init_sigmoid(&sigmoid, a_opts->m_sigmoid);
+  if (a_opts->m_debug_mode > 0)
+    fprintf(stderr, "Sigmoid: %s\n", sigmoid_mode2str(sigmoid.m_mode));
   nnet_t nnet;
-  init_nnet(&nnet, &vocab, a_opts, &multiclass);
-  int *ugram_table = NULL;
-  if (a_opts->m_negative > 0)
-    ugram_table = init_unigram_table(&vocab);
+  topology_t topology;
+  init_topology(&topology);
+  if (a_opts->m_debug_mode > 0)
+    output_topology(stderr, &topology, a_opts);
+  init_nnet(&nnet, &vocab, a_opts, &multiclass, &topology);
+  if (resume)
+    restore_nnet(&nnet, &checkpoint);
+  if (a_opts->m_debug_mode > 0) {
+    long long layer_size = vocab.m_vocab_size * a_opts->m_layer1_size
+                           * sizeof(real);
+    output_layer(stderr, "syn0", nnet.m_syn0, layer_size);
+    output_layer(stderr, "ts_syn0", nnet.m_ts_syn0, layer_size);
+    output_layer(stderr, "syn1", nnet.m_syn1, layer_size);
+    output_layer(stderr, "syn1neg", nnet.m_syn1neg, layer_size);
+  }
+  sampler_t sampler = {SAMPLER_TABLE, 0, NULL, NULL, NULL};
+  if (a_opts->m_negative > 0) {
+    init_sampler(&sampler, a_opts->m_sampler, &vocab, a_opts->m_sampler_power);
+    if (a_opts->m_debug_mode > 0) {
+      fprintf(stderr, "Negative sampler: %s (power %g)",
+              sampler_mode2str(sampler.m_mode), a_opts->m_sampler_power);
+      /* the alias tables should reproduce the distribution exactly */
+      if (sampler.m_mode == SAMPLER_ALIAS)
+        fprintf(stderr, "  Deviation: %.2e",
+                alias_deviation(&sampler, &vocab, a_opts->m_sampler_power));
+      fprintf(stderr, "\n");
+    }
+  }
 
+  sync_t sync;
+  corpus_t corpus;
   thread_opts_t thread_opts = {clock(), file_size,
                                a_opts->m_alpha, a_opts->m_alpha,
                                0, a_opts, &vocab, &nnet,
-                               exp_table, ugram_table, multiclass.m_n_tasks};
+                               &sigmoid, &sampler, multiclass.m_n_tasks,
+                               &sync, 0, NULL, 0, 0,
+                               a_opts->m_pin? &topology: NULL, NULL,
+                               resume? resume->m_progress: NULL, NULL, NULL,
+                               NULL, NULL};
   if (vocab.m_train_words == 0) {
     return;
   } else if (a_opts->m_num_threads > vocab.m_train_words) {
     a_opts->m_num_threads = vocab.m_train_words;
   }
+  init_sync(&sync, a_opts->m_sync, a_opts->m_sync_stripes);
+  if (a_opts->m_corpus_file[0]) {
+    open_corpus(&corpus, a_opts->m_corpus_file, a_opts, &vocab,
+                multiclass.m_n_tasks);
+    thread_opts.m_corpus = &corpus;
+  }
+  if (resume && resume->m_num_threads != a_opts->m_num_threads) {
+    fprintf(stderr, "ERROR: checkpoint '%s' was written with %lld threads\n",
+            a_opts->m_resume_file, (long long) resume->m_num_threads);
+    exit(EXIT_FAILURE);
+  }
+  long long shared_words = 0;
+  scheduler_t scheduler;
+  if (a_opts->m_schedule == SCHEDULE_STEAL) {
+    init_scheduler(&scheduler, a_opts, thread_opts.m_corpus, file_size);
+    thread_opts.m_scheduler = &scheduler;
+    thread_opts.m_shared_words = &shared_words;
+  }
+  stream_t stream;
+  shards_t shards;
+  if (thread_opts.m_corpus == NULL && is_streamed_input(a_opts)) {
+    open_stream(&stream, a_opts, &vocab, multiclass.m_n_tasks);
+    thread_opts.m_stream = &stream;
+    thread_opts.m_shared_words = &shared_words;
+  } else if (thread_opts.m_corpus == NULL) {
+    open_shards(&shards, a_opts->m_train_file);
+    thread_opts.m_shards = &shards;
+    /* threads stop at the end of their ranges instead of after their
+       share of words */
+    if (is_sharded(&shards))
+      thread_opts.m_shared_words = &shared_words;
+    if (a_opts->m_debug_mode > 0 && shards.m_n_shards > 1)
+      output_shards(stderr, &shards);
+  }
+  checkpointer_t checkpointer;
+  if (a_opts->m_checkpoint_file[0]) {
+    init_checkpointer(&checkpointer, a_opts, &vocab, &nnet, &multiclass,
+                      file_size, thread_opts.m_corpus != NULL, resume);
+    thread_opts.m_checkpointer = &checkpointer;
+    start_checkpointer(&checkpointer);
+  }
 
   thread_opts_t *ptopts = (thread_opts_t *) malloc(a_opts->m_num_threads
                                                    * sizeof(thread_opts_t));
   pthread_t *pt = (pthread_t *) malloc(a_opts->m_num_threads
                                        * sizeof(pthread_t));
-  if (pthread_mutex_init(&tlock, NULL)) {
-    fprintf(stderr, "\nmutex init failed\n");
-    exit(5);
-  }
-
+  struct timespec start, finish;
+  clock_gettime(CLOCK_MONOTONIC, &start);
   long a;
   for (a = 0; a < a_opts->m_num_threads; ++a) {
     copy_thread_opts(&thread_opts, &ptopts[a], a);
@@ -818,17 +1688,70 @@ void train_model(opt_t *a_opts) {
   for (a = 0; a < a_opts->m_num_threads; ++a)
     pthread_join(pt[a], NULL);
 
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  if (thread_opts.m_stream)
+    close_stream(&stream);
+  if (thread_opts.m_shards)
+    free_shards(&shards);
+  /* a final checkpoint guards against failures while saving the
+     results */
+  if (thread_opts.m_checkpointer) {
+    stop_checkpointer(&checkpointer);
+    write_checkpoint(&checkpointer);
+    free_checkpointer(&checkpointer);
+  }
+
+  if (a_opts->m_debug_mode > 0) {
+    long long word_count = 0;
+    for (a = 0; a < a_opts->m_num_threads; ++a) {
+      word_count += ptopts[a].m_word_count;
+      /* only count the words processed since resuming */
+      if (resume && resume->m_progress[a].m_local_iter >= 0)
+        word_count -= resume->m_progress[a].m_word_count_actual;
+    }
+
+    double elapsed = (finish.tv_sec - start.tv_sec)
+                     + (finish.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "\nTraining time: %.2f sec  Threads: %d  "
+            "Words/sec: %.2fk\n", elapsed, a_opts->m_num_threads,
+            word_count / (elapsed + 1e-9) / 1000);
+    if (a_opts->m_negative > 0) {
+      long long drawn = 0, rejected = 0;
+      for (a = 0; a < a_opts->m_num_threads; ++a) {
+        drawn += ptopts[a].m_negatives_drawn;
+        rejected += ptopts[a].m_negatives_rejected;
+      }
+      fprintf(stderr, "Negative samples: %lld  Rejected: %lld (%.2f%%)\n",
+              drawn, rejected, 100. * rejected / (drawn + (drawn == 0)));
+    }
+    output_sync_stats(stderr, &sync);
+    if (thread_opts.m_scheduler)
+      output_schedule_stats(stderr, &scheduler);
+    if (thread_opts.m_stream)
+      output_stream_stats(stderr, &stream);
+  }
+
   if (a_opts->m_ts_least_sq)
     finalize_least_sq(vocab.m_vocab_size,
                       a_opts->m_layer1_size, &nnet);
 
   save_embeddings(a_opts, &vocab, &nnet);
-  pthread_mutex_destroy(&tlock);
+  if (a_opts->m_model_file[0])
+    save_model(a_opts->m_model_file, a_opts, &vocab, &nnet, &multiclass,
+               NULL, 0);
+  free_sync(&sync);
+  if (thread_opts.m_scheduler)
+    free_scheduler(&scheduler);
+  if (thread_opts.m_corpus)
+    close_corpus(&corpus);
 
   free(pt);
   free(ptopts);
   free_nnet(&nnet);
-  free(ugram_table);
-  free(exp_table);
+  free_sampler(&sampler);
+  free_sigmoid(&sigmoid);
+  free_topology(&topology);
   free_vocab(&vocab);
+  if (resume)
+    close_model(&checkpoint);
 }
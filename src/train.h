@@ -11,12 +11,6 @@
 //////////////
 #include "common.h"
 
-////////////
-// Macros //
-////////////
-#define EXP_TABLE_SIZE 1000	/**< size of the exponents table */
-#define MAX_EXP 6		/**< maximum power for an exponent */
-
 /////////////
 // Structs //
 /////////////
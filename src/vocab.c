@@ -13,20 +13,21 @@
 const int TABLE_SIZE = 1e8;
 const int MAX_CODE_LENGTH = 40;
 const int MAX_SENTENCE_LENGTH = 1000;
-const int VOCAB_HASH_SIZE = 30000000;  // Maximum 30 * 0.7 = 21M words in the vocabulary
+const long long VOCAB_HASH_INIT_SIZE = 1 << 12;
+const size_t VOCAB_ARENA_INIT_SIZE = 1 << 16;
 const char EOS[] = "</s>";
 
 /////////////
 // Methods //
 /////////////
-int *init_unigram_table(vocab_t *a_vocab) {
+int *init_unigram_table(vocab_t *a_vocab, const double a_power) {
   vw_t *vocab = a_vocab->m_vocab;
   long long vocab_size = a_vocab->m_vocab_size;
   if (vocab_size == 0)
     return NULL;
 
   double train_words_pow = 0;
-  double d1, power = 0.75;
+  double d1, power = a_power;
   int *table = (int *) malloc(TABLE_SIZE * sizeof(int));
   long long a;
   for (a = 0; a < vocab_size; a++)
@@ -98,7 +99,37 @@ void create_binary_tree(vocab_t *a_vocab) {
     parent_node[min2i] = vocab_size + a;
     binary[min2i] = 1;
   }
-  // Now assign binary code to each vocabulary word
+  // Now assign binary code to each vocabulary word, storing the codes
+  // of all words back to back
+  long long n_codes = 0;
+  for (a = 0; a < vocab_size; ++a) {
+    b = a;
+    i = 0;
+    do {
+      ++i;
+      b = parent_node[b];
+    } while (b != vocab_size * 2 - 2);
+
+    if (i > MAX_CODE_LENGTH) {
+      fprintf(stderr, "Huffman code of word '%s' exceeds %d bits.\n",
+              vocab[a].word, MAX_CODE_LENGTH);
+      exit(EXIT_FAILURE);
+    }
+    vocab[a].codelen = i;
+    vocab[a].code_offset = n_codes;
+    n_codes += i;
+  }
+  free(a_vocab->m_codes);
+  free(a_vocab->m_points);
+  a_vocab->m_n_codes = n_codes;
+  a_vocab->m_codes = (char *) malloc(n_codes + 1);
+  a_vocab->m_points = (int *) malloc((n_codes + 1) * sizeof(int));
+  if (a_vocab->m_codes == NULL || a_vocab->m_points == NULL) {
+    fprintf(stderr, "Could not allocate memory for Huffman codes.\n");
+    exit(EXIT_FAILURE);
+  }
+  char *wcode;
+  int *wpoint;
   for (a = 0; a < vocab_size; ++a) {
     b = a;
     i = 0;
@@ -110,11 +141,13 @@ void create_binary_tree(vocab_t *a_vocab) {
       if (b == vocab_size * 2 - 2)
         break;
     }
-    vocab[a].codelen = i;
-    vocab[a].point[0] = vocab_size - 2;
+    wcode = &a_vocab->m_codes[vocab[a].code_offset];
+    wpoint = &a_vocab->m_points[vocab[a].code_offset];
+    wpoint[0] = vocab_size - 2;
     for (b = 0; b < i; b++) {
-      vocab[a].code[i - b - 1] = code[b];
-      vocab[a].point[i - b] = point[b] - vocab_size;
+      wcode[i - b - 1] = code[b];
+      if (b > 0)
+        wpoint[i - b] = point[b] - vocab_size;
     }
   }
   free(count);
@@ -122,46 +155,132 @@ void create_binary_tree(vocab_t *a_vocab) {
   free(parent_node);
 }
 
-// Returns hash value of a word
-static int GetWordHash(const char *word) {
-  unsigned long long a, hash = 0;
-  for (a = 0; a < strlen(word); ++a)
-    hash = hash * 257 + word[a];
+/* mix all bits of a word hash into the 32 bits cached in the slots */
+static inline unsigned int mix_hash(unsigned long long a_hash) {
+  return (unsigned int) ((a_hash * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static inline int vocab_hash_full(const vocab_t *a_vocab, long long a_size) {
+  return 10 * a_size > 7 * a_vocab->m_vocab_hash_size;
+}
+
+static void insert_vocab_hash(vocab_t *a_vocab, int a_index,
+                              unsigned int a_hash) {
+  const long long mask = a_vocab->m_vocab_hash_size - 1;
+  long long i = a_hash & mask;
+  while (a_vocab->m_vocab_hash[i].m_index != -1)
+    i = (i + 1) & mask;
 
-  return hash % VOCAB_HASH_SIZE;
+  a_vocab->m_vocab_hash[i].m_index = a_index;
+  a_vocab->m_vocab_hash[i].m_hash = a_hash;
 }
 
-int search_vocab(const char *a_word, const vw_t *a_vocab, const int *a_vocab_hash) {
-  unsigned int hash = GetWordHash(a_word);
+/* allocate an empty hash large enough for `a_n_words' words */
+static vh_t *alloc_vocab_hash(vocab_t *a_vocab, long long a_n_words) {
+  vh_t *old_hash = a_vocab->m_vocab_hash;
+  long long i;
+  a_vocab->m_vocab_hash_size = VOCAB_HASH_INIT_SIZE;
+  while (vocab_hash_full(a_vocab, a_n_words))
+    a_vocab->m_vocab_hash_size *= 2;
+
+  a_vocab->m_vocab_hash = (vh_t *) malloc(a_vocab->m_vocab_hash_size
+                                          * sizeof(vh_t));
+  if (a_vocab->m_vocab_hash == NULL) {
+    fprintf(stderr, "Could not allocate memory for vocabulary hash.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < a_vocab->m_vocab_hash_size; ++i)
+    a_vocab->m_vocab_hash[i].m_index = -1;
+
+  return old_hash;
+}
+
+/* double the size of the hash, reusing cached hash values */
+static void grow_vocab_hash(vocab_t *a_vocab) {
+  const long long old_size = a_vocab->m_vocab_hash_size;
+  vh_t *old_hash = alloc_vocab_hash(a_vocab, a_vocab->m_vocab_size);
+  long long i;
+  for (i = 0; i < old_size; ++i) {
+    if (old_hash[i].m_index != -1)
+      insert_vocab_hash(a_vocab, old_hash[i].m_index, old_hash[i].m_hash);
+  }
+  free(old_hash);
+}
+
+int search_vocab_hashed(const char *a_word, size_t a_len,
+                        unsigned long long a_hash, const vocab_t *a_vocab) {
+  const long long mask = a_vocab->m_vocab_hash_size - 1;
+  const unsigned int hash = mix_hash(a_hash);
+  const vh_t *slot;
+  const char *word;
+  long long i = hash & mask;
   while (1) {
-    if (a_vocab_hash[hash] == -1)
+    slot = &a_vocab->m_vocab_hash[i];
+    if (slot->m_index == -1)
       return -1;
 
-    if (!strcmp(a_word, a_vocab[a_vocab_hash[hash]].word))
-      return a_vocab_hash[hash];
-
-    hash = (hash + 1) % VOCAB_HASH_SIZE;
+    if (slot->m_hash == hash) {
+      word = a_vocab->m_vocab[slot->m_index].word;
+      /* strncmp() stops at the end of a shorter stored word */
+      if (strncmp(word, a_word, a_len) == 0 && word[a_len] == '\0')
+        return slot->m_index;
+    }
+    i = (i + 1) & mask;
   }
   return -1;
 }
 
-// Adds a word to the vocabulary
-int add_word2vocab(vocab_t *a_vocab, const char *a_word) {
+int search_vocab(const char *a_word, const vocab_t *a_vocab) {
+  size_t len = strlen(a_word);
+  return search_vocab_hashed(a_word, len, word_hash(a_word, len), a_vocab);
+}
+
+/* copy a word into the string arena, moving the arena if it is full */
+static char *store_word(vocab_t *a_vocab, const char *a_word, size_t a_len) {
+  if (a_vocab->m_arena_size + a_len + 1 > a_vocab->m_arena_capacity) {
+    size_t capacity = a_vocab->m_arena_capacity? 2 * a_vocab->m_arena_capacity:
+                      VOCAB_ARENA_INIT_SIZE;
+    while (a_vocab->m_arena_size + a_len + 1 > capacity)
+      capacity *= 2;
+
+    char *arena = (char *) malloc(capacity);
+    if (arena == NULL) {
+      fprintf(stderr, "Could not allocate memory for vocabulary strings.\n");
+      exit(EXIT_FAILURE);
+    }
+    long long i;
+    if (a_vocab->m_arena_size)
+      memcpy(arena, a_vocab->m_arena, a_vocab->m_arena_size);
+    for (i = 0; i < a_vocab->m_vocab_size; ++i)
+      a_vocab->m_vocab[i].word = arena + (a_vocab->m_vocab[i].word
+                                          - a_vocab->m_arena);
+    free(a_vocab->m_arena);
+    a_vocab->m_arena = arena;
+    a_vocab->m_arena_capacity = capacity;
+  }
+  char *word = a_vocab->m_arena + a_vocab->m_arena_size;
+  memcpy(word, a_word, a_len);
+  word[a_len] = '\0';
+  a_vocab->m_arena_size += a_len + 1;
+  return word;
+}
+
+int add_word2vocab_hashed(vocab_t *a_vocab, const char *a_word, size_t a_len,
+                          unsigned long long a_hash, long long a_count) {
   long long vocab_size = a_vocab->m_vocab_size;
-  int *vocab_hash = a_vocab->m_vocab_hash;
   vw_t *vocab = a_vocab->m_vocab;
 
-
+  /* truncate word to the maximum acceptable length */
+  if (a_len > MAX_STRING - 1) {
+    a_len = MAX_STRING - 1;
+    a_hash = word_hash(a_word, a_len);
+  }
   /* check if the word is already known */
   int i;
-  if ((i = search_vocab(a_word, vocab, vocab_hash)) >= 0) {
-    ++vocab[i].cn;
-    return vocab_size;
+  if ((i = search_vocab_hashed(a_word, a_len, a_hash, a_vocab)) >= 0) {
+    vocab[i].cn += a_count;
+    return i;
   }
-  /* truncate word to the maximum acceptable length */
-  unsigned int hash, length = strlen(a_word) + 1;
-  if (length > MAX_STRING)
-    length = MAX_STRING;
 
   /* Reallocate memory if needed */
   if (vocab_size + 2 >= a_vocab->m_max_vocab_size) {
@@ -171,19 +290,25 @@ int add_word2vocab(vocab_t *a_vocab, const char *a_word) {
     vocab = a_vocab->m_vocab;
   }
 
-  vocab[vocab_size].word = (char *) calloc(length, sizeof(char));
-  strcpy(vocab[vocab_size].word, a_word);
-  vocab[vocab_size].cn = 1;
+  vocab[vocab_size].word = store_word(a_vocab, a_word, a_len);
+  vocab[vocab_size].cn = a_count;
+  vocab[vocab_size].code_offset = 0;
+  vocab[vocab_size].codelen = 0;
   vocab_size = ++a_vocab->m_vocab_size;
 
-  hash = GetWordHash(a_word);
-  while (vocab_hash[hash] != -1)
-    hash = (hash + 1) % VOCAB_HASH_SIZE;
+  if (vocab_hash_full(a_vocab, vocab_size))
+    grow_vocab_hash(a_vocab);
 
-  vocab_hash[hash] = vocab_size - 1;
+  insert_vocab_hash(a_vocab, vocab_size - 1, mix_hash(a_hash));
   return vocab_size - 1;
 }
 
+// Adds a word to the vocabulary
+int add_word2vocab(vocab_t *a_vocab, const char *a_word) {
+  size_t len = strlen(a_word);
+  return add_word2vocab_hashed(a_vocab, a_word, len, word_hash(a_word, len), 1);
+}
+
 // Used later for sorting by word counts
 int VocabCompare(const void *a, const void *b) {
   return ((struct vocab_word *)b)->cn - ((struct vocab_word *)a)->cn;
@@ -193,45 +318,71 @@ int VocabCompare(const void *a, const void *b) {
 int sort_vocab(vocab_t *a_vocab, const int a_min_count) {
   long long vocab_size = a_vocab->m_vocab_size;
   vw_t *vocab = a_vocab->m_vocab;
-  int *vocab_hash = a_vocab->m_vocab_hash;
 
   int a, size;
-  unsigned int hash;
   // Sort the vocabulary and keep </s> at the first position
   qsort(&vocab[1], vocab_size - 1,
         sizeof(struct vocab_word), VocabCompare);
 
-  for (a = 0; a < VOCAB_HASH_SIZE; ++a) {
-    vocab_hash[a] = -1;
-  }
+  free(alloc_vocab_hash(a_vocab, vocab_size));
   size = vocab_size;
   int train_words = 0;
   for (a = 0; a < size; a++) {
     // Words occuring less than min_count times will be discarded from the vocab
     if ((vocab[a].cn < a_min_count) && (a != 0)) {
       vocab_size = --a_vocab->m_vocab_size;
-      free(vocab[a].word);
     } else {
       // Hash will be re-computed, as after the sorting it is not actual
-      hash = GetWordHash(vocab[a].word);
-      while (vocab_hash[hash] != -1) {
-        hash = (hash + 1) % VOCAB_HASH_SIZE;
-      }
-      vocab_hash[hash] = a;
+      insert_vocab_hash(a_vocab, a, mix_hash(word_hash(vocab[a].word,
+                                                       strlen(vocab[a].word))));
       train_words += vocab[a].cn;
     }
   }
   a_vocab->m_vocab = (struct vocab_word *) realloc(vocab,
                                                    (vocab_size + 1) * sizeof(vw_t));
   vocab = a_vocab->m_vocab;
-  // Allocate memory for the binary tree construction
+  // Store the remaining words contiguously in the order of frequency
+  size_t arena_size = 0, len;
+  for (a = 0; a < vocab_size; ++a)
+    arena_size += strlen(vocab[a].word) + 1;
+  char *arena = (char *) malloc(arena_size + 1);
+  if (arena == NULL) {
+    fprintf(stderr, "Could not allocate memory for vocabulary strings.\n");
+    exit(EXIT_FAILURE);
+  }
+  arena_size = 0;
   for (a = 0; a < vocab_size; ++a) {
-    vocab[a].code = (char *) calloc(MAX_CODE_LENGTH, sizeof(char));
-    vocab[a].point = (int *) calloc(MAX_CODE_LENGTH, sizeof(int));
+    len = strlen(vocab[a].word) + 1;
+    memcpy(arena + arena_size, vocab[a].word, len);
+    vocab[a].word = arena + arena_size;
+    arena_size += len;
   }
+  free(a_vocab->m_arena);
+  a_vocab->m_arena = arena;
+  a_vocab->m_arena_size = a_vocab->m_arena_capacity = arena_size;
   return train_words;
 }
 
+// FNV-1a hash over all words and their counts
+unsigned long long vocab_checksum(const vocab_t *a_vocab) {
+  const unsigned long long prime = 1099511628211ULL;
+  unsigned long long hash = 14695981039346656037ULL;
+  const char *ch;
+  long long i, cn;
+  size_t j;
+  for (i = 0; i < a_vocab->m_vocab_size; ++i) {
+    for (ch = a_vocab->m_vocab[i].word; ; ++ch) {
+      hash = (hash ^ (unsigned char) *ch) * prime;
+      if (*ch == '\0')
+        break;
+    }
+    cn = a_vocab->m_vocab[i].cn;
+    for (j = 0; j < sizeof(cn); ++j)
+      hash = (hash ^ ((cn >> (8 * j)) & 0xFF)) * prime;
+  }
+  return hash;
+}
+
 void output_vocab(FILE *a_ostream, const vocab_t *a_vocab) {
   long long i;
   vw_t *iword;
@@ -245,58 +396,33 @@ void output_vocab(FILE *a_ostream, const vocab_t *a_vocab) {
 }
 
 // Reduces the vocabulary by removing infrequent tokens
-void reduce_vocab(vocab_t *a_vocab, opt_t *a_opts) {
-  long long vocab_size = a_vocab->m_vocab_size;
-  vw_t *vocab = a_vocab->m_vocab;
-  int *vocab_hash = a_vocab->m_vocab_hash;
-
-  int a, b = 0;
-  unsigned int hash;
-  for (a = 0; a < vocab_size; a++) {
-    if (vocab[a].cn > a_opts->m_min_reduce) {
-      vocab[b].cn = vocab[a].cn;
-      vocab[b].word = vocab[a].word;
-      ++b;
-    } else {
-      free(vocab[a].word);
-    }
-  }
-  for (a = 0; a < VOCAB_HASH_SIZE; a++) {
-    vocab_hash[a] = -1;
-  }
-  a_vocab->m_vocab_size = b;
-  vocab_size = a_vocab->m_vocab_size;
-  for (a = 0; a < vocab_size; a++) {
-    // Hash will be re-computed, as it is not actual
-    hash = GetWordHash(vocab[a].word);
-    while (vocab_hash[hash] != -1) {
-      hash = (hash + 1) % VOCAB_HASH_SIZE;
-    }
-    vocab_hash[hash] = a;
-  }
-  ++a_opts->m_min_reduce;
-}
-
 void init_vocab(vocab_t *a_vocab) {
   a_vocab->m_vocab_size = 0; /**< number of actually stored elements */
   a_vocab->m_max_vocab_size = 0;  /**< pre-allocated  */
   a_vocab->m_train_words = 0;
   a_vocab->m_vocab = NULL;
-  a_vocab->m_vocab_hash = (int *) calloc(VOCAB_HASH_SIZE, sizeof(int));
+  a_vocab->m_codes = NULL;
+  a_vocab->m_points = NULL;
+  a_vocab->m_n_codes = 0;
+  a_vocab->m_arena = NULL;
+  a_vocab->m_arena_size = a_vocab->m_arena_capacity = 0;
+  a_vocab->m_vocab_hash = NULL;
+  alloc_vocab_hash(a_vocab, 0);
 }
 
 void free_vocab(vocab_t *a_vocab) {
-  vw_t *word;
-  long long i;
-  for (i = 0; i < a_vocab->m_vocab_size; ++i) {
-    word = &a_vocab->m_vocab[i];
-    free(word->code);
-    free(word->point);
-    free(word->word);
-  }
-
   free(a_vocab->m_vocab);
+  free(a_vocab->m_codes);
+  free(a_vocab->m_points);
+  a_vocab->m_codes = NULL;
+  a_vocab->m_points = NULL;
+  a_vocab->m_n_codes = 0;
+  free(a_vocab->m_arena);
+  a_vocab->m_arena = NULL;
+  a_vocab->m_arena_size = a_vocab->m_arena_capacity = 0;
   free(a_vocab->m_vocab_hash);
+  a_vocab->m_vocab_hash = NULL;
+  a_vocab->m_vocab_hash_size = 0;
   a_vocab->m_train_words = 0;
   a_vocab->m_max_vocab_size = 0;
   a_vocab->m_vocab_size = 0;
@@ -18,6 +18,10 @@
 ////////////
 // Macros //
 ////////////
+/** initial value of a word hash (64-bit FNV-1a) */
+# define WORD_HASH_INIT 14695981039346656037ULL
+/** add character `c' to word hash `h' */
+# define WORD_HASH_STEP(h, c) (((h) ^ (unsigned char) (c)) * 1099511628211ULL)
 
 ///////////////
 // Constants //
@@ -27,8 +31,11 @@ extern const int MAX_CODE_LENGTH; /**< maximum length of a binary
 				     code */
 extern const int MAX_SENTENCE_LENGTH; /**< maximum allowed sentence
 					 length */
-extern const int VOCAB_HASH_SIZE; /**< Maximum 30 * 0.7 = 21M words in
-				      the vocabulary */
+extern const long long VOCAB_HASH_INIT_SIZE; /**< initial number of
+						slots in the vocabulary
+						hash */
+extern const size_t VOCAB_ARENA_INIT_SIZE; /**< initial size of the
+					      string arena */
 extern const char EOS[];	/**< end-of-sentence mark */
 
 /////////////
@@ -40,13 +47,22 @@ extern const char EOS[];	/**< end-of-sentence mark */
  */
 typedef struct vocab_word {
   long long cn;		     /**< word count  */
-  int *point;		     /**< word's binary code */
   char *word;	    /**< String representation of the word.*/
-  char *code;	    /**< Numerical code of the word used for
-		       hashing.*/
+  long long code_offset;	/**< Position of word's Huffman code
+				   and inner nodes in the packed
+				   arrays of the vocabulary.*/
   char codelen;			/**< Length of word's code.*/
 } vw_t;
 
+/**
+ * @brief Slot of the vocabulary hash.
+ */
+typedef struct vocab_hash_slot {
+  int m_index;			/**< position of the word in the
+				   vocabulary (-1 for empty slots) */
+  unsigned int m_hash;		/**< cached hash of the word */
+} vh_t;
+
 /**
  * @brief Whole vocabulary.
  */
@@ -55,14 +71,42 @@ typedef struct vocab {
   long long m_max_vocab_size;	/**< maximum reserved size for the vocabulary  */
   long long m_train_words;	/**< number of words used for training */
   vw_t *m_vocab;		/**< internal word storage */
-  int *m_vocab_hash;		/**< internal mapping from word
-				   strings to hash codes */
+  char *m_arena;		/**< NUL-terminated strings of all words */
+  size_t m_arena_size;		/**< used bytes of the arena */
+  size_t m_arena_capacity;	/**< allocated bytes of the arena */
+  char *m_codes;		/**< Huffman codes of all words (only
+				   with hierarchical softmax) */
+  int *m_points;		/**< inner nodes on the paths to all
+				   words (only with hierarchical
+				   softmax) */
+  long long m_n_codes;		/**< total length of all codes */
+  vh_t *m_vocab_hash;		/**< open-addressing hash from word
+				   strings to their positions */
+  long long m_vocab_hash_size;	/**< number of slots in the hash (a
+				   power of two, grown when the load
+				   exceeds 0.7) */
 } vocab_t;
 
 /////////////
 // Methods //
 /////////////
 
+/**
+ * Compute hash of a word.
+ *
+ * \param a_word start of the word
+ * \param a_len length of the word
+ *
+ * \return \c unsigned long long hash of the word
+ */
+static inline unsigned long long word_hash(const char *a_word, size_t a_len) {
+  unsigned long long hash = WORD_HASH_INIT;
+  const char *end = a_word + a_len;
+  for (; a_word < end; ++a_word)
+    hash = WORD_HASH_STEP(hash, *a_word);
+  return hash;
+}
+
 /**
  * Add a word to the vocabulary.
  *
@@ -73,6 +117,20 @@ typedef struct vocab {
  */
 int add_word2vocab(vocab_t *a_vocab, const char *a_word);
 
+/**
+ * Add occurrences of a word whose hash is already known.
+ *
+ * \param a_vocab vocabulary to add the word to
+ * \param a_word start of the word (need not be NUL-terminated)
+ * \param a_len length of the word (without NUL characters)
+ * \param a_hash hash of the word as computed by word_hash()
+ * \param a_count number of occurrences to add
+ *
+ * \return \c int position of a word in the vocabulary
+ */
+int add_word2vocab_hashed(vocab_t *a_vocab, const char *a_word, size_t a_len,
+                          unsigned long long a_hash, long long a_count);
+
 /**
  * Free memory occupied by vocabulary.
  *
@@ -104,10 +162,11 @@ void init_vocab(vocab_t *a_vocab);
  * Initialize a unigram table.
  *
  * \param a_vocab vocabulary with relevant information
+ * \param a_power exponent applied to word counts
  *
  * \return pointer to the initialized table
  */
-int *init_unigram_table(vocab_t *a_vocab);
+int *init_unigram_table(vocab_t *a_vocab, const double a_power);
 
 /**
  * Output vocabulary to the specified stream.
@@ -120,26 +179,38 @@ int *init_unigram_table(vocab_t *a_vocab);
 void output_vocab(FILE *a_ostream, const vocab_t *a_vocab);
 
 /**
- * Reduce vocabulary by removing infrequent tokens.
+ * Look up a word in the vocabulary.
  *
- * \param a_vocab vocabulary innstance
- * \param a_opts CLI options defining reduce behavior
+ * \param a_word word to search for
+ * \param a_vocab vocabulary to search in
  *
- * \return \c void
+ * \return position of a word in the vocabulary or \c -1 if the word
+ *   is not found
  */
-void reduce_vocab(vocab_t *a_vocab, opt_t *a_opts);
+int search_vocab(const char *a_word, const vocab_t *a_vocab);
 
 /**
- * Look up a word in the vocabulary.
+ * Look up a word whose hash is already known.
  *
- * \param a_word word to search for
+ * \param a_word start of the word (need not be NUL-terminated)
+ * \param a_len length of the word (without NUL characters)
+ * \param a_hash hash of the word as computed by word_hash()
  * \param a_vocab vocabulary to search in
- * \param a_vocab_hash hash of word indices
  *
  * \return position of a word in the vocabulary or \c -1 if the word
  *   is not found
  */
-int search_vocab(const char *a_word, const vw_t *a_vocab, const int *a_vocab_hash);
+int search_vocab_hashed(const char *a_word, size_t a_len,
+                        unsigned long long a_hash, const vocab_t *a_vocab);
+
+/**
+ * Compute checksum of the vocabulary words and their counts.
+ *
+ * \param a_vocab vocabulary instance
+ *
+ * \return \c unsigned long long checksum
+ */
+unsigned long long vocab_checksum(const vocab_t *a_vocab);
 
 /**
  * Sort vocabulary.
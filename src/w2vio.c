@@ -6,8 +6,73 @@
 
 #include <errno.h>  /* errno */
 #include <ctype.h>  /* isspace() */
+#include <fcntl.h>  /* open() */
+#include <limits.h> /* LLONG_MAX, INT_MAX */
+#include <pthread.h> /* pthread_create() */
+#include <stdint.h> /* uint16_t */
 #include <stdio.h>  /* sscanf() */
-#include <string.h> /* strcpy() */
+#include <string.h> /* strcpy(), strerror() */
+#include <sys/mman.h> /* mmap() */
+#include <sys/stat.h> /* fstat() */
+#include <unistd.h> /* read(), lseek() */
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+///////////////
+// Constants //
+///////////////
+/** size of the read buffer of reader_t */
+static const size_t READER_BUFFER_SIZE = 1 << 20;
+/** size of the output buffer of save_embeddings() */
+static const size_t WRITER_BUFFER_SIZE = 1 << 22;
+/** number of rows formatted by a thread at once */
+static const long long WRITER_BLOCK_ROWS = 1024;
+static const char MODEL_MAGIC[8] = "W2VMODL";
+static const int64_t MODEL_VERSION = 1;
+
+////////////
+// Macros //
+////////////
+/** maximum length of a vector component in the text format (sign,
+    39 integer digits of FLT_MAX, point, 6 decimals, and space) */
+#define MAX_REAL_CHARS 48
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Vocabulary collected by one thread from a part of the training
+ * file.
+ *
+ * Words are kept in the order of their first occurrence, so that
+ * merging the counts of consecutive parts in order reproduces the
+ * vocabulary built by a single sequential pass.
+ */
+typedef struct {
+  vocab_t m_vocab;		/**< words of the part */
+  multiclass_t m_multiclass;	/**< statistics on task labels */
+  const opt_t *m_opts;		/**< command line options */
+  const shards_t *m_shards;	/**< shards of the training data */
+  long long m_start;		/**< first byte of the part */
+  long long m_end;		/**< end of the part */
+  int m_thread_id;		/**< index of the counting thread */
+} vocab_part_t;
+
+/**
+ * @brief Block of embeddings formatted as text by one thread.
+ */
+typedef struct {
+  const vocab_t *m_vocab;	/**< words of the rows */
+  const real *m_syn0;		/**< embedding matrix */
+  long long m_layer1_size;	/**< dimensionality of the embeddings */
+  long long m_start;		/**< first row of the block */
+  long long m_end;		/**< end of the block */
+  char *m_buffer;		/**< formatted rows */
+  size_t m_capacity;		/**< allocated size of `m_buffer' */
+  size_t m_size;		/**< used size of `m_buffer' */
+} text_block_t;
 
 /////////////
 // Methods //
@@ -43,18 +108,300 @@ void read_word(char *a_word, FILE *a_fin, const int a_consume_tab) {
   a_word[a] = 0;
 }
 
-// Reads a word and returns its index in the vocabulary
-int read_word_index(FILE *a_fin, const vw_t *a_vocab,
-                    const int *a_vocab_hash, const int a_consume_tab) {
-  char word[MAX_STRING];
-  read_word(word, a_fin, a_consume_tab);
-  if (feof(a_fin))
+/* open a file and its decompressor for the reader */
+static int open_reader_file(reader_t *a_reader, const char *a_path) {
+  const codec_t codec = file_codec(a_path);
+  a_reader->m_decoder = NULL;
+  a_reader->m_path = a_path;
+  a_reader->m_fd = open(a_path, O_RDONLY);
+  if (a_reader->m_fd < 0)
+    return -1;
+
+  if (codec != CODEC_NONE) {
+    a_reader->m_decoder = (decoder_t *) malloc(sizeof(decoder_t));
+    if (a_reader->m_decoder == NULL) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(EXIT_FAILURE);
+    }
+    init_decoder(a_reader->m_decoder, a_reader->m_fd, codec);
+  }
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(a_reader->m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  return 0;
+}
+
+static void close_reader_file(reader_t *a_reader) {
+  if (a_reader->m_decoder) {
+    free_decoder(a_reader->m_decoder);
+    free(a_reader->m_decoder);
+    a_reader->m_decoder = NULL;
+  }
+  if (a_reader->m_fd >= 0)
+    close(a_reader->m_fd);
+  a_reader->m_fd = -1;
+}
+
+/* switch to another shard of the training data */
+static void enter_shard(reader_t *a_reader, int a_shard) {
+  close_reader_file(a_reader);
+  a_reader->m_shard = a_shard;
+  if (open_reader_file(a_reader, a_reader->m_shards->m_paths[a_shard])) {
+    fprintf(stderr, "ERROR: training data file '%s' not found!\n",
+            a_reader->m_shards->m_paths[a_shard]);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void alloc_reader_buffer(reader_t *a_reader) {
+  a_reader->m_size = READER_BUFFER_SIZE;
+  a_reader->m_buf = (char *) malloc(a_reader->m_size);
+  if (a_reader->m_buf == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+int open_reader(reader_t *a_reader, const char *a_path, long long a_offset) {
+  a_reader->m_shards = NULL;
+  a_reader->m_shard = 0;
+  a_reader->m_limit = LLONG_MAX;
+  a_reader->m_limit_shard = -1;
+  if (open_reader_file(a_reader, a_path))
+    return -1;
+
+  alloc_reader_buffer(a_reader);
+  seek_reader(a_reader, a_offset);
+  return 0;
+}
+
+void open_shard_reader(reader_t *a_reader, const shards_t *a_shards,
+                       long long a_offset, long long a_limit) {
+  a_reader->m_shards = a_shards;
+  a_reader->m_shard = shard_of(a_shards, a_offset);
+  /* a limit lies at a line start in a plain shard or at the start of a
+     compressed one, so that it can be checked against exact offsets */
+  a_reader->m_limit = LLONG_MAX;
+  a_reader->m_limit_shard = -1;
+  if (a_limit < shards_size(a_shards)) {
+    a_reader->m_limit = a_limit;
+    a_reader->m_limit_shard = shard_of(a_shards, a_limit);
+  }
+  a_reader->m_fd = -1;
+  a_reader->m_decoder = NULL;
+  enter_shard(a_reader, a_reader->m_shard);
+  alloc_reader_buffer(a_reader);
+  seek_reader(a_reader, a_offset);
+}
+
+void seek_reader(reader_t *a_reader, long long a_offset) {
+  long long local = a_offset;
+  if (a_reader->m_shards) {
+    const int shard = shard_of(a_reader->m_shards, a_offset);
+    if (shard != a_reader->m_shard)
+      enter_shard(a_reader, shard);
+    local -= a_reader->m_shards->m_starts[shard];
+  }
+  if (a_reader->m_decoder) {
+    /* compressed data can only be read from the start */
+    if (local != 0) {
+      fprintf(stderr, "ERROR: cannot seek in %s compressed data.\n",
+              codec2str(a_reader->m_decoder->m_codec));
+      exit(EXIT_FAILURE);
+    }
+    const codec_t codec = a_reader->m_decoder->m_codec;
+    free_decoder(a_reader->m_decoder);
+    lseek(a_reader->m_fd, 0, SEEK_SET);
+    init_decoder(a_reader->m_decoder, a_reader->m_fd, codec);
+  } else {
+    lseek(a_reader->m_fd, local, SEEK_SET);
+  }
+  a_reader->m_offset = a_offset;
+  a_reader->m_pos = a_reader->m_end = 0;
+  a_reader->m_eof = 0;
+}
+
+void close_reader(reader_t *a_reader) {
+  close_reader_file(a_reader);
+  free(a_reader->m_buf);
+  a_reader->m_buf = NULL;
+  a_reader->m_pos = a_reader->m_end = a_reader->m_size = 0;
+}
+
+/* read the next block of the current file (up to the limit) */
+static ssize_t read_reader_file(reader_t *a_reader) {
+  ssize_t n_read;
+  size_t size = a_reader->m_size;
+  if (a_reader->m_shard == a_reader->m_limit_shard) {
+    if (a_reader->m_offset >= a_reader->m_limit)
+      return 0;
+    if (a_reader->m_limit - a_reader->m_offset < (long long) size)
+      size = a_reader->m_limit - a_reader->m_offset;
+  }
+  if (a_reader->m_decoder)
+    return decoder_read(a_reader->m_decoder, a_reader->m_buf, size);
+
+  do {
+    n_read = read(a_reader->m_fd, a_reader->m_buf, size);
+  } while (n_read < 0 && errno == EINTR);
+  /* a failed read must not be mistaken for the end of the data */
+  if (n_read < 0) {
+    fprintf(stderr, "ERROR: could not read training data file '%s': %s\n",
+            a_reader->m_path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  return n_read;
+}
+
+/* refill an exhausted buffer, return the number of new bytes */
+static size_t fill_reader(reader_t *a_reader) {
+  const int last_ch = a_reader->m_end? a_reader->m_buf[a_reader->m_end - 1]:
+                      '\n';
+  a_reader->m_offset += a_reader->m_end;
+  ssize_t n_read = read_reader_file(a_reader);
+  /* continue with the next non-empty shard */
+  while (n_read <= 0 && a_reader->m_shards
+         && a_reader->m_shard != a_reader->m_limit_shard
+         && a_reader->m_shard + 1 < a_reader->m_shards->m_n_shards) {
+    enter_shard(a_reader, a_reader->m_shard + 1);
+    a_reader->m_offset = a_reader->m_shards->m_starts[a_reader->m_shard];
+    if (last_ch != '\n') {
+      /* a shard always ends a line */
+      --a_reader->m_offset;
+      a_reader->m_buf[0] = '\n';
+      n_read = 1;
+      break;
+    }
+    n_read = read_reader_file(a_reader);
+  }
+  a_reader->m_pos = 0;
+  a_reader->m_end = n_read > 0? (size_t) n_read: 0;
+  return a_reader->m_end;
+}
+
+/* counterpart of fgetc() */
+static inline int reader_getc(reader_t *a_reader) {
+  if (a_reader->m_pos == a_reader->m_end && !fill_reader(a_reader)) {
+    a_reader->m_eof = 1;
+    return EOF;
+  }
+  return (unsigned char) a_reader->m_buf[a_reader->m_pos++];
+}
+
+/* characters which end the fast scan of a word */
+static inline int is_delimiter(const char a_ch) {
+  return a_ch == ' ' || a_ch == '\t' || a_ch == '\n' || a_ch == 13
+      || a_ch == '\0';
+}
+
+/* find the first space, tab, newline, carriage return, or NUL in
+   [a_p, a_end) */
+static const char *find_delimiter(const char *a_p, const char *a_end) {
+#ifdef __SSE2__
+  /* all delimiters are <= ' ', so look for such bytes first */
+  const __m128i space = _mm_set1_epi8(' ');
+  __m128i chunk;
+  unsigned int mask;
+  for (; a_end - a_p >= 16; a_p += 16) {
+    chunk = _mm_loadu_si128((const __m128i *) a_p);
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chunk, space),
+                                            chunk));
+    for (; mask; mask &= mask - 1) {
+      if (is_delimiter(a_p[__builtin_ctz(mask)]))
+        return a_p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; a_p < a_end; ++a_p) {
+    if (is_delimiter(*a_p))
+      return a_p;
+  }
+  return NULL;
+}
+
+/* character-wise counterpart of read_word() used at buffer boundaries
+   and for words with carriage returns or NUL characters */
+static const char *read_token_slow(reader_t *a_reader, size_t *a_len,
+                                   const int a_consume_tab) {
+  char *word = a_reader->m_word;
+  int a = 0, ch;
+  while (1) {
+    ch = reader_getc(a_reader);
+    if (ch == EOF)
+      return NULL;
+
+    if (ch == 13)
+      continue;
+
+    if ((ch == ' ') || (ch == '\t') || (ch == '\n')) {
+      if (a > 0) {
+        if (ch == '\n' || (ch == '\t' && !a_consume_tab))
+          --a_reader->m_pos;
+
+        break;
+      }
+      if (ch == '\n' || (ch == '\t' && !a_consume_tab)) {
+        *a_len = strlen(EOS);
+        return EOS;
+      } else {
+        continue;
+      }
+    }
+    word[a] = ch;
+    ++a;
+    if (a >= MAX_STRING - 1)
+      --a;   // Truncate too long words
+  }
+  /* like read_word(), the word ends at the first NUL character */
+  *a_len = strnlen(word, a);
+  return word;
+}
+
+const char *read_token(reader_t *a_reader, size_t *a_len,
+                       const int a_consume_tab) {
+  const char *buf = a_reader->m_buf;
+  size_t pos = a_reader->m_pos;
+  const size_t end = a_reader->m_end;
+  char ch;
+  /* skip leading white spaces */
+  for (; pos < end; ++pos) {
+    ch = buf[pos];
+    if (ch == '\n' || (ch == '\t' && !a_consume_tab)) {
+      a_reader->m_pos = pos + 1;
+      *a_len = strlen(EOS);
+      return EOS;
+    }
+    if (ch != ' ' && ch != '\t' && ch != 13)
+      break;
+  }
+  a_reader->m_pos = pos;
+  const char *delim = find_delimiter(&buf[pos], &buf[end]);
+  if (delim == NULL || *delim == 13 || *delim == '\0')
+    return read_token_slow(a_reader, a_len, a_consume_tab);
+
+  *a_len = delim - &buf[pos];
+  if (*a_len > MAX_STRING - 2)
+    *a_len = MAX_STRING - 2;   // Truncate too long words
+
+  /* newlines and significant tabs are left for the next read */
+  a_reader->m_pos = delim - buf;
+  if (*delim == ' ' || (*delim == '\t' && a_consume_tab))
+    ++a_reader->m_pos;
+
+  return &buf[pos];
+}
+
+int read_token_index(reader_t *a_reader, const vocab_t *a_vocab,
+                     const int a_consume_tab) {
+  size_t len;
+  const char *word = read_token(a_reader, &len, a_consume_tab);
+  if (word == NULL)
     return -1;
 
-  return search_vocab(word, a_vocab, a_vocab_hash);
+  return search_vocab_hashed(word, len, word_hash(word, len), a_vocab);
 }
 
-int read_tags(FILE *a_fin, multiclass_t *a_multiclass) {
+int read_token_tags(reader_t *a_reader, multiclass_t *a_multiclass) {
   int active_tasks = 0, ntasks = 0;
 
   int ch;
@@ -62,13 +409,15 @@ int read_tags(FILE *a_fin, multiclass_t *a_multiclass) {
   int ret = 0, space_seen = 1, uscore_seen = 0;
   char tag[MAX_STRING];
 
-  while (!feof(a_fin)) {
-    ch = fgetc(a_fin);
+  while ((ch = reader_getc(a_reader)) != EOF) {
     if (ch == 13)
       continue;
 
     if ((ch == ' ') || (ch == '\t') || (ch == '\n')) {
       if (nchars) {
+        if (ntasks >= MAX_TASKS)
+          return -1;
+
         tag[nchars] = '\0';
         ret = sscanf(tag, "%d",
                      &a_multiclass->m_classes[ntasks++]);
@@ -87,14 +436,15 @@ int read_tags(FILE *a_fin, multiclass_t *a_multiclass) {
       if (ch == '_') {
         if (uscore_seen)
           continue;
-        else if (space_seen)
+        else if (space_seen && ntasks < MAX_TASKS)
           a_multiclass->m_classes[ntasks++] = -1;
         else
           return -1;
 
         uscore_seen = 1;
       } else {
-        tag[nchars++] = ch;
+        if (nchars < MAX_STRING - 1)
+          tag[nchars++] = ch;
         uscore_seen = 0;
       }
       space_seen = 0;
@@ -106,31 +456,42 @@ int read_tags(FILE *a_fin, multiclass_t *a_multiclass) {
 static int process_line_w2v(vocab_t *a_vocab,
                             multiclass_t *a_multiclass,
                             const int a_use_w2v,
-                            char *a_word, const char *a_line, ssize_t a_read) {
+                            const char *a_line, ssize_t a_read) {
   int n_words = 0;
   UNUSED(a_multiclass);
   UNUSED(a_use_w2v);
 
-  ssize_t i, n_chars;
-  for (i = 0, n_chars = 0; i < a_read; ++i, ++n_chars) {
+  /* words are hashed while they are scanned and stored without the
+     part following a NUL character or exceeding MAX_STRING - 1 bytes */
+  unsigned long long hash = WORD_HASH_INIT;
+  ssize_t i, start = -1;
+  size_t len = 0;
+  int open = 0;
+  for (i = 0; i < a_read; ++i) {
     if (isspace(a_line[i])) {
-      if (n_chars > 0) {
-        a_word[n_chars] = 0;
-        add_word2vocab(a_vocab, a_word);
+      if (start >= 0) {
+        add_word2vocab_hashed(a_vocab, &a_line[start], len, hash, 1);
         ++n_words;
       }
-      n_chars = -1;
-    } else if (n_chars >= MAX_STRING) {
-      n_chars = MAX_STRING - 1;
-      a_word[n_chars] = 0;
+      start = -1;
     } else {
-      a_word[n_chars] = a_line[i];
+      if (start < 0) {
+        start = i;
+        hash = WORD_HASH_INIT;
+        len = 0;
+        open = 1;
+      }
+      if (open && a_line[i] && len < MAX_STRING - 1) {
+        hash = WORD_HASH_STEP(hash, a_line[i]);
+        ++len;
+      } else {
+        open = 0;
+      }
     }
   }
 
-  if (n_chars > 0) {
-    a_word[n_chars] = 0;
-    add_word2vocab(a_vocab, a_word);
+  if (start >= 0) {
+    add_word2vocab_hashed(a_vocab, &a_line[start], len, hash, 1);
     ++n_words;
   }
   return n_words;
@@ -204,7 +565,6 @@ static int process_tag_line(multiclass_t *a_multiclass, const char *a_line,
 static int process_line_task_specific(vocab_t *a_vocab,
                                       multiclass_t *a_multiclass,
                                       const int a_use_w2v,
-                                      char *a_word,
                                       const char *a_line, ssize_t a_read) {
   int active_tasks = 0;
   const char *tag_line = strchr(a_line, '\t');
@@ -222,92 +582,852 @@ static int process_line_task_specific(vocab_t *a_vocab,
   if (!active_tasks && !a_use_w2v)
     return 0;
 
-  return process_line_w2v(a_vocab, NULL, 0, a_word, a_line, line_read);
+  return process_line_w2v(a_vocab, NULL, 0, a_line, line_read);
 }
 
-size_t learn_vocab_from_trainfile(vocab_t *a_vocab, multiclass_t *a_multiclass,
-                                  opt_t *a_opts) {
-  FILE *fin = fopen(a_opts->m_train_file, "rb");
-  if (fin == NULL) {
-    fprintf(stderr, "ERROR: training data file not found!\n");
-    exit(EXIT_FAILURE);
+long long align_to_line(FILE *a_fin, long long a_offset) {
+  do {
+    fseek(a_fin, --a_offset, SEEK_SET);
+  } while (a_offset > 0 && fgetc(a_fin) != '\n');
+
+  if (a_offset > 0)
+    ++a_offset;
+  return a_offset;
+}
+
+/* counterpart of getline() */
+static ssize_t reader_getline(reader_t *a_reader, char **a_line,
+                              size_t *a_capacity) {
+  const char *start, *nl = NULL;
+  size_t len = 0, n;
+  while (nl == NULL) {
+    if (a_reader->m_pos == a_reader->m_end && !fill_reader(a_reader)) {
+      a_reader->m_eof = 1;
+      break;
+    }
+    start = a_reader->m_buf + a_reader->m_pos;
+    n = a_reader->m_end - a_reader->m_pos;
+    nl = (const char *) memchr(start, '\n', n);
+    if (nl)
+      n = nl - start + 1;
+    if (len + n + 1 > *a_capacity) {
+      *a_capacity = 2 * (len + n + 1);
+      *a_line = (char *) realloc(*a_line, *a_capacity);
+      if (*a_line == NULL) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    memcpy(*a_line + len, start, n);
+    len += n;
+    a_reader->m_pos += n;
   }
+  if (len == 0)
+    return -1;
 
-  int a;
-  for (a = 0; a < VOCAB_HASH_SIZE; a++) {
-    a_vocab->m_vocab_hash[a] = -1;
+  (*a_line)[len] = '\0';
+  return len;
+}
+
+typedef int (*line_processor_t)(vocab_t *a_vocab, multiclass_t *a_multiclass,
+                                const int a_use_w2v,
+                                const char *a_line, ssize_t a_read);
+
+/* add the words of a line to the vocabulary of the part */
+static void count_line(vocab_part_t *a_part, line_processor_t a_process_line,
+                       const char *a_line, ssize_t a_read,
+                       long long *a_train_words) {
+  const opt_t *opts = a_part->m_opts;
+  if (a_read > 1) {
+    add_word2vocab(&a_part->m_vocab, EOS);
   }
+  if ((opts->m_debug_mode > 1) && a_part->m_thread_id == 0
+      && (*a_train_words % 100000 == 0)) {
+    fprintf(stderr, "%lldK%c", *a_train_words / 1000, 13);
+    fflush(stderr);
+  }
+  *a_train_words += a_process_line(&a_part->m_vocab, &a_part->m_multiclass,
+                                   !opts->m_ts, a_line, a_read);
+}
 
+/* count the lines starting in the part, shard by shard */
+static void *count_words_thread(void *a_part) {
+  vocab_part_t *part = (vocab_part_t *) a_part;
+  const opt_t *opts = part->m_opts;
+  const shards_t *shards = part->m_shards;
+  line_processor_t process_line = NULL;
+  if (opts->m_ts || opts->m_ts_least_sq || opts->m_ts_w2v)
+    process_line = process_line_task_specific;
+  else
+    process_line = process_line_w2v;
+
+  reader_t reader;
   ssize_t read;
   char *line = NULL;
   size_t len = 0;
-  char word[MAX_STRING];
-  const int use_w2v = !a_opts->m_ts;
-  int (*process_line)(vocab_t *a_vocab, multiclass_t *a_multiclass,
-                      const int a_use_w2v, char *a_word,
-                      const char *a_line, ssize_t a_read) = NULL;
+  long long train_words = 1, start, end;
+  const int last_shard = shard_of(shards, part->m_end);
+  int shard;
+  for (shard = shard_of(shards, part->m_start); shard <= last_shard;
+       ++shard) {
+    /* compressed shards always lie completely within a part */
+    start = part->m_start - shards->m_starts[shard];
+    end = part->m_end - shards->m_starts[shard];
+    if (start < 0)
+      start = 0;
+    if (start >= end)
+      continue;
+    if (part->m_end >= shards->m_starts[shard + 1])
+      end = LLONG_MAX;
 
-  if (a_opts->m_ts || a_opts->m_ts_least_sq || a_opts->m_ts_w2v)
-    process_line = process_line_task_specific;
-  else
-    process_line = process_line_w2v;
+    if (open_reader(&reader, shards->m_paths[shard], start)) {
+      fprintf(stderr, "ERROR: training data file '%s' not found!\n",
+              shards->m_paths[shard]);
+      exit(EXIT_FAILURE);
+    }
+    while (tell_reader(&reader) < end
+           && (read = reader_getline(&reader, &line, &len)) != -1)
+      count_line(part, process_line, line, read, &train_words);
+    close_reader(&reader);
+  }
+  free(line);
+  return NULL;
+}
 
-  long long train_words = 1;
-  while ((read = getline(&line, &len, fin)) != -1) {
-    if (read > 1) {
-      add_word2vocab(a_vocab, EOS);
+/* add counts of a file part to the vocabulary and task statistics */
+static void merge_vocab_part(vocab_t *a_vocab, multiclass_t *a_multiclass,
+                             const vocab_part_t *a_part) {
+  const multiclass_t *multiclass = &a_part->m_multiclass;
+  const vocab_t *vocab = &a_part->m_vocab;
+  size_t t;
+  if (multiclass->m_n_tasks) {
+    if (a_multiclass->m_n_tasks == 0) {
+      a_multiclass->m_n_tasks = multiclass->m_n_tasks;
+    } else if (a_multiclass->m_n_tasks != multiclass->m_n_tasks) {
+      fprintf(stderr,
+              "Invalid line format "
+              "(different number of tags specified for task-specific embeddings):"
+              " %zu versus %zu\n", multiclass->m_n_tasks,
+              a_multiclass->m_n_tasks);
+      exit(6);
     }
-    if ((a_opts->m_debug_mode > 1) && (train_words % 100000 == 0)) {
-      fprintf(stderr, "%lldK%c", train_words / 1000, 13);
-      fflush(stderr);
+    for (t = 0; t < multiclass->m_n_tasks; ++t) {
+      if (multiclass->m_classes[t] > a_multiclass->m_classes[t])
+        a_multiclass->m_classes[t] = multiclass->m_classes[t];
     }
-    train_words += process_line(a_vocab, a_multiclass, use_w2v,
-                                word, line, read);
+  }
 
-    if (a_vocab->m_vocab_size > VOCAB_HASH_SIZE * 0.7)
-      reduce_vocab(a_vocab, a_opts);
+  long long a;
+  const char *word;
+  size_t len;
+  for (a = 0; a < vocab->m_vocab_size; ++a) {
+    word = vocab->m_vocab[a].word;
+    len = strlen(word);
+    add_word2vocab_hashed(a_vocab, word, len, word_hash(word, len),
+                          vocab->m_vocab[a].cn);
   }
-  free(line);
-  a_vocab->m_train_words = sort_vocab(a_vocab, a_opts->m_min_count);
-  create_binary_tree(a_vocab);
+}
+
+size_t learn_vocab_from_trainfile(vocab_t *a_vocab, multiclass_t *a_multiclass,
+                                  opt_t *a_opts) {
+  shards_t shards;
+  open_shards(&shards, a_opts->m_train_file);
+  const long long file_size = shards_size(&shards);
+  int a, num_threads = a_opts->m_vocab_threads > 0?
+                    a_opts->m_vocab_threads: a_opts->m_num_threads;
+  if (num_threads < 1)
+    num_threads = 1;
 
-  if (ferror(fin)) {
-    fprintf(stderr, "ERROR: reading input file\n");
+  /* split the data into consecutive parts of about the same size,
+     aligned to line starts or to the boundaries of compressed shards */
+  vocab_part_t *parts = (vocab_part_t *) malloc(num_threads
+                                                * sizeof(vocab_part_t));
+  pthread_t *pt = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+  if (parts == NULL || pt == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
     exit(EXIT_FAILURE);
   }
+  for (a = 0; a < num_threads; ++a) {
+    init_vocab(&parts[a].m_vocab);
+    parts[a].m_multiclass.m_n_tasks = 0;
+    memset(parts[a].m_multiclass.m_classes, -1, sizeof(int) * MAX_TASKS);
+    parts[a].m_opts = a_opts;
+    parts[a].m_thread_id = a;
+    parts[a].m_shards = &shards;
+    parts[a].m_start = align_to_shard_line(&shards,
+                                           1 + a * file_size / num_threads);
+    if (a > 0)
+      parts[a - 1].m_end = parts[a].m_start;
+  }
+  parts[num_threads - 1].m_end = file_size;
+
+  for (a = 0; a < num_threads; ++a)
+    pthread_create(&pt[a], NULL, count_words_thread, (void *) &parts[a]);
+
+  for (a = 0; a < num_threads; ++a) {
+    pthread_join(pt[a], NULL);
+    merge_vocab_part(a_vocab, a_multiclass, &parts[a]);
+    free_vocab(&parts[a].m_vocab);
+  }
+  free(parts);
+  free(pt);
+  free_shards(&shards);
+
+  a_vocab->m_train_words = sort_vocab(a_vocab, a_opts->m_min_count);
+  if (a_opts->m_hs)
+    create_binary_tree(a_vocab);
+
   if (a_opts->m_debug_mode > 0) {
     fprintf(stderr, "Vocab size: %lld\n", a_vocab->m_vocab_size);
     fprintf(stderr, "Words in train file: %lld\n", a_vocab->m_train_words);
   }
-  size_t file_size = ftell(fin);
-  fclose(fin);
   return file_size;
 }
 
-void save_embeddings(const opt_t *a_opts, const vocab_t *a_vocab,
-                     const nnet_t *a_nnet) {
-  FILE *fo = a_opts->m_output_file[0]?                          \
-             fopen(a_opts->m_output_file, "wb"): stdout;
+void read_vocab(vocab_t *a_vocab, multiclass_t *a_multiclass,
+                const opt_t *a_opts) {
+  const char *path = a_opts->m_read_vocab_file;
+  FILE *fin = fopen(path, "rb");
+  if (fin == NULL) {
+    fprintf(stderr, "ERROR: vocabulary file '%s' not found!\n", path);
+    exit(EXIT_FAILURE);
+  }
+  char word[MAX_STRING];
+  size_t len = fread(word, 1, sizeof(MODEL_MAGIC), fin);
+  /* native model files already hold a sorted vocabulary */
+  if (len == sizeof(MODEL_MAGIC)
+      && memcmp(word, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0) {
+    fclose(fin);
+    model_t model;
+    if (open_model(&model, path)) {
+      fprintf(stderr, "ERROR: could not read model '%s'\n", path);
+      exit(EXIT_FAILURE);
+    }
+    load_model_vocab(&model, a_vocab, a_multiclass, a_opts->m_hs);
+    close_model(&model);
+  } else {
+    rewind(fin);
+    long long cn;
+    char eol;
+    add_word2vocab(a_vocab, EOS);
+    a_vocab->m_vocab[0].cn = 0;
+    while (1) {
+      read_word(word, fin, 1);
+      if (feof(fin))
+        break;
+
+      /* the count swallows the newline, which would otherwise be read
+         as an end of sentence */
+      if (fscanf(fin, "%lld%c", &cn, &eol) < 1) {
+        fprintf(stderr, "ERROR: invalid count of word '%s' in '%s'\n", word,
+                path);
+        exit(EXIT_FAILURE);
+      }
+      len = strlen(word);
+      add_word2vocab_hashed(a_vocab, word, len, word_hash(word, len), cn);
+    }
+    fclose(fin);
+    a_vocab->m_train_words = sort_vocab(a_vocab, a_opts->m_min_count);
+    if (a_opts->m_hs)
+      create_binary_tree(a_vocab);
+  }
+  if (a_opts->m_debug_mode > 0) {
+    fprintf(stderr, "Vocab size: %lld\n", a_vocab->m_vocab_size);
+    fprintf(stderr, "Words in vocabulary file: %lld\n", a_vocab->m_train_words);
+  }
+}
+
+void save_vocab(const char *a_path, const vocab_t *a_vocab) {
+  FILE *fo = fopen(a_path, "wb");
+  if (fo == NULL) {
+    fprintf(stderr, "ERROR: could not create vocabulary file '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  long long i;
+  for (i = 0; i < a_vocab->m_vocab_size; ++i)
+    fprintf(fo, "%s %lld\n", a_vocab->m_vocab[i].word, a_vocab->m_vocab[i].cn);
+  if (ferror(fo) || fclose(fo)) {
+    fprintf(stderr, "ERROR: writing vocabulary file '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* format a vector component exactly like `printf("%lf ")' */
+static char *format_real(char *a_out, const real a_value) {
+  /* a float is `mant * 2^exp' with a 24-bit `mant', so `mant * 10^6'
+     fits into 64 bits and can be rounded to six decimals exactly */
+  float value = a_value;
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased = (bits >> 23) & 0xFF;
+  int exp = biased? biased - 150: -149;
+  uint64_t mant = (bits & 0x7FFFFF) | (biased? 0x800000: 0);
+  uint64_t scaled = mant * 1000000, rem, half;
+  if (biased == 0xFF || exp > 19)
+    return a_out + sprintf(a_out, "%lf ", (double) value);
+
+  if (exp >= 0) {
+    scaled <<= exp;
+  } else if (exp < -45) {
+    scaled = 0;
+  } else {
+    /* round half to even like glibc */
+    rem = scaled & ((1ULL << -exp) - 1);
+    half = 1ULL << (-exp - 1);
+    scaled >>= -exp;
+    if (rem > half || (rem == half && (scaled & 1)))
+      ++scaled;
+  }
+
+  char digits[24];
+  uint64_t int_part = scaled / 1000000;
+  unsigned frac_part = scaled % 1000000;
+  int i, n = 0;
+  if (bits >> 31)
+    *a_out++ = '-';
+  do {
+    digits[n++] = '0' + int_part % 10;
+    int_part /= 10;
+  } while (int_part);
+  while (n)
+    *a_out++ = digits[--n];
+  *a_out++ = '.';
+  for (i = 5; i >= 0; --i) {
+    a_out[i] = '0' + frac_part % 10;
+    frac_part /= 10;
+  }
+  a_out[6] = ' ';
+  return a_out + 7;
+}
 
+/* convert a vector component to IEEE half precision, rounding to
+   nearest even */
+static uint16_t real2half(const real a_value) {
+  float value = a_value;
+  uint32_t bits, abs_bits, mant, rem, half;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint16_t ret;
+  int shift;
+  abs_bits = bits & 0x7FFFFFFF;
+  if (abs_bits >= 0x7F800000)	/* infinity and NaN */
+    return sign | 0x7C00 | (abs_bits > 0x7F800000? 0x200: 0);
+  if (abs_bits >= 0x477FF000)	/* rounds to infinity */
+    return sign | 0x7C00;
+  if (abs_bits < 0x33000000)	/* rounds to zero */
+    return sign;
+
+  if (abs_bits < 0x38800000) {
+    /* subnormal half: units of 2^-24 */
+    mant = (abs_bits & 0x7FFFFF) | 0x800000;
+    shift = 126 - (abs_bits >> 23);
+    ret = mant >> shift;
+    rem = mant & ((1U << shift) - 1);
+    half = 1U << (shift - 1);
+  } else {
+    ret = (abs_bits >> 13) - (112 << 10);
+    rem = abs_bits & 0x1FFF;
+    half = 0x1000;
+  }
+  if (rem > half || (rem == half && (ret & 1)))
+    ++ret;
+  return sign | ret;
+}
+
+/* format a block of rows in the text format */
+static void *format_rows_thread(void *a_block) {
+  text_block_t *block = (text_block_t *) a_block;
+  const vw_t *vocab = block->m_vocab->m_vocab;
+  const real *row;
+  long long a, b, layer1_size = block->m_layer1_size;
+  size_t len, capacity = 0;
+  char *out;
+  for (a = block->m_start; a < block->m_end; ++a)
+    capacity += strlen(vocab[a].word) + 2 + layer1_size * MAX_REAL_CHARS;
+  if (capacity > block->m_capacity) {
+    free(block->m_buffer);
+    block->m_buffer = (char *) malloc(capacity);
+    if (block->m_buffer == NULL) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(EXIT_FAILURE);
+    }
+    block->m_capacity = capacity;
+  }
+
+  out = block->m_buffer;
+  for (a = block->m_start; a < block->m_end; ++a) {
+    len = strlen(vocab[a].word);
+    memcpy(out, vocab[a].word, len);
+    out += len;
+    *out++ = ' ';
+    row = &block->m_syn0[a * layer1_size];
+    for (b = 0; b < layer1_size; ++b)
+      out = format_real(out, row[b]);
+    *out++ = '\n';
+  }
+  block->m_size = out - block->m_buffer;
+  return NULL;
+}
+
+static void save_text(FILE *a_fo, const opt_t *a_opts, const vocab_t *a_vocab,
+                      const nnet_t *a_nnet) {
+  long long vocab_size = a_vocab->m_vocab_size;
+  long long start, rows;
+  int a, n_blocks, num_threads = a_opts->m_num_threads > 0?
+                                 a_opts->m_num_threads: 1;
+  text_block_t *blocks = (text_block_t *) calloc(num_threads,
+                                                 sizeof(text_block_t));
+  pthread_t *pt = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+  if (blocks == NULL || pt == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* the threads format consecutive blocks of rows, which are then
+     written in order */
+  for (start = 0; start < vocab_size; start += rows) {
+    rows = vocab_size - start;
+    if (rows > (long long) num_threads * WRITER_BLOCK_ROWS)
+      rows = (long long) num_threads * WRITER_BLOCK_ROWS;
+    n_blocks = (rows + WRITER_BLOCK_ROWS - 1) / WRITER_BLOCK_ROWS;
+    for (a = 0; a < n_blocks; ++a) {
+      blocks[a].m_vocab = a_vocab;
+      blocks[a].m_syn0 = a_nnet->m_syn0;
+      blocks[a].m_layer1_size = a_opts->m_layer1_size;
+      blocks[a].m_start = start + a * WRITER_BLOCK_ROWS;
+      blocks[a].m_end = start + (a + 1) * WRITER_BLOCK_ROWS;
+      if (blocks[a].m_end > start + rows)
+        blocks[a].m_end = start + rows;
+    }
+    for (a = 1; a < n_blocks; ++a)
+      pthread_create(&pt[a], NULL, format_rows_thread, (void *) &blocks[a]);
+    format_rows_thread(&blocks[0]);
+    for (a = 1; a < n_blocks; ++a)
+      pthread_join(pt[a], NULL);
+
+    for (a = 0; a < n_blocks; ++a)
+      fwrite(blocks[a].m_buffer, 1, blocks[a].m_size, a_fo);
+  }
+
+  for (a = 0; a < num_threads; ++a)
+    free(blocks[a].m_buffer);
+  free(blocks);
+  free(pt);
+}
+
+static void save_binary(FILE *a_fo, const opt_t *a_opts,
+                        const vocab_t *a_vocab, const nnet_t *a_nnet) {
   long long layer1_size = a_opts->m_layer1_size;
   long long vocab_size = a_vocab->m_vocab_size;
   const vw_t *vocab = a_vocab->m_vocab;
+  const real *row;
+  uint16_t *half_row = NULL;
+  long long a, b;
+  if (a_opts->m_binary == BINARY_HALF) {
+    half_row = (uint16_t *) malloc(layer1_size * sizeof(uint16_t));
+    if (half_row == NULL) {
+      fprintf(stderr, "Memory allocation failed\n");
+      exit(EXIT_FAILURE);
+    }
+  }
 
-  // Save the word vectors
-  fprintf(fo, "%lld %lld\n", vocab_size, layer1_size);
-  long a, b;
   for (a = 0; a < vocab_size; ++a) {
-    fprintf(fo, "%s ", vocab[a].word);
-    if (a_opts->m_binary)
-      for (b = 0; b < layer1_size; ++b)
-        fwrite(&a_nnet->m_syn0[a * layer1_size + b], sizeof(real), 1, fo);
-    else
+    fputs(vocab[a].word, a_fo);
+    fputc(' ', a_fo);
+    row = &a_nnet->m_syn0[a * layer1_size];
+    if (half_row) {
       for (b = 0; b < layer1_size; ++b)
-        fprintf(fo, "%lf ", a_nnet->m_syn0[a * layer1_size + b]);
+        half_row[b] = real2half(row[b]);
+      fwrite(half_row, sizeof(uint16_t), layer1_size, a_fo);
+    } else {
+      fwrite(row, sizeof(real), layer1_size, a_fo);
+    }
+    fputc('\n', a_fo);
+  }
+  free(half_row);
+}
 
-    fprintf(fo, "\n");
+void save_embeddings(const opt_t *a_opts, const vocab_t *a_vocab,
+                     const nnet_t *a_nnet) {
+  FILE *fo = a_opts->m_output_file[0]?                          \
+             fopen(a_opts->m_output_file, "wb"): stdout;
+  if (fo == NULL) {
+    fprintf(stderr, "Could not open output file '%s'\n",
+            a_opts->m_output_file);
+    exit(EXIT_FAILURE);
   }
+  char *buffer = (char *) malloc(WRITER_BUFFER_SIZE);
+  if (buffer)
+    setvbuf(fo, buffer, _IOFBF, WRITER_BUFFER_SIZE);
+
+  // Save the word vectors
+  fprintf(fo, "%lld %lld\n", a_vocab->m_vocab_size, a_opts->m_layer1_size);
+  if (a_opts->m_binary)
+    save_binary(fo, a_opts, a_vocab, a_nnet);
+  else
+    save_text(fo, a_opts, a_vocab, a_nnet);
 
   if (a_opts->m_output_file[0])
     fclose(fo);
+  else
+    fflush(fo);
+  free(buffer);
+}
+
+static int64_t align_model(int64_t a_offset) {
+  return (a_offset + MODEL_ALIGNMENT - 1) & ~((int64_t) MODEL_ALIGNMENT - 1);
+}
+
+/* write zeros up to the given file offset */
+static void pad_model(FILE *a_fo, int64_t *a_pos, int64_t a_offset) {
+  static const char padding[MODEL_ALIGNMENT] = {0};
+  fwrite(padding, 1, a_offset - *a_pos, a_fo);
+  *a_pos = a_offset;
+}
+
+static void write_model_section(FILE *a_fo, int64_t *a_pos, int64_t a_offset,
+                                const void *a_data, size_t a_size) {
+  pad_model(a_fo, a_pos, a_offset);
+  fwrite(a_data, 1, a_size, a_fo);
+  *a_pos += a_size;
+}
+
+void save_model(const char *a_path, const opt_t *a_opts,
+                const vocab_t *a_vocab, const nnet_t *a_nnet,
+                const multiclass_t *a_multiclass, const void *a_state,
+                const size_t a_state_size) {
+  const long long vocab_size = a_vocab->m_vocab_size;
+  const long long layer1_size = a_opts->m_layer1_size;
+  const int64_t n_tasks = a_nnet->m_n_tasks;
+  const size_t mtx_size = vocab_size * layer1_size * sizeof(real);
+  model_header_t header;
+  int64_t pos, offset, strings_size = 0, hash_size = 1;
+  int64_t *words = (int64_t *) malloc((vocab_size + 1) * sizeof(int64_t));
+  int64_t *counts = (int64_t *) malloc((vocab_size + 1) * sizeof(int64_t));
+  int64_t *tasks = (int64_t *) malloc((2 * n_tasks + 1) * sizeof(int64_t));
+  int32_t *hash;
+  long long a;
+  size_t len;
+  unsigned long long slot;
+
+  while (hash_size < 2 * vocab_size)
+    hash_size *= 2;
+  hash = (int32_t *) malloc(hash_size * sizeof(int32_t));
+  if (words == NULL || counts == NULL || tasks == NULL || hash == NULL) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  memset(hash, -1, hash_size * sizeof(int32_t));
+  for (a = 0; a < vocab_size; ++a) {
+    len = strlen(a_vocab->m_vocab[a].word);
+    words[a] = strings_size;
+    counts[a] = a_vocab->m_vocab[a].cn;
+    strings_size += len + 1;
+    slot = word_hash(a_vocab->m_vocab[a].word, len) & (hash_size - 1);
+    while (hash[slot] != -1)
+      slot = (slot + 1) & (hash_size - 1);
+    hash[slot] = a;
+  }
+
+  /* lay out the file */
+  memset(&header, 0, sizeof(header));
+  memcpy(header.m_magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+  header.m_version = MODEL_VERSION;
+  header.m_real_size = sizeof(real);
+  header.m_vocab_size = vocab_size;
+  header.m_layer1_size = layer1_size;
+  header.m_train_words = a_vocab->m_train_words;
+  header.m_n_tasks = n_tasks;
+  header.m_cbow = a_opts->m_cbow;
+  header.m_hs = a_opts->m_hs;
+  header.m_negative = a_opts->m_negative;
+  header.m_window = a_opts->m_window;
+  header.m_min_count = a_opts->m_min_count;
+  header.m_iter = a_opts->m_iter;
+  header.m_alpha = a_opts->m_alpha;
+  header.m_sample = a_opts->m_sample;
+  header.m_hash_size = hash_size;
+  header.m_strings_offset = offset = sizeof(model_header_t);
+  header.m_words_offset = offset = (offset + strings_size + 7) & ~7;
+  header.m_counts_offset = offset += vocab_size * sizeof(int64_t);
+  header.m_hash_offset = offset += vocab_size * sizeof(int64_t);
+  header.m_tasks_offset = offset += hash_size * sizeof(int32_t);
+  offset += 2 * n_tasks * sizeof(int64_t);
+  header.m_syn0_offset = offset = align_model(offset);
+  offset += mtx_size;
+  if (a_nnet->m_syn1) {
+    header.m_syn1_offset = offset = align_model(offset);
+    offset += mtx_size;
+  }
+  if (a_nnet->m_syn1neg) {
+    header.m_syn1neg_offset = offset = align_model(offset);
+    offset += mtx_size;
+  }
+  for (a = 0; a < n_tasks; ++a) {
+    tasks[2 * a] = a_multiclass->m_classes[a];
+    tasks[2 * a + 1] = offset = align_model(offset);
+    offset += tasks[2 * a] * layer1_size * sizeof(real);
+  }
+  if (a_nnet->m_ts_syn0) {
+    header.m_ts_syn0_offset = offset = align_model(offset);
+    offset += mtx_size;
+  }
+  if (a_nnet->m_ts_syn0_active) {
+    header.m_ts_syn0_active_offset = offset = align_model(offset);
+    offset += vocab_size * sizeof(short);
+  }
+  if (a_state) {
+    header.m_state_offset = offset = align_model(offset);
+    header.m_state_size = a_state_size;
+    offset += a_state_size;
+  }
+  header.m_file_size = offset;
+
+  FILE *fo = fopen(a_path, "wb");
+  if (fo == NULL) {
+    fprintf(stderr, "ERROR: could not create model file '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  /* write a placeholder header, so that an interrupted write is never
+     mistaken for a valid model */
+  model_header_t placeholder;
+  memset(&placeholder, 0, sizeof(placeholder));
+  fwrite(&placeholder, sizeof(placeholder), 1, fo);
+  pos = sizeof(placeholder);
+  for (a = 0; a < vocab_size; ++a) {
+    len = strlen(a_vocab->m_vocab[a].word) + 1;
+    fwrite(a_vocab->m_vocab[a].word, 1, len, fo);
+    pos += len;
+  }
+  write_model_section(fo, &pos, header.m_words_offset, words,
+                      vocab_size * sizeof(int64_t));
+  write_model_section(fo, &pos, header.m_counts_offset, counts,
+                      vocab_size * sizeof(int64_t));
+  write_model_section(fo, &pos, header.m_hash_offset, hash,
+                      hash_size * sizeof(int32_t));
+  write_model_section(fo, &pos, header.m_tasks_offset, tasks,
+                      2 * n_tasks * sizeof(int64_t));
+  write_model_section(fo, &pos, header.m_syn0_offset, a_nnet->m_syn0,
+                      mtx_size);
+  if (a_nnet->m_syn1)
+    write_model_section(fo, &pos, header.m_syn1_offset, a_nnet->m_syn1,
+                        mtx_size);
+  if (a_nnet->m_syn1neg)
+    write_model_section(fo, &pos, header.m_syn1neg_offset, a_nnet->m_syn1neg,
+                        mtx_size);
+  for (a = 0; a < n_tasks; ++a)
+    write_model_section(fo, &pos, tasks[2 * a + 1], a_nnet->m_vec2task[a],
+                        tasks[2 * a] * layer1_size * sizeof(real));
+  if (a_nnet->m_ts_syn0)
+    write_model_section(fo, &pos, header.m_ts_syn0_offset, a_nnet->m_ts_syn0,
+                        mtx_size);
+  if (a_nnet->m_ts_syn0_active)
+    write_model_section(fo, &pos, header.m_ts_syn0_active_offset,
+                        a_nnet->m_ts_syn0_active, vocab_size * sizeof(short));
+  if (a_state)
+    write_model_section(fo, &pos, header.m_state_offset, a_state,
+                        a_state_size);
+
+  /* finally, write the actual header */
+  fseek(fo, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, fo);
+  if (ferror(fo) || fclose(fo)) {
+    fprintf(stderr, "ERROR: writing model file '%s'\n", a_path);
+    exit(EXIT_FAILURE);
+  }
+  free(words);
+  free(counts);
+  free(tasks);
+  free(hash);
+}
+
+/* check that `a_n' elements of `a_elem_size' bytes at `a_offset' lie
+   within a model file of `a_size' bytes (an offset of 0 marks an absent
+   optional section) */
+static int is_model_section(int64_t a_offset, int64_t a_n,
+                            int64_t a_elem_size, size_t a_size,
+                            const int a_optional) {
+  if (a_optional && a_offset == 0)
+    return 1;
+
+  return a_offset >= (int64_t) sizeof(model_header_t)
+      && a_offset <= (int64_t) a_size
+      && a_offset % a_elem_size == 0
+      && a_n >= 0 && a_n <= ((int64_t) a_size - a_offset) / a_elem_size;
+}
+
+/* same as is_model_section() for a matrix of `a_rows' x `a_cols' reals */
+static int is_model_matrix(int64_t a_offset, int64_t a_rows, int64_t a_cols,
+                           size_t a_size, const int a_optional) {
+  if (a_optional && a_offset == 0)
+    return 1;
+
+  /* the product must not overflow */
+  if (a_rows < 0 || a_cols <= 0
+      || a_rows > (int64_t) (a_size / sizeof(real)) / a_cols)
+    return 0;
+  return is_model_section(a_offset, a_rows * a_cols, sizeof(real), a_size, 0)
+      && a_offset % MODEL_ALIGNMENT == 0;
+}
+
+/* check the layout of a mapped model file, so that none of its tables
+   is read out of bounds */
+static int is_valid_model(const model_header_t *a_header, size_t a_size) {
+  const char *base = (const char *) a_header;
+  const int64_t vocab_size = a_header->m_vocab_size;
+  const int64_t layer1_size = a_header->m_layer1_size;
+  const int64_t hash_size = a_header->m_hash_size;
+  int64_t a;
+  if (memcmp(a_header->m_magic, MODEL_MAGIC, sizeof(MODEL_MAGIC))
+      || a_header->m_version != MODEL_VERSION
+      || a_header->m_real_size != (int64_t) sizeof(real)
+      || a_header->m_file_size != (int64_t) a_size
+      || a_header->m_train_words < 0
+      || a_header->m_n_tasks < 0 || a_header->m_n_tasks > MAX_TASKS
+      || hash_size <= vocab_size || (hash_size & (hash_size - 1)))
+    return 0;
+
+  if (!is_model_section(a_header->m_strings_offset, 0, 1, a_size, 0)
+      || !is_model_section(a_header->m_words_offset, vocab_size,
+                           sizeof(int64_t), a_size, 0)
+      || !is_model_section(a_header->m_counts_offset, vocab_size,
+                           sizeof(int64_t), a_size, 0)
+      || !is_model_section(a_header->m_hash_offset, hash_size,
+                           sizeof(int32_t), a_size, 0)
+      || !is_model_section(a_header->m_tasks_offset, 2 * a_header->m_n_tasks,
+                           sizeof(int64_t), a_size, 0)
+      || !is_model_matrix(a_header->m_syn0_offset, vocab_size, layer1_size,
+                          a_size, 0)
+      || !is_model_matrix(a_header->m_syn1_offset, vocab_size, layer1_size,
+                          a_size, 1)
+      || !is_model_matrix(a_header->m_syn1neg_offset, vocab_size,
+                          layer1_size, a_size, 1)
+      || !is_model_matrix(a_header->m_ts_syn0_offset, vocab_size,
+                          layer1_size, a_size, 1)
+      || !is_model_section(a_header->m_ts_syn0_active_offset, vocab_size,
+                           sizeof(short), a_size, 1)
+      || !is_model_section(a_header->m_state_offset,
+                           a_header->m_state_size, 1, a_size, 1))
+    return 0;
+
+  /* task-specific matrices */
+  const int64_t *tasks = (const int64_t *) (base + a_header->m_tasks_offset);
+  for (a = 0; a < a_header->m_n_tasks; ++a) {
+    if (tasks[2 * a] <= 0 || tasks[2 * a] > INT_MAX
+        || !is_model_matrix(tasks[2 * a + 1], tasks[2 * a], layer1_size,
+                            a_size, 0))
+      return 0;
+  }
+  /* every word ends with a NUL inside the file and has a valid count */
+  const int64_t strings_size = a_size - a_header->m_strings_offset;
+  const char *strings = base + a_header->m_strings_offset;
+  const int64_t *words = (const int64_t *) (base + a_header->m_words_offset);
+  const int64_t *counts = (const int64_t *) (base
+                                             + a_header->m_counts_offset);
+  for (a = 0; a < vocab_size; ++a) {
+    if (counts[a] < 0 || words[a] < 0 || words[a] >= strings_size
+        || memchr(strings + words[a], '\0', strings_size - words[a]) == NULL)
+      return 0;
+  }
+  /* the hash refers to existing words and has an empty slot, which ends
+     every search */
+  const int32_t *hash = (const int32_t *) (base + a_header->m_hash_offset);
+  int has_empty = 0;
+  for (a = 0; a < hash_size; ++a) {
+    if (hash[a] == -1)
+      has_empty = 1;
+    else if (hash[a] < 0 || hash[a] >= vocab_size)
+      return 0;
+  }
+  return has_empty;
+}
+
+int open_model(model_t *a_model, const char *a_path) {
+  int fd = open(a_path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t) st.st_size < sizeof(model_header_t)) {
+    close(fd);
+    return -1;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  const model_header_t *header = (const model_header_t *) map;
+  if (!is_valid_model(header, st.st_size)) {
+    munmap(map, st.st_size);
+    return -1;
+  }
+  const char *base = (const char *) map;
+  a_model->m_map = map;
+  a_model->m_map_size = st.st_size;
+  a_model->m_header = header;
+  a_model->m_strings = base + header->m_strings_offset;
+  a_model->m_words = (const int64_t *) (base + header->m_words_offset);
+  a_model->m_counts = (const int64_t *) (base + header->m_counts_offset);
+  a_model->m_hash = (const int32_t *) (base + header->m_hash_offset);
+  a_model->m_tasks = (const int64_t *) (base + header->m_tasks_offset);
+  a_model->m_syn0 = (const real *) (base + header->m_syn0_offset);
+  a_model->m_syn1 = header->m_syn1_offset?
+                    (const real *) (base + header->m_syn1_offset): NULL;
+  a_model->m_syn1neg = header->m_syn1neg_offset?
+                       (const real *) (base + header->m_syn1neg_offset): NULL;
+  a_model->m_ts_syn0 = header->m_ts_syn0_offset?
+                       (const real *) (base + header->m_ts_syn0_offset): NULL;
+  a_model->m_ts_syn0_active = header->m_ts_syn0_active_offset?
+                              (const short *) (base
+                                               + header->m_ts_syn0_active_offset)
+                              : NULL;
+  a_model->m_state = header->m_state_offset?
+                     (const void *) (base + header->m_state_offset): NULL;
+  a_model->m_vocab_size = header->m_vocab_size;
+  a_model->m_layer1_size = header->m_layer1_size;
+  a_model->m_n_tasks = header->m_n_tasks;
+  return 0;
+}
+
+void close_model(model_t *a_model) {
+  if (a_model->m_map)
+    munmap(a_model->m_map, a_model->m_map_size);
+
+  memset(a_model, 0, sizeof(model_t));
+}
+
+void load_model_vocab(const model_t *a_model, vocab_t *a_vocab,
+                      multiclass_t *a_multiclass, const int a_hs) {
+  const char *word;
+  size_t len;
+  long long a;
+  /* the words are unique and already sorted, so they keep their
+     indices */
+  for (a = 0; a < a_model->m_vocab_size; ++a) {
+    word = model_word(a_model, a);
+    len = strlen(word);
+    add_word2vocab_hashed(a_vocab, word, len, word_hash(word, len),
+                          a_model->m_counts[a]);
+  }
+  a_vocab->m_train_words = a_model->m_header->m_train_words;
+  if (a_hs)
+    create_binary_tree(a_vocab);
+
+  a_multiclass->m_n_tasks = a_model->m_n_tasks;
+  for (a = 0; a < a_model->m_n_tasks; ++a)
+    a_multiclass->m_classes[a] = a_model->m_tasks[2 * a];
+}
+
+long long model_search(const model_t *a_model, const char *a_word) {
+  const uint64_t mask = a_model->m_header->m_hash_size - 1;
+  uint64_t slot = word_hash(a_word, strlen(a_word)) & mask;
+  int32_t idx;
+  while ((idx = a_model->m_hash[slot]) != -1) {
+    if (strcmp(model_word(a_model, idx), a_word) == 0)
+      return idx;
+
+    slot = (slot + 1) & mask;
+  }
+  return -1;
 }
@@ -8,70 +8,421 @@
 //////////////
 // Includes //
 //////////////
+#include "codec.h"
 #include "common.h"
+#include "shards.h"
 #include "vocab.h"
 
+#include <stdint.h>  /* int32_t, int64_t */
 #include <stdio.h>   /* fopen, getline, ferror */
 
+///////////////
+// Constants //
+///////////////
+/** @brief Alignment of the matrices in a native model file */
+# define MODEL_ALIGNMENT 64
+
+/////////////
+// Structs //
+/////////////
+
+/**
+ * @brief Buffered reader of the training file.
+ *
+ * The reader fetches large blocks of the file and scans them in
+ * place, handing out words as views into its buffer instead of
+ * reading and copying them character by character.  Compressed files
+ * are decompressed on the fly, in which case offsets refer to the
+ * decompressed data.  A reader of shards continues with the next shard
+ * at the end of each one, and its offsets refer to the concatenation
+ * of the shards (see shards.h); it can be limited to a range of them.
+ */
+typedef struct {
+  int m_fd;			/**< file descriptor */
+  const char *m_path;		/**< path of the current file */
+  decoder_t *m_decoder;		/**< decompressor (\c NULL for plain
+				   files) */
+  const shards_t *m_shards;	/**< shards read one after another
+				   (\c NULL for a single file) */
+  int m_shard;			/**< index of the current shard */
+  long long m_limit;		/**< offset at which reading stops */
+  int m_limit_shard;		/**< shard which contains `m_limit' (-1
+				   if reading stops at the end) */
+  char *m_buf;			/**< read buffer */
+  size_t m_size;		/**< capacity of the buffer */
+  size_t m_pos;			/**< current position in the buffer */
+  size_t m_end;			/**< end of valid data in the buffer */
+  long long m_offset;		/**< file offset of the start of the buffer */
+  int m_eof;			/**< an attempt was made to read past the end */
+  char m_word[MAX_STRING];	/**< words which cannot be viewed in place */
+} reader_t;
+
+/**
+ * @brief Header of a native model file.
+ *
+ * A native model file can be memory-mapped and used in place.  All
+ * integers are stored in the byte order of the writing machine, and
+ * all offsets are relative to the start of the file.  The header is
+ * followed by these sections:
+ *
+ *  - `m_vocab_size' NUL-terminated words;
+ *  - `m_vocab_size' 64-bit offsets of the words;
+ *  - `m_vocab_size' 64-bit word counts;
+ *  - `m_hash_size' 32-bit slots of an open-addressing hash of the
+ *    words (word_hash(), linear probing, `-1' for empty slots);
+ *  - `m_n_tasks' pairs of 64-bit numbers of classes and offsets of
+ *    the task-specific matrices;
+ *  - the matrices `syn0', `syn1', `syn1neg', those of the tasks,
+ *    and `ts_syn0' (with its flags), each starting at a multiple of
+ *    #MODEL_ALIGNMENT; absent matrices have offset `0';
+ *  - an opaque training state (only in checkpoints).
+ */
+typedef struct {
+  char m_magic[8];		/**< file signature ("W2VMODL") */
+  int64_t m_version;		/**< version of the format */
+  int64_t m_file_size;		/**< size of the whole file */
+  int64_t m_real_size;		/**< size of a matrix element in bytes */
+  int64_t m_vocab_size;		/**< number of words */
+  int64_t m_layer1_size;	/**< dimensionality of the embeddings */
+  int64_t m_train_words;	/**< number of training words */
+  int64_t m_n_tasks;		/**< number of task-specific matrices */
+  int64_t m_cbow;		/**< continuous bag of words was used */
+  int64_t m_hs;			/**< hierarchical softmax was used */
+  int64_t m_negative;		/**< number of negative examples */
+  int64_t m_window;		/**< size of the context window */
+  int64_t m_min_count;		/**< minimum count of words */
+  int64_t m_iter;		/**< number of training iterations */
+  double m_alpha;		/**< starting learning rate */
+  double m_sample;		/**< threshold of subsampling */
+  int64_t m_strings_offset;	/**< offset of the words */
+  int64_t m_words_offset;	/**< offset of the word offsets */
+  int64_t m_counts_offset;	/**< offset of the word counts */
+  int64_t m_hash_offset;	/**< offset of the word hash */
+  int64_t m_hash_size;		/**< number of hash slots (power of 2) */
+  int64_t m_tasks_offset;	/**< offset of the task table */
+  int64_t m_syn0_offset;	/**< offset of the word embeddings */
+  int64_t m_syn1_offset;	/**< offset of the hierarchical softmax
+				   weights */
+  int64_t m_syn1neg_offset;	/**< offset of the negative sampling
+				   weights */
+  int64_t m_ts_syn0_offset;	/**< offset of the isolated task-specific
+				   embeddings */
+  int64_t m_ts_syn0_active_offset; /**< offset of the 16-bit flags of
+				      tokens trained on tasks */
+  int64_t m_state_offset;	/**< offset of the training state */
+  int64_t m_state_size;		/**< size of the training state */
+} model_header_t;
+
+/**
+ * @brief Native model file mapped into memory.
+ */
+typedef struct {
+  void *m_map;			/**< start of the mapped file */
+  size_t m_map_size;		/**< size of the mapped file */
+  const model_header_t *m_header; /**< header of the file */
+  const char *m_strings;	/**< NUL-terminated words */
+  const int64_t *m_words;	/**< offsets of the words in `m_strings' */
+  const int64_t *m_counts;	/**< word counts */
+  const int32_t *m_hash;	/**< hash of the words */
+  const int64_t *m_tasks;	/**< numbers of classes and offsets of
+				   task-specific matrices */
+  const real *m_syn0;		/**< word embeddings */
+  const real *m_syn1;		/**< hierarchical softmax weights (NULL
+				   if absent) */
+  const real *m_syn1neg;	/**< negative sampling weights (NULL if
+				   absent) */
+  const real *m_ts_syn0;	/**< isolated task-specific embeddings
+				   (NULL if absent) */
+  const short *m_ts_syn0_active; /**< flags of tokens trained on tasks
+				    (NULL if absent) */
+  const void *m_state;		/**< training state (NULL if absent) */
+  long long m_vocab_size;	/**< number of words */
+  long long m_layer1_size;	/**< dimensionality of the embeddings */
+  long long m_n_tasks;		/**< number of task-specific matrices */
+} model_t;
+
 /////////////
 // Methods //
 /////////////
 
 /**
- * Reads a single word from a file.
+ * Open file for buffered reading.
  *
- * @param a_word - target word to populate
- * @param a_fin - input stream
- * @param a_consume_tab - digest tab as a normal white-space character
+ * @param a_reader - reader to initialize
+ * @param a_path - path to the file
+ * @param a_offset - offset at which reading starts
+ *
+ * @return \c 0 on success, \c -1 if the file could not be opened
+ */
+int open_reader(reader_t *a_reader, const char *a_path, long long a_offset);
+
+/**
+ * Open shards for buffered reading as if they were one file.
+ *
+ * @param a_reader - reader to initialize
+ * @param a_shards - shards to read (must outlive the reader)
+ * @param a_offset - offset in the concatenation at which reading
+ *   starts (see align_to_shard_line())
+ * @param a_limit - offset at which reading stops, as returned by
+ *   align_to_shard_line() (the reader behaves as if the data ended
+ *   there)
+ *
+ * @return \c void (exits if a shard cannot be opened)
+ */
+void open_shard_reader(reader_t *a_reader, const shards_t *a_shards,
+                       long long a_offset, long long a_limit);
+
+/**
+ * Continue reading at the given file offset.
+ *
+ * @param a_reader - reader to reposition
+ * @param a_offset - offset at which reading continues
  *
  * @return \c void
  */
-void read_word(char *a_word, FILE *a_fin, const int a_consume_tab);
+void seek_reader(reader_t *a_reader, long long a_offset);
+
+/**
+ * Close file and release the buffer of the reader.
+ *
+ * @param a_reader - reader to close
+ *
+ * @return \c void
+ */
+void close_reader(reader_t *a_reader);
+
+/**
+ * Check whether an attempt was made to read past the end of the file
+ * (same semantics as `feof()').
+ *
+ * @param a_reader - reader to check
+ *
+ * @return \c int - non-zero if the end of file was reached
+ */
+static inline int reader_eof(const reader_t *a_reader) {
+  return a_reader->m_eof;
+}
+
+/**
+ * Obtain file offset of the next character to be read.
+ *
+ * @param a_reader - reader to check
+ *
+ * @return \c long long - offset of the next character
+ */
+static inline long long tell_reader(const reader_t *a_reader) {
+  return a_reader->m_offset + a_reader->m_pos;
+}
+
+/**
+ * Read a single word (same semantics as read_word()).
+ *
+ * @param a_reader - reader to read from
+ * @param a_len - length of the returned word
+ * @param a_consume_tab - digest tab as a normal white-space character
+ *
+ * @return \c const char* - start of the word (not NUL-terminated and
+ *   valid until the next read) or \c NULL if the end of file was
+ *   reached before the word was completed
+ */
+const char *read_token(reader_t *a_reader, size_t *a_len,
+                       const int a_consume_tab);
 
 /**
  * Read a word and return its index in the vocabulary.
  *
- * @param a_fin - input stream
+ * @param a_reader - reader to read from
  * @param a_vocab - vocabulary to search in
- * @param a_vocab_hash - hash of word indices
  * @param a_consume_tab - digest tab as a normal white-space character
  *
- * @return \c void
+ * @return \c int - index of the word, \c -1 if the word is unknown
+ *   or the end of file was reached
  */
-int read_word_index(FILE *a_fin, const vw_t *a_vocab, const int *a_vocab_hash,
-                    const int a_consume_tab);
+int read_token_index(reader_t *a_reader, const vocab_t *a_vocab,
+                     const int a_consume_tab);
 
 /**
- * Read a word and return its index in the vocabulary.
+ * Read task labels till the end of line.
  *
- * @param a_fin - input stream
+ * @param a_reader - reader to read from
  * @param a_multiclass - statistics on task-specific classes
  *
  * @return negative \c int on error, otherwise a non-negative number
  *   of active tasks
  */
-int read_tags(FILE *a_fin, multiclass_t *a_multiclass);
+int read_token_tags(reader_t *a_reader, multiclass_t *a_multiclass);
+
+/**
+ * Find the beginning of the line which contains byte `a_offset' - 1.
+ *
+ * @param a_fin - input stream
+ * @param a_offset - offset past the byte in question
+ *
+ * @return \c long long - offset of the line start
+ */
+long long align_to_line(FILE *a_fin, long long a_offset);
 
 /**
- * Create vocabulary from words in the training file.
+ * Reads a single word from a file.
+ *
+ * @param a_word - target word to populate
+ * @param a_fin - input stream
+ * @param a_consume_tab - digest tab as a normal white-space character
+ *
+ * @return \c void
+ */
+void read_word(char *a_word, FILE *a_fin, const int a_consume_tab);
+
+/**
+ * Create vocabulary from words in the training file.  The shards are
+ * split into parts of about the same size, which are counted in
+ * parallel, but compressed shards are never split.
  *
  * @param a_vocab - vocabulary to populate
  * @param a_multiclass - statistics about multiple training classes
  * @param a_opts - word to search for
  *
- * @return \c size_t - size of the input file
+ * @return \c size_t - size of the input file (sum of the sizes of the
+ *   shards)
  */
 size_t learn_vocab_from_trainfile(vocab_t *a_vocab, multiclass_t *a_multiclass,
                                   opt_t *a_opts);
 
 /**
- * Output embeddings to the specified file.
+ * Read a pre-built vocabulary, either from a text file with a word
+ * and its count on each line (as written by save_vocab()) or from a
+ * native model file (which also provides the classes of the tasks).
  *
- * @param a_fo - output stream
  * @param a_vocab - vocabulary to populate
+ * @param a_multiclass - statistics about multiple training classes
+ * @param a_opts - command line options (vocabulary file, minimum
+ *   count, and hierarchical softmax)
+ *
+ * @return \c void
+ */
+void read_vocab(vocab_t *a_vocab, multiclass_t *a_multiclass,
+                const opt_t *a_opts);
+
+/**
+ * Save words and their counts, one per line.
+ *
+ * @param a_path - path to the output file
+ * @param a_vocab - vocabulary to save
+ *
+ * @return \c void
+ */
+void save_vocab(const char *a_path, const vocab_t *a_vocab);
+
+/**
+ * Output embeddings to the specified file.
+ *
+ * The text format is produced by `-threads' threads formatting blocks
+ * of rows in parallel, the binary format is written a row at a time;
+ * both are byte-identical to the output of the original word2vec.
+ * With `-binary 2', the components are stored as IEEE half-precision
+ * floats instead.
+ *
+ * @param a_opts - command line options
+ * @param a_vocab - vocabulary of the embeddings
+ * @param a_nnet - neural net with trained parameters
+ *
+ * @return \c void
+ */
+void save_embeddings(const opt_t *a_opts, const vocab_t *a_vocab,
+                     const nnet_t *a_nnet);
+
+/**
+ * Save vocabulary and weights in the native model format.
+ *
+ * @param a_path - path to the model file
+ * @param a_opts - command line options
+ * @param a_vocab - vocabulary of the model
  * @param a_nnet - neural net with trained parameters
+ * @param a_multiclass - numbers of classes of the tasks
+ * @param a_state - opaque training state to store (may be \c NULL)
+ * @param a_state_size - size of the training state in bytes
+ *
+ * @return \c void
+ */
+void save_model(const char *a_path, const opt_t *a_opts,
+                const vocab_t *a_vocab, const nnet_t *a_nnet,
+                const multiclass_t *a_multiclass, const void *a_state,
+                const size_t a_state_size);
+
+/**
+ * Map native model file into memory.
+ *
+ * Only the header is checked, so the time needed does not depend on
+ * the size of the model; the pages of the file are loaded on first
+ * access.
+ *
+ * @param a_model - model to populate
+ * @param a_path - path to the model file
+ *
+ * @return \c 0 on success, \c -1 if the file could not be mapped or
+ *   is not a valid model
+ */
+int open_model(model_t *a_model, const char *a_path);
+
+/**
+ * Unmap native model file.
+ *
+ * @param a_model - model to close
+ *
+ * @return \c void
+ */
+void close_model(model_t *a_model);
+
+/**
+ * Rebuild vocabulary and task statistics stored in a mapped model.
+ *
+ * @param a_model - mapped model
+ * @param a_vocab - empty vocabulary to populate
+ * @param a_multiclass - statistics on tasks to populate
+ * @param a_hs - create Huffman codes for hierarchical softmax
+ *
+ * @return \c void
+ */
+void load_model_vocab(const model_t *a_model, vocab_t *a_vocab,
+                      multiclass_t *a_multiclass, const int a_hs);
+
+/**
+ * Look up a word in a mapped model.
+ *
+ * @param a_model - mapped model
+ * @param a_word - word to search for
+ *
+ * @return \c long long - index of the word, \c -1 if not found
+ */
+long long model_search(const model_t *a_model, const char *a_word);
+
+/**
+ * Obtain word of a mapped model.
+ *
+ * @param a_model - mapped model
+ * @param a_index - index of the word
+ *
+ * @return \c const char* - NUL-terminated word
+ */
+static inline const char *model_word(const model_t *a_model,
+                                     const long long a_index) {
+  return a_model->m_strings + a_model->m_words[a_index];
+}
+
+/**
+ * Obtain task-specific matrix of a mapped model.
+ *
+ * @param a_model - mapped model
+ * @param a_task - index of the task
+ * @param a_n_classes - number of rows of the matrix
  *
- * @return \c size_t - size of the input file
+ * @return \c const real* - `a_n_classes x m_layer1_size' matrix
  */
-void save_embeddings(const opt_t *a_fo, const vocab_t *a_vocab, const nnet_t *a_nnet);
+static inline const real *model_task(const model_t *a_model,
+                                     const long long a_task,
+                                     long long *a_n_classes) {
+  *a_n_classes = a_model->m_tasks[2 * a_task];
+  return (const real *) ((const char *) a_model->m_map
+                         + a_model->m_tasks[2 * a_task + 1]);
+}
 #endif  /* ifndef __WORD2VEC_IO_H__ */
@@ -12,7 +12,16 @@
 //  See the License for the specific language governing permissions and
 //  limitations under the License.
 
+#include "codec.h"
 #include "common.h"
+#include "pages.h"
+#include "sampler.h"
+#include "schedule.h"
+#include "shards.h"
+#include "sigmoid.h"
+#include "stream.h"
+#include "sync.h"
+#include "topology.h"
 #include "train.h"
 
 #include <stdio.h>
@@ -36,9 +45,42 @@ static void usage(int a_ret) {
   printf("OPTIONS:\n");
   printf("Parameters for training:\n");
   printf("-train <file>\n");
-  printf("\tUse text data from <file> to train the model\n");
+  printf("\tUse text data from <file> to train the model; `-' or a FIFO streams the\n"
+         "\tdata, which are then read only once and require -read-vocab; a comma-separated\n"
+         "\tlist of files, directories, and manifests (@<file> with one path per line) is\n"
+         "\tread as consecutive shards; compressed files are recognized by their contents\n"
+         "\t(supported by this build: %s)\n", supported_codecs());
+  printf("-read-vocab <file>\n");
+  printf("\tTake the vocabulary from <file> (words and counts, one per line, or a\n"
+         "\tnative model) instead of counting it in the training data\n");
+  printf("-save-vocab <file>\n");
+  printf("\tSave the vocabulary with word counts to <file>\n");
+  printf("-stream-buffer <int>\n");
+  printf("\tNumber of batches of about 64K words buffered between the reader of\n"
+         "\tstreamed data and the training threads (default 16)\n");
+  printf("-read-threads <int>\n");
+  printf("\tNumber of threads reading streamed shards (a list with `-' or a FIFO, or\n"
+         "\tfewer compressed shards than threads); by default, as many as shards\n"
+         "\t(times passes) or training threads, whichever is less\n");
+  printf("-corpus <file>\n");
+  printf("\tTokenize the training data only once into a binary <file> of vocabulary ids,\n"
+         "\twhich is memory-mapped by all threads in all iterations (an existing <file>\n"
+         "\tis reused if it was built from the same data with the same vocabulary)\n");
   printf("-output <file>\n");
   printf("\tUse <file> to save the resulting word vectors / word clusters\n");
+  printf("-save-model <file>\n");
+  printf("\tAdditionally save the vocabulary and all weight matrices to <file> in a native\n"
+         "\tformat which can be memory-mapped and used without parsing\n");
+  printf("-checkpoint <file>\n");
+  printf("\tPeriodically save the whole training state to <file> in the background\n");
+  printf("-checkpoint-interval <int>\n");
+  printf("\tSeconds between two checkpoints; default is 600\n");
+  printf("-stop-after <int>\n");
+  printf("\tStop each thread after it has read <int> words and write the final\n"
+         "\tcheckpoint, from which training can be resumed later; default is 0 (off)\n");
+  printf("-resume <file>\n");
+  printf("\tContinue training from the checkpoint <file> (requires the same training\n"
+         "\tfile, -threads, and model options as the interrupted run)\n");
   printf("-size <int>\n");
   printf("\tSet size of word vectors; default is 100\n");
   printf("-window <int>\n");
@@ -50,8 +92,52 @@ static void usage(int a_ret) {
   printf("\tUse Hierarchical Softmax; default is 0 (not used)\n");
   printf("-negative <int>\n");
   printf("\tNumber of negative examples; default is 5, common values are 3 - 10 (0 = not used)\n");
+  printf("-negative-sampler <method>\n");
+  printf("\tDraw negative examples from the unigram `table' (default, as in the original\n"
+         "\tword2vec) or with the `alias' method, which needs much less memory\n");
+  printf("-negative-power <float>\n");
+  printf("\tDraw negative examples proportionally to word counts raised to <float>;\n"
+         "\tdefault is 0.75\n");
+  printf("-minibatch <int>\n");
+  printf("\tShare negative samples among all context words of a skip-gram window and\n"
+         "\tupdate them with matrix-matrix products; default is 0 (off), requires\n"
+         "\t-cbow 0 -hs 0 and -negative > 0\n");
   printf("-threads <int>\n");
   printf("\tUse <int> threads (default 12)\n");
+  printf("-schedule <mode>\n");
+  printf("\tDistribution of training data among threads: `static' (one fixed share per\n"
+         "\tthread, default) or `steal' (line-aligned chunks which idle threads steal\n"
+         "\tfrom busy ones)\n");
+  printf("-chunk-size <int>\n");
+  printf("\tBytes of training data per chunk of the `steal' schedule (default 1048576)\n");
+  printf("-shuffle <int>\n");
+  printf("\tVisit the chunks of the `steal' schedule in a different order in each epoch,\n"
+         "\tdrawn from the seed <int>; default is 0 (off)\n");
+  printf("-vocab-threads <int>\n");
+  printf("\tCount the vocabulary with <int> threads (default: same as -threads)\n");
+  printf("-isa <name>\n");
+  printf("\tInstruction set of vector kernels: `auto' (the fastest one supported by\n"
+         "\tthe CPU, default), `scalar', `sse4.2', `avx2', or `avx512'\n");
+  printf("-sigmoid <method>\n");
+  printf("\tApproximation of the sigmoid: `table' (lookup as in the original word2vec,\n"
+         "\tdefault), `interp' (linear interpolation of the table), or `poly' (rational\n"
+         "\tapproximation)\n");
+  printf("-numa <policy>\n");
+  printf("\tPlacement of model matrices across NUMA nodes: `none' (default),\n"
+         "\t`interleave' (pages round-robin over all nodes), or `partition' (one\n"
+         "\tcontiguous block of rows per node)\n");
+  printf("-pin <int>\n");
+  printf("\tPin training threads to CPUs, alternating between NUMA nodes; default is 0\n"
+         "\t(off)\n");
+  printf("-huge-pages <mode>\n");
+  printf("\tBack model matrices with `none' (regular pages, default), `thp' (transparent\n"
+         "\thuge pages), or `explicit' (reserved huge pages, falling back to `thp')\n");
+  printf("-sync <mode>\n");
+  printf("\tSynchronization of concurrent model updates: `hogwild' (lock-free,\n"
+         "\tdefault), `mutex' (serialize all updates through a single lock), or\n"
+         "\t`striped' (lock only the updated rows)\n");
+  printf("-sync-stripes <int>\n");
+  printf("\tNumber of locks used by the `striped' synchronization (default 1024)\n");
   printf("-iter <int>\n");
   printf("\tRun more training iterations (default 5)\n");
   printf("-min-count <int>\n");
@@ -61,7 +147,8 @@ static void usage(int a_ret) {
   printf("-debug <int>\n");
   printf("\tSet the debug mode (default = 2 = more info during training)\n");
   printf("-binary <int>\n");
-  printf("\tSave the resulting vectors in binary mode; default is 0 (off)\n");
+  printf("\tSave the resulting vectors in binary mode; default is 0 (off), 2 stores\n"
+         "\tthem as 16-bit floats\n");
   printf("-cbow <int>\n");
   printf("\tUse the continuous bag of words model; default is 1 (use 0 for skip-gram model)\n");
   printf("-ts <int>\n");
@@ -80,6 +167,23 @@ static void usage(int a_ret) {
   exit(a_ret);
 }
 
+/**
+ * Copy the argument of an option into a buffer of #MAX_STRING bytes
+ *
+ * @param a_dst - buffer of the option
+ * @param a_arg - argument of the option
+ * @param a_option - name of the option
+ *
+ * @return \c void (exits if the argument does not fit)
+ */
+static void copy_arg(char *a_dst, const char *a_arg, const char *a_option) {
+  if (strlen(a_arg) >= MAX_STRING) {
+    fprintf(stderr, "The argument of %s is too long.\n", a_option);
+    exit(EXIT_FAILURE);
+  }
+  strcpy(a_dst, a_arg);
+}
+
 int main(int argc, char **argv) {
   opt_t opt;
   int alpha_set = 0;
@@ -92,7 +196,31 @@ int main(int argc, char **argv) {
     } else if (strcmp(argv[i], "-size") == 0) {
       opt.m_layer1_size = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-train") == 0) {
-      strcpy(opt.m_train_file, argv[++i]);
+      if (strlen(argv[++i]) >= MAX_FILE_LIST) {
+        fprintf(stderr, "The list of training files is too long.\n");
+        exit(EXIT_FAILURE);
+      }
+      strcpy(opt.m_train_file, argv[i]);
+    } else if (strcmp(argv[i], "-read-vocab") == 0) {
+      copy_arg(opt.m_read_vocab_file, argv[++i], "-read-vocab");
+    } else if (strcmp(argv[i], "-save-vocab") == 0) {
+      copy_arg(opt.m_save_vocab_file, argv[++i], "-save-vocab");
+    } else if (strcmp(argv[i], "-stream-buffer") == 0) {
+      opt.m_stream_buffer = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-read-threads") == 0) {
+      opt.m_read_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-corpus") == 0) {
+      copy_arg(opt.m_corpus_file, argv[++i], "-corpus");
+    } else if (strcmp(argv[i], "-save-model") == 0) {
+      copy_arg(opt.m_model_file, argv[++i], "-save-model");
+    } else if (strcmp(argv[i], "-checkpoint") == 0) {
+      copy_arg(opt.m_checkpoint_file, argv[++i], "-checkpoint");
+    } else if (strcmp(argv[i], "-checkpoint-interval") == 0) {
+      opt.m_checkpoint_interval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-stop-after") == 0) {
+      opt.m_stop_after = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-resume") == 0) {
+      copy_arg(opt.m_resume_file, argv[++i], "-resume");
     } else if (strcmp(argv[i], "-debug") == 0) {
       opt.m_debug_mode = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-binary") == 0) {
@@ -113,8 +241,57 @@ int main(int argc, char **argv) {
       opt.m_hs = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-negative") == 0) {
       opt.m_negative = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-negative-sampler") == 0) {
+      if (str2sampler_mode(argv[++i], &opt.m_sampler)) {
+        fprintf(stderr, "Unknown negative sampler: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-negative-power") == 0) {
+      opt.m_sampler_power = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-minibatch") == 0) {
+      opt.m_minibatch = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-threads") == 0) {
       opt.m_num_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-schedule") == 0) {
+      if (str2schedule_mode(argv[++i], &opt.m_schedule)) {
+        fprintf(stderr, "Unknown schedule: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-chunk-size") == 0) {
+      opt.m_chunk_size = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-shuffle") == 0) {
+      opt.m_shuffle = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-vocab-threads") == 0) {
+      opt.m_vocab_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-isa") == 0) {
+      copy_arg(opt.m_isa, argv[++i], "-isa");
+    } else if (strcmp(argv[i], "-sigmoid") == 0) {
+      if (str2sigmoid_mode(argv[++i], &opt.m_sigmoid)) {
+        fprintf(stderr, "Unknown sigmoid approximation: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-numa") == 0) {
+      if (str2numa_mode(argv[++i], &opt.m_numa)) {
+        fprintf(stderr, "Unknown NUMA placement: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-pin") == 0) {
+      opt.m_pin = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-huge-pages") == 0) {
+      if (str2huge_pages_mode(argv[++i], &opt.m_huge_pages)) {
+        fprintf(stderr, "Unknown kind of pages: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-sync") == 0) {
+      if (str2sync_mode(argv[++i], &opt.m_sync)) {
+        fprintf(stderr, "Unknown synchronization mode: '%s'\n", argv[i]);
+        usage(1);
+      }
+    } else if (strcmp(argv[i], "-sync-stripes") == 0) {
+      if ((opt.m_sync_stripes = atoi(argv[++i])) < 1) {
+        fprintf(stderr, "Invalid number of lock stripes: '%s'\n", argv[i]);
+        usage(1);
+      }
     } else if (strcmp(argv[i], "-iter") == 0) {
       opt.m_iter = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-min-count") == 0) {
@@ -173,6 +350,52 @@ int main(int argc, char **argv) {
     exit(6);
   }
 
+  if (opt.m_minibatch > 0 && (opt.m_cbow || opt.m_hs || opt.m_negative <= 0)) {
+    fprintf(stderr,
+            "Option -minibatch requires -cbow 0, -hs 0, and -negative > 0."
+            "  Type --help to see usage.\n");
+    exit(7);
+  }
+
+  if (opt.m_schedule == SCHEDULE_STEAL
+      && (opt.m_checkpoint_file[0] || opt.m_resume_file[0])) {
+    fprintf(stderr,
+            "Options -checkpoint and -resume require -schedule static."
+            "  Type --help to see usage.\n");
+    exit(8);
+  }
+
+  if (opt.m_stop_after > 0 && opt.m_checkpoint_file[0] == 0) {
+    fprintf(stderr,
+            "Option -stop-after requires -checkpoint."
+            "  Type --help to see usage.\n");
+    exit(12);
+  }
+
+  if (opt.m_shuffle && opt.m_schedule != SCHEDULE_STEAL) {
+    fprintf(stderr,
+            "Option -shuffle requires -schedule steal."
+            "  Type --help to see usage.\n");
+    exit(9);
+  }
+
+  if (has_stream_file(opt.m_train_file) && opt.m_read_vocab_file[0] == 0) {
+    fprintf(stderr,
+            "Streamed training data require -read-vocab."
+            "  Type --help to see usage.\n");
+    exit(10);
+  }
+
+  if ((has_stream_file(opt.m_train_file) || is_sharded_input(opt.m_train_file))
+      && (opt.m_corpus_file[0] || opt.m_schedule != SCHEDULE_STATIC
+          || opt.m_checkpoint_file[0] || opt.m_resume_file[0])) {
+    fprintf(stderr,
+            "Options -corpus, -schedule steal, -checkpoint, and -resume"
+            " cannot be used with streamed, compressed, or sharded training"
+            " data.  Type --help to see usage.\n");
+    exit(11);
+  }
+
   train_model(&opt);
   return 0;
 }